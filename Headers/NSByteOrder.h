@@ -157,6 +157,16 @@ static inline unsigned long NSSwapHostLongToLittle(unsigned long x)
 	return htole32(x);
 }
 
+static inline unsigned short NSSwapHostShortToBig(unsigned short x)
+{
+	return htobe16(x);
+}
+
+static inline unsigned short NSSwapHostShortToLittle(unsigned short x)
+{
+	return htole16(x);
+}
+
 static inline unsigned int NSSwapLittleIntToHost(unsigned int x)
 {
 	return le32toh(x);
@@ -36,6 +36,9 @@ enum
 	NSDataReadingMappedAlways = 1UL,
 	NSDataReadingUncached = 1UL << 1,
 	NSDataReadingMappedIfSafe = 1UL << 3,
+	/* Access pattern hints for mapped data (extensions). */
+	NSDataReadingSequentialAccess = 1UL << 16,
+	NSDataReadingRandomAccess = 1UL << 17,
 };
 typedef NSUInteger NSDataReadingOptions;
 
@@ -119,6 +122,15 @@ typedef NSUInteger NSDataSearchOptions;
 -(id)initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length;
 -(id)initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length freeWhenDone:(bool)free;
 
+/*!
+ @brief Initializes an allocated data object with the given byte buffer, without copying.
+ @param bytes Byte buffer with which to initialize the data object.
+ @param length Length of the data buffer.
+ @param deallocator Block called with the buffer and its length once the data object no longer needs it, or nil.
+ @result Returns the initialized object.
+ */
+-(id)initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length deallocator:(void (^)(void *bytes, NSUInteger length))deallocator;
+
 /*!
  * \brief Initialize the receiver with the given data argument.
  */
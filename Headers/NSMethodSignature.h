@@ -98,6 +98,17 @@ typedef struct {
  */
 - (const char *) types;
 
+/*!
+ * \brief Returns the size of the argument at the given index, as laid out
+ * in memory.
+ */
+- (NSUInteger) argumentSizeAtIndex:(NSUInteger)index;
+
+/*!
+ * \brief Returns the alignment of the argument at the given index.
+ */
+- (NSUInteger) argumentAlignmentAtIndex:(NSUInteger)index;
+
 @end
 
 /*
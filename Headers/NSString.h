@@ -398,6 +398,12 @@ typedef NSString * const NSSymbol;
 -(NSRange)rangeOfString:(NSString *)aString
 	options:(NSStringCompareOptions)mask range:(NSRange)aRange locale:(NSLocale *)locale;
 
+/*!
+ \brief Returns true if the receiver contains the given string, using a literal search.
+ \param aString NSString to search for.
+ */
+-(bool)containsString:(NSString *)aString;
+
 - (void) enumerateLinesUsingBlock:(void (^)(NSString *, bool *))block;
 - (void) enumerateSubstringsInRange:(NSRange)range options:(NSStringEnumerationOptions)opts usingBlock:(void (^)(NSString *, NSRange, NSRange, bool *))block;
 
@@ -704,6 +710,21 @@ typedef NSString * const NSSymbol;
 - (id)initWithBytesNoCopy:(const void *)bytes length:(NSUInteger)length
 	encoding:(NSStringEncoding)encoding freeWhenDone:(bool)flag;
 
+/*!
+ \brief Initializes a newly allocated NSString to contain the given bytes.
+ \param bytes Bytes in the given encoding for the string.
+ \param length Length of the byte string.
+ \param encoding NSString encoding of the bytes.
+ \param deallocator Block called with the bytes and length once the string no
+ longer needs them, or nil.
+
+ \details Where the encoding allows, the string uses the bytes in place
+ instead of copying them.
+ */
+- (id)initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)encoding
+	deallocator:(void (^)(void *bytes, NSUInteger length))deallocator;
+
 /*!
  \brief Initializes an NSString containing the passed unicode characters.
  \param chars Characters to place into the string.
@@ -725,6 +746,17 @@ typedef NSString * const NSSymbol;
 -(id)initWithCharactersNoCopy:(const NSUniChar *)chars
 	length:(NSUInteger)length freeWhenDone:(bool)flag;
 
+/*!
+ \brief Initializes an NSString using the passed unicode characters in place.
+ \param chars Characters of the string.
+ \param length Number of characters in chars.
+ \param deallocator Block called with the characters and length once the
+ string no longer needs them, or nil.
+ */
+-(id)initWithCharactersNoCopy:(NSUniChar *)chars
+	length:(NSUInteger)length
+	deallocator:(void (^)(NSUniChar *chars, NSUInteger length))deallocator;
+
 /*!
  \brief Initializes an NSString with the contents of the given string.
  \param string NSString to create a copy of in the receiver.
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#import <Foundation/NSException.h>
+#import "NSConcreteData.h"
+
+@implementation NSConcreteData
+
+- (id) init
+{
+	return self;
+}
+
+- (id) initWithBytes:(const void *)src length:(NSUInteger)len
+{
+	if (len == 0)
+		return self;
+
+	bytes = malloc(len);
+	if (bytes == NULL)
+	{
+		@throw [NSMemoryException
+			exceptionWithReason:@"Out of Memory creating data." userInfo:nil];
+	}
+	memcpy(bytes, src, len);
+	length = len;
+	freeWhenDone = true;
+	return self;
+}
+
+- (id) initWithBytesNoCopy:(void *)src length:(NSUInteger)len
+	freeWhenDone:(bool)flag
+{
+	bytes = src;
+	length = len;
+	freeWhenDone = flag;
+	return self;
+}
+
+- (id) initWithBytesNoCopy:(void *)src length:(NSUInteger)len
+	deallocator:(void (^)(void *, NSUInteger))block
+{
+	bytes = src;
+	length = len;
+	deallocator = block;
+	return self;
+}
+
+- (void) dealloc
+{
+	if (deallocator != nil)
+		deallocator(bytes, length);
+	else if (freeWhenDone)
+		free(bytes);
+}
+
+- (const void *) bytes
+{
+	return bytes;
+}
+
+- (NSUInteger) length
+{
+	return length;
+}
+
+@end
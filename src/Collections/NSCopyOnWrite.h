@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#ifndef __NSCopyOnWrite_h__
+#define __NSCopyOnWrite_h__
+
+#include <memory>
+
+/*
+ * Reference counted, copy-on-write holder for the backing store of the core
+ * collections.  Copying a collection shares its store, and whichever side
+ * mutates first takes a private copy.  An empty holder has no store at all
+ * and reads as an empty T.
+ *
+ * A collection is only ever mutated by one thread at a time, and while it
+ * is the store can only gain owners through that collection, so use_count()
+ * is a safe test for sharing: a stale count only costs an extra copy.
+ */
+template <typename T>
+class _NSCopyOnWrite
+{
+public:
+	const T &operator*() const { return store ? *store : empty(); }
+	const T *operator->() const { return &**this; }
+
+	/* The store, made private to this holder first. */
+	T &write()
+	{
+		if (!store)
+			store = std::make_shared<T>();
+		else if (store.use_count() > 1)
+			store = std::make_shared<T>(*store);
+		return *store;
+	}
+
+	void share(const _NSCopyOnWrite &other) { store = other.store; }
+	void reset() { store.reset(); }
+
+private:
+	std::shared_ptr<T> store;
+
+	static const T &empty()
+	{
+		static const T e;
+		return e;
+	}
+};
+
+#endif /* __NSCopyOnWrite_h__ */
@@ -58,15 +58,21 @@
 #import <Foundation/NSRange.h>
 #include <vector>
 
+#import "NSCopyOnWrite.h"
+
 @class NSString;
 
 /*
  * NSCoreArray class
+ *
+ * Copies share the items copy-on-write.
  */
 
 @interface NSCoreArray : NSMutableArray
 {
-	std::vector<id> items;
+	_NSCopyOnWrite<std::vector<id> > items;
+	/* Bumped by every mutation, for fast enumeration. */
+	unsigned long mutations;
 }
 
 - (id)init;
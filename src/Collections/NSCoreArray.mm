@@ -52,7 +52,8 @@
 
 - (id)initWithCapacity:(NSUInteger)aNumItems
 {
-	items.reserve(aNumItems);
+	if (aNumItems > 0)
+		items.write().reserve(aNumItems);
 	return self;
 }
 
@@ -60,7 +61,7 @@
 {
 	NSUInteger i;
 
-	items.assign(objects, objects + count);
+	items.write().assign(objects, objects + count);
 	for (i = 0; i < count; i++)
 	{
 		if (objects[i] == nil)
@@ -77,24 +78,42 @@
 {
 	NSUInteger i, count = [anotherArray count];
 
-	items.reserve(count);
+	if ([anotherArray isKindOfClass:[NSCoreArray class]])
+	{
+		items.share(((NSCoreArray *)anotherArray)->items);
+		return self;
+	}
+
+	std::vector<id> &v = items.write();
+
+	v.reserve(count);
 	for (i = 0; i < count; i++)
 	{
-		items.push_back([anotherArray objectAtIndex:i]);
+		v.push_back([anotherArray objectAtIndex:i]);
 	}
 	return self;
 }
 
+- (id)copyWithZone:(NSZone*)zone
+{
+	return [[NSCoreArray allocWithZone:zone] initWithArray:self];
+}
+
+- (id)mutableCopyWithZone:(NSZone*)zone
+{
+	return [[NSCoreArray allocWithZone:zone] initWithArray:self];
+}
+
 - (NSUInteger)count
 {
-	return items.size();
+	return items->size();
 }
 
 - (id) objectAtIndex:(NSUInteger)index
 {
-	if (index >= items.size())
+	if (index >= items->size())
 		@throw([NSRangeException exceptionWithReason:@"Index out of bounds in -[NSCoreArray objectAtIndex:]" userInfo:nil]);
-	return items[index];
+	return (*items)[index];
 }
 
 /* Altering the NSArray */
@@ -106,18 +125,23 @@
 		@throw([NSInvalidArgumentException
 				exceptionWithReason:@"Nil object to be added in array" userInfo:nil]);
 	}
-	if (index > items.size())
+	if (index > items->size())
 	{
 		@throw([NSRangeException
 				exceptionWithReason:@"-[NSCoreArray insertObject:atIndex:]"
 				userInfo:nil]);
 	}
-	items.insert(items.begin() + index, anObject);
+
+	std::vector<id> &v = items.write();
+
+	mutations++;
+	v.insert(v.begin() + index, anObject);
 }
 
 - (void) addObject:(id)object
 {
-	items.push_back(object);
+	mutations++;
+	items.write().push_back(object);
 }
 
 - (void)replaceObjectAtIndex:(NSUInteger)index withObject:(id)anObject
@@ -127,19 +151,26 @@
 		@throw([NSInvalidArgumentException
 				exceptionWithReason:@"Nil object to be added in array" userInfo:nil]);
 	}
-	if (index >= items.size())
+	if (index >= items->size())
 	{
 		@throw([NSRangeException
 				exceptionWithReason:@"-[NSCoreArray replaceObjectAtIndex:withObject:]"
 				userInfo:nil]);
 	}
-	items[index] = anObject;
+	mutations++;
+	items.write()[index] = anObject;
 }
 
 - (void)removeObjectsFrom:(NSUInteger)index
 	count:(NSUInteger)count
 {
-	items.erase(items.begin() + index, items.begin() + index + count);
+	if (count == 0)
+		return;
+
+	std::vector<id> &v = items.write();
+
+	mutations++;
+	v.erase(v.begin() + index, v.begin() + index + count);
 }
 
 - (void)removeObjectsInRange:(NSRange)aRange
@@ -147,22 +178,28 @@
 	[self removeObjectsFrom:aRange.location count:aRange.length];
 }
 
+/* Drops this array's reference to the items rather than copying them first. */
 - (void)removeAllObjects
 {
-	[self removeObjectsFrom:0 count:items.size()];
+	mutations++;
+	items.reset();
 }
 
 - (void)removeLastObject
 {
-	if (items.size() > 0)
+	if (items->size() > 0)
 	{
-		items.pop_back();
+		mutations++;
+		items.write().pop_back();
 	}
 }
 
 - (void)removeObjectAtIndex:(NSUInteger)index
 {
-	items.erase(items.begin() + index);
+	std::vector<id> &v = items.write();
+
+	mutations++;
+	v.erase(v.begin() + index);
 }
 
 - (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
@@ -178,14 +215,16 @@
 	{
 		idx = state->extra[1];
 	}
-	if (items.size() > 0)
-		state->mutationsPtr = &state->extra[0];
-	else
-		state->mutationsPtr = 0;
-	len = std::min(len, (NSUInteger)items.size());
-	std::copy(&items[idx], &items[idx + len], stackBuf);
-	state->extra[1] += len;
-	return len;
+	if (idx >= items->size())
+		return 0;
+	/*
+	 * Hand out the rest of the items in place.  Any mutation may move them,
+	 * so it has to be caught before the loop reads on.
+	 */
+	state->mutationsPtr = &mutations;
+	state->itemsPtr = (__unsafe_unretained id *)(void *)(items->data() + idx);
+	state->extra[1] = items->size();
+	return items->size() - idx;
 }
 
 @end
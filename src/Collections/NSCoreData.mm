@@ -70,12 +70,6 @@
 	return self;
 }
 
-- (id)copyWithZone:(NSZone*)zone
-{
-	return [[[self class] allocWithZone:zone]
-		initWithBytes:&bytes[0] length:bytes.size()];
-}
-
 - (const void*)bytes
 {
 	return &bytes[0];
@@ -28,6 +28,7 @@
  *
  */
 
+#include <algorithm>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -41,12 +42,23 @@
 #import "internal.h"
 #import "NSCoreDictionary.h"
 
-#include <unordered_map>
-typedef std::unordered_map<__strong id,id> _map_table;
+#import "NSCopyOnWrite.h"
+#import "NSOpenTable.h"
+
+typedef _NSOpenTable<id> _map_table;
+typedef _NSCopyOnWrite<_map_table> _shared_table;
+
+/*
+ * Dictionaries with at most this many entries keep them in a small array,
+ * sized to fit, and search them linearly; the hash table is only set up
+ * beyond that, and the array is freed then.
+ */
+#define NSCoreDictionarySmallCount	8
 
 @interface NSCoreDictionary()
 /* Private */
-- (_map_table *)__dictObject;
+- (id)__keyAfterPosition:(NSUInteger *)pos;
+- (id)__initSharingTable:(const _shared_table &)other;
 @end
 
 /*
@@ -55,7 +67,88 @@ typedef std::unordered_map<__strong id,id> _map_table;
 
 @implementation NSCoreDictionary
 {
-	_map_table table;
+	_shared_table table;
+	_map_table::Slot *small;
+	NSUInteger smallCount;
+	NSUInteger smallCapacity;
+	bool hashed;
+	unsigned long mutations;
+}
+
+/* Private */
+
+- (_map_table::Slot *)__smallSlotForKey:(id)aKey hash:(NSUInteger *)hashp
+{
+	NSUInteger hash;
+
+	for (NSUInteger i = 0; i < smallCount; i++)
+	{
+		if (small[i].key == aKey)
+			return &small[i];
+	}
+	hash = _NSOpenTableHash(aKey);
+	if (hashp != NULL)
+		*hashp = hash;
+	for (NSUInteger i = 0; i < smallCount; i++)
+	{
+		if (small[i].hash == hash && [small[i].key isEqual:aKey])
+			return &small[i];
+	}
+	return NULL;
+}
+
+/* Make room for cap small entries, cap being at most the small count. */
+- (void)__reserveSmall:(NSUInteger)cap
+{
+	_map_table::Slot *grown;
+
+	if (cap <= smallCapacity)
+		return;
+	grown = new _map_table::Slot[cap]();
+	for (NSUInteger i = 0; i < smallCount; i++)
+		grown[i] = std::move(small[i]);
+	delete[] small;
+	small = grown;
+	smallCapacity = cap;
+}
+
+/* Move the entries into the hash table, which has room for cap of them. */
+- (void)__convertToTable:(NSUInteger)cap
+{
+	_map_table &t = table.write();
+
+	t.reserve(cap);
+	for (NSUInteger i = 0; i < smallCount; i++)
+		t.insert(small[i].key, small[i].hash, small[i].value);
+	delete[] small;
+	small = NULL;
+	smallCount = smallCapacity = 0;
+	hashed = true;
+}
+
+- (id)__keyAfterPosition:(NSUInteger *)pos
+{
+	NSUInteger i = *pos;
+
+	if (!hashed)
+	{
+		if (i >= smallCount)
+			return nil;
+		*pos = i + 1;
+		return small[i].key;
+	}
+	i = table->next(i);
+	if (i >= table->capacity())
+		return nil;
+	*pos = i + 1;
+	return table->slotAt(i).key;
+}
+
+- (id)__initSharingTable:(const _shared_table &)other
+{
+	table.share(other);
+	hashed = true;
+	return self;
 }
 
 /* Allocating and Initializing */
@@ -67,12 +160,26 @@ typedef std::unordered_map<__strong id,id> _map_table;
 
 - (id)initWithCapacity:(NSUInteger)cap
 {
-	table = _map_table(cap);
+	if (cap > NSCoreDictionarySmallCount)
+		[self __convertToTable:cap];
+	else
+		[self __reserveSmall:cap];
 	return self;
 }
 
+- (void)dealloc
+{
+	delete[] small;
+}
+
 - (id)initWithDictionary:(NSDictionary*)dictionary
 {
+	if ([dictionary isKindOfClass:[NSCoreDictionary class]] &&
+			((NSCoreDictionary *)dictionary)->hashed)
+	{
+		return [self __initSharingTable:((NSCoreDictionary *)dictionary)->table];
+	}
+
 	self = [self initWithCapacity:[dictionary count]];
 	for (id key in dictionary)
 	{
@@ -90,22 +197,20 @@ typedef std::unordered_map<__strong id,id> _map_table;
 
 - (id)objectForKey:(id)aKey
 {
-	_map_table::iterator i = table.find(aKey);
-	if (i != table.end())
-		return i->second;
+	const _map_table::Slot *s;
+
+	if (hashed)
+		s = table->find(aKey);
+	else
+		s = [self __smallSlotForKey:aKey hash:NULL];
+	if (s != NULL)
+		return s->value;
 	return nil;
 }
 
 - (NSUInteger)count
 {
-	return table.size();
-}
-
-/* Private */
-
-- (_map_table *)__dictObject
-{
-	return &table;
+	return hashed ? table->size() : smallCount;
 }
 
 /* Allocating and Initializing */
@@ -123,15 +228,13 @@ typedef std::unordered_map<__strong id,id> _map_table;
 
 	while(count--)
 	{
-		id key;
 		if (!keys[count] || !objects[count])
 		{
 			@throw([NSInvalidArgumentException
 					exceptionWithReason:@"Nil object to be added in dictionary"
 					userInfo:nil]);
 		}
-		key = [keys[count] copyWithZone:NULL];
-		table[key] = objects[count];
+		[self setObject:objects[count] forKey:keys[count]];
 	}
 	return self;
 }
@@ -146,45 +249,107 @@ typedef std::unordered_map<__strong id,id> _map_table;
 				exceptionWithReason:@"Nil object to be added in dictionary"
 				userInfo:nil]);
 	}
-	
-	_map_table::iterator i = table.find(aKey);
-	if (i == table.end())
+
+	NSUInteger hash = 0;
+	_map_table::Slot *s;
+
+	if (hashed)
+	{
+		hash = _NSOpenTableHash(aKey);
+		s = table.write().find(aKey, hash);
+	}
+	else
+	{
+		/* Identical keys are found without sending -hash at all. */
+		s = [self __smallSlotForKey:aKey hash:&hash];
+	}
+
+	if (s != NULL)
 	{
-		aKey = [aKey copyWithZone:NULL];
+		s->value = anObject;
+		return;
 	}
-	table[aKey] = anObject;
+
+	id key = [aKey copyWithZone:NULL];
+
+	if (!hashed && smallCount == NSCoreDictionarySmallCount)
+		[self __convertToTable:smallCount + 1];
+	else if (!hashed && smallCount == smallCapacity)
+		[self __reserveSmall:std::min<NSUInteger>(
+				std::max<NSUInteger>(2 * smallCapacity, 2),
+				NSCoreDictionarySmallCount)];
+	if (hashed)
+		table.write().insert(key, hash, anObject);
+	else
+		small[smallCount++] = _map_table::Slot{hash, key, anObject};
+	mutations++;
 }
 
 - (void)removeObjectForKey:(id)aKey
 {
-	table.erase(aKey);
+	if (hashed)
+	{
+		NSUInteger hash = _NSOpenTableHash(aKey);
+
+		/* Don't unshare the table for a key that isn't there. */
+		if (table->find(aKey, hash) != NULL && table.write().erase(aKey, hash))
+			mutations++;
+		return;
+	}
+
+	_map_table::Slot *s = [self __smallSlotForKey:aKey hash:NULL];
+
+	if (s == NULL)
+		return;
+
+	/*
+	 * Fill the hole with the last entry, releasing the removed one only once
+	 * the dictionary is consistent again.
+	 */
+	_map_table::Slot removed = std::move(*s);
+
+	if (s != &small[smallCount - 1])
+		*s = std::move(small[smallCount - 1]);
+	small[smallCount - 1].key = nil;
+	small[smallCount - 1].value = nil;
+	smallCount--;
+	mutations++;
 }
 
 - (void)removeAllObjects
 {
-	table.clear();
+	/* Released once the dictionary is empty. */
+	_map_table::Slot *removed = small;
+
+	small = NULL;
+	smallCount = smallCapacity = 0;
+	hashed = false;
+	table.reset();
+	mutations++;
+	delete[] removed;
 }
 
 - (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
 	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
 {
-	_map_table::const_iterator i = table.cbegin();
+	NSUInteger pos = 0;
 	NSUInteger j = 0;
+	id key;
+
 	if (state->state == 0)
 	{
 		state->state = 1;
 	}
 	else
 	{
-		advance(i, state->extra[1]);
+		pos = state->extra[1];
 	}
 	state->itemsPtr = stackBuf;
-	for (; j < len && i != table.end(); j++, i++)
-		state->itemsPtr[j] = i->first;
-	state->mutationsPtr = (unsigned long *)&table;
+	for (; j < len && (key = [self __keyAfterPosition:&pos]) != nil; j++)
+		state->itemsPtr[j] = key;
+	state->mutationsPtr = &mutations;
 	/* LP model makes long and void* the same size, which makes this doable. */
-	if (i != table.end())
-		state->extra[1] = std::distance(table.cbegin(), i);
+	state->extra[1] = pos;
 	return j;
 }
 
@@ -197,30 +362,19 @@ typedef std::unordered_map<__strong id,id> _map_table;
 @implementation _CoreDictionaryEnumerator
 {
 	NSCoreDictionary *d;
-	_map_table *table;
-	_map_table::const_iterator i;
-	bool valEnum;
+	NSUInteger pos;
 }
 
 - (id) initWithDictionary:(NSCoreDictionary*)_dict
 {
 	d = _dict;
-	table = [d __dictObject];
-	i = table->begin();
+	pos = 0;
 	return self;
 }
 
 - (id) nextObject
 {
-	id obj;
-
-	if (i == table->end())
-		return nil;
-
-	obj = i->first;
-	i++;
-
-	return obj;
+	return [d __keyAfterPosition:&pos];
 }
 
 @end
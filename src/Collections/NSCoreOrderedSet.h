@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+
+#import <Foundation/NSOrderedSet.h>
+#include <unordered_map>
+#include <vector>
+
+typedef std::vector<id> _NSOrderedSetObjects;
+typedef std::unordered_map<id, NSUInteger> _NSOrderedSetIndex;
+
+/*
+ * Core class for NSOrderedSet.
+ *
+ * Objects are kept in insertion order in a contiguous vector, with a hash
+ * index mapping each object to its position, so membership tests, index
+ * lookups and duplicate rejection don't need to scan the vector.
+ */
+@interface NSCoreOrderedSet : NSMutableOrderedSet
+
+- (id) init;
+- (id) initWithCapacity:(NSUInteger)cap;
+- (id) initWithObjects:(const id[])objs count:(NSUInteger)count;
+
+- (NSUInteger) count;
+- (id) objectAtIndex:(NSUInteger)idx;
+- (NSUInteger) indexOfObject:(id)obj;
+
+- (void) insertObject:(id)obj atIndex:(NSUInteger)idx;
+- (void) removeObjectAtIndex:(NSUInteger)idx;
+- (void) replaceObjectAtIndex:(NSUInteger)idx withObject:(id)obj;
+- (void) removeAllObjects;
+
+/* Direct access to the backing storage, for the array and set facades. */
+- (_NSOrderedSetObjects *) __objects;
+- (_NSOrderedSetIndex *) __index;
+
+@end
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+
+#include <algorithm>
+
+#import "internal.h"
+#import "NSCoreOrderedSet.h"
+
+#import <Foundation/NSException.h>
+
+@implementation NSCoreOrderedSet
+{
+	_NSOrderedSetObjects objects;
+	_NSOrderedSetIndex index;
+	unsigned long mutations;
+}
+
+- (id) init
+{
+	return [self initWithCapacity:0];
+}
+
+- (id) initWithCapacity:(NSUInteger)cap
+{
+	objects.reserve(cap);
+	index.reserve(cap);
+	return self;
+}
+
+- (id) initWithObjects:(const id[])objs count:(NSUInteger)count
+{
+	self = [self initWithCapacity:count];
+
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		if (objs[i] == nil)
+		{
+			@throw [NSInvalidArgumentException
+				exceptionWithReason:@"Nil object to be added in ordered set"
+				userInfo:nil];
+		}
+		if (index.emplace(objs[i], objects.size()).second)
+			objects.push_back(objs[i]);
+	}
+	return self;
+}
+
+/*
+ * Positions after 'start' shifted, so bring the index back in line with the
+ * vector.
+ */
+- (void) _reindexFrom:(NSUInteger)start
+{
+	for (NSUInteger i = start; i < objects.size(); i++)
+	{
+		index.find(objects[i])->second = i;
+	}
+}
+
+- (NSUInteger) count
+{
+	return objects.size();
+}
+
+- (id) objectAtIndex:(NSUInteger)idx
+{
+	if (idx >= objects.size())
+	{
+		@throw [NSRangeException
+			exceptionWithReason:@"Index out of bounds in -[NSCoreOrderedSet objectAtIndex:]"
+			userInfo:nil];
+	}
+	return objects[idx];
+}
+
+- (NSUInteger) indexOfObject:(id)obj
+{
+	_NSOrderedSetIndex::const_iterator i = index.find(obj);
+
+	if (i == index.end())
+		return NSNotFound;
+	return i->second;
+}
+
+- (bool) containsObject:(id)obj
+{
+	return (index.find(obj) != index.end());
+}
+
+- (void) getObjects:(id __unsafe_unretained [])objs range:(NSRange)range
+{
+	NSParameterAssert(NSMaxRange(range) <= objects.size());
+
+	std::copy(objects.begin() + range.location,
+			objects.begin() + NSMaxRange(range), objs);
+}
+
+- (void) insertObject:(id)obj atIndex:(NSUInteger)idx
+{
+	if (obj == nil)
+	{
+		@throw [NSInvalidArgumentException
+			exceptionWithReason:@"Nil object to be added in ordered set"
+			userInfo:nil];
+	}
+	if (idx > objects.size())
+	{
+		@throw [NSRangeException
+			exceptionWithReason:@"-[NSCoreOrderedSet insertObject:atIndex:]"
+			userInfo:nil];
+	}
+	if (!index.emplace(obj, idx).second)
+		return;
+
+	mutations++;
+	objects.insert(objects.begin() + idx, obj);
+	[self _reindexFrom:idx + 1];
+}
+
+- (void) addObject:(id)obj
+{
+	[self insertObject:obj atIndex:objects.size()];
+}
+
+- (void) addObjects:(const id[])objs count:(NSUInteger)count
+{
+	objects.reserve(objects.size() + count);
+	index.reserve(objects.size() + count);
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		[self insertObject:objs[i] atIndex:objects.size()];
+	}
+}
+
+- (void) addObjectsFromArray:(NSArray *)array
+{
+	objects.reserve(objects.size() + [array count]);
+	index.reserve(objects.size() + [array count]);
+	for (id obj in array)
+	{
+		[self insertObject:obj atIndex:objects.size()];
+	}
+}
+
+- (void) removeObjectAtIndex:(NSUInteger)idx
+{
+	if (idx >= objects.size())
+	{
+		@throw [NSRangeException
+			exceptionWithReason:@"-[NSCoreOrderedSet removeObjectAtIndex:]"
+			userInfo:nil];
+	}
+	mutations++;
+	index.erase(objects[idx]);
+	objects.erase(objects.begin() + idx);
+	[self _reindexFrom:idx];
+}
+
+- (void) removeObject:(id)obj
+{
+	_NSOrderedSetIndex::iterator i = index.find(obj);
+
+	if (i != index.end())
+		[self removeObjectAtIndex:i->second];
+}
+
+- (void) removeObjectsInRange:(NSRange)range
+{
+	NSParameterAssert(NSMaxRange(range) <= objects.size());
+
+	mutations++;
+	for (NSUInteger i = range.location; i < NSMaxRange(range); i++)
+	{
+		index.erase(objects[i]);
+	}
+	objects.erase(objects.begin() + range.location,
+			objects.begin() + NSMaxRange(range));
+	[self _reindexFrom:range.location];
+}
+
+- (void) removeAllObjects
+{
+	mutations++;
+	index.clear();
+	objects.clear();
+}
+
+/*
+ * As with the generic implementation, replacing with an object that's already
+ * elsewhere in the set is a no-op.
+ */
+- (void) replaceObjectAtIndex:(NSUInteger)idx withObject:(id)obj
+{
+	if (obj == nil)
+	{
+		@throw [NSInvalidArgumentException
+			exceptionWithReason:@"Nil object to be added in ordered set"
+			userInfo:nil];
+	}
+	if (idx >= objects.size())
+	{
+		@throw [NSRangeException
+			exceptionWithReason:@"-[NSCoreOrderedSet replaceObjectAtIndex:withObject:]"
+			userInfo:nil];
+	}
+
+	_NSOrderedSetIndex::iterator i = index.find(obj);
+
+	if (i != index.end() && i->second != idx)
+		return;
+
+	mutations++;
+	index.erase(objects[idx]);
+	objects[idx] = obj;
+	index.emplace(obj, idx);
+}
+
+- (void) exchangeObjectAtIndex:(NSUInteger)idx1 withObjectAtIndex:(NSUInteger)idx2
+{
+	NSParameterAssert(idx1 < objects.size() && idx2 < objects.size());
+
+	mutations++;
+	std::swap(objects[idx1], objects[idx2]);
+	index.find(objects[idx1])->second = idx1;
+	index.find(objects[idx2])->second = idx2;
+}
+
+- (_NSOrderedSetObjects *) __objects
+{
+	return &objects;
+}
+
+- (_NSOrderedSetIndex *) __index
+{
+	return &index;
+}
+
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	NSUInteger idx = 0;
+
+	if (state->state == 0)
+	{
+		state->state = 1;
+	}
+	else
+	{
+		idx = state->extra[0];
+	}
+	state->mutationsPtr = &mutations;
+	state->itemsPtr = stackBuf;
+	len = std::min(len, (NSUInteger)(objects.size() - idx));
+	std::copy(objects.begin() + idx, objects.begin() + idx + len, stackBuf);
+	state->extra[0] = idx + len;
+	return len;
+}
+
+@end
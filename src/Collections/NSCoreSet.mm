@@ -32,19 +32,48 @@
 #import "NSCoreSet.h"
 #import <Foundation/NSArray.h>
 #include <unordered_set>
+
+#import "NSCopyOnWrite.h"
+
 typedef std::unordered_set<id> intern_set;
+typedef _NSCopyOnWrite<intern_set> shared_set;
 
 /*
  * NSCoreSet
  */
 
 @interface NSCoreSet ()
-- (intern_set *)__setObject;
+- (id)__initSharingSet:(const shared_set &)other;
+- (const shared_set &)__set;
 @end
 
+/* Fast enumeration over a hash set, resuming at the position in extra[1]. */
+static NSUInteger _SetEnumerate(const intern_set &set,
+	NSFastEnumerationState *state, __unsafe_unretained id stackBuf[],
+	NSUInteger len)
+{
+	intern_set::const_iterator i = set.cbegin();
+	NSUInteger j = 0;
+
+	if (state->state == 0)
+	{
+		state->state = 1;
+	}
+	else
+	{
+		std::advance(i, state->extra[1]);
+	}
+	state->itemsPtr = stackBuf;
+	for (; j < len && i != set.cend(); j++, i++)
+		state->itemsPtr[j] = *i;
+	state->mutationsPtr = &state->extra[0];
+	state->extra[1] += j;
+	return j;
+}
+
 @implementation NSCoreSet
 {
-	intern_set set;
+	shared_set set;
 }
 
 - (id)init
@@ -54,7 +83,8 @@ typedef std::unordered_set<id> intern_set;
 
 - (id)initWithCapacity:(NSUInteger)_capacity
 {
-	set = intern_set(_capacity);
+	if (_capacity > 0)
+		set.write().reserve(_capacity);
 	return self;
 }
 
@@ -70,25 +100,35 @@ typedef std::unordered_set<id> intern_set;
 	return self;
 }
 
-/* Copying */
+- (id)initWithSet:(NSSet *)other copyItems:(bool)flag
+{
+	if (!flag && [other isKindOfClass:[NSCoreSet class]])
+		return [self __initSharingSet:((NSCoreSet *)other)->set];
+	return [super initWithSet:other copyItems:flag];
+}
 
-- (id)copyWithZone:(NSZone*)_zone
+- (id)__initSharingSet:(const shared_set &)other
 {
-	return [[NSCoreSet allocWithZone:_zone]
-			initWithSet:self copyItems:true];
+	set.share(other);
+	return self;
+}
+
+- (const shared_set &)__set
+{
+	return set;
 }
 
 /* Accessing keys and values */
 
 - (NSUInteger)count
 {
-	return set.size();
+	return set->size();
 }
 
 - (id)member:(id)anObject
 {
-	intern_set::iterator i = set.find(anObject);
-	if (i != set.end())
+	intern_set::const_iterator i = set->find(anObject);
+	if (i != set->end())
 		return *i;
 	return nil;
 }
@@ -104,46 +144,25 @@ typedef std::unordered_set<id> intern_set;
 
 - (void)addObject:(id)object
 {
-	set.insert(object);
+	set.write().insert(object);
 }
 
 - (void)removeObject:(id)object
 {
-	set.erase(object);
+	/* Don't unshare the set for an object that isn't there. */
+	if (set->find(object) != set->end())
+		set.write().erase(object);
 }
 
 - (void)removeAllObjects
 {
-	set.clear();
-}
-
-- (intern_set *)__setObject
-{
-	return &set;
+	set.reset();
 }
 
 - (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
 	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
 {
-	intern_set::const_iterator i;
-	NSUInteger j = 0;
-	i = set.cbegin();
-	if (state->state == 0)
-	{
-		state->state = 1;
-	}
-	else
-	{
-		advance(i, state->extra[1]);
-	}
-	state->itemsPtr = stackBuf;
-	for (; j < len && i != set.end(); j++, i++)
-		state->itemsPtr[j] = *i;
-	state->mutationsPtr = (unsigned long *)&set;
-	/* LP model makes long and void* the same size, which makes this doable. */
-	if (i != set.end())
-		state->extra[1] = std::distance(set.cbegin(), i);
-	return j;
+	return _SetEnumerate(*set, state, stackBuf, len);
 }
 @end /* NSCoreSet */
 
@@ -154,14 +173,14 @@ typedef std::unordered_set<id> intern_set;
 @implementation _ConcreteSetEnumerator
 {
 	NSCoreSet *set;
-	intern_set *table;
-	intern_set::iterator i;
+	const intern_set *table;
+	intern_set::const_iterator i;
 }
 
 - (id) initWithSet:(NSCoreSet*)_set
 {
 	set = _set;
-	table = [_set __setObject];
+	table = &*[_set __set];
 	i = table->begin();
 
 	return self;
@@ -31,21 +31,29 @@
 #import <Foundation/NSArray.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSEnumerator.h>
+#import <Foundation/NSException.h>
 #import "internal.h"
-#include <unordered_set>
-typedef std::unordered_multiset<id> _map_table;
+#import "NSOpenTable.h"
+
+/* Each distinct object maps to the number of times it was added. */
+typedef _NSOpenTable<NSUInteger> _count_table;
 
 @interface _CountedSetEnumerator :	NSEnumerator
 {
-	_map_table::iterator i;
-	_map_table *t;
+	NSCountedSet *set;
+	_count_table *t;
+	NSUInteger i;
 }
-- (id) initWithTable:(_map_table *)t;
+- (id) initWithSet:(NSCountedSet *)s table:(_count_table *)t;
+@end
+
+@interface NSCountedSet()
+- (void) __addObject:(id)object count:(NSUInteger)n;
 @end
 
 @implementation NSCountedSet
 {
-	_map_table table;
+	_count_table table;
 }
 
 -(id)initWithCapacity:(NSUInteger)numItems
@@ -53,6 +61,7 @@ typedef std::unordered_multiset<id> _map_table;
 	if ((self = [super initWithCapacity:numItems]) == nil)
 		return nil;
 
+	table.reserve(numItems);
 	return self;
 }
 
@@ -62,39 +71,56 @@ typedef std::unordered_multiset<id> _map_table;
 		return nil;
 
 	for (NSUInteger i = 0; i < count; i++)
-		table.insert(objects[i]);
+		[self __addObject:objects[i] count:1];
 
 	return self;
 }
 
 - (id) initWithArray:(NSArray *)array
 {
+	if ((self = [self initWithCapacity:[array count]]) == nil)
+		return nil;
+
 	for (id item in array)
 	{
-		[self addObject:item];
+		[self __addObject:item count:1];
 	}
 	return self;
 }
 
 - (id) initWithSet:(NSSet *)set
 {
-	bool countedSet = [set isKindOfClass:[self class]];
-	void (*adder)(id, SEL, id) = (void (*)(id, SEL, id))[self methodForSelector:@selector(addObject:)];
+	if ((self = [self initWithCapacity:[set count]]) == nil)
+		return nil;
+
+	bool countedSet = [set isKindOfClass:[NSCountedSet class]];
 	for (id item in set)
 	{
-		adder(self, @selector(addObject:), item);
-		[self addObject:item];
-		if (countedSet)
-		{
-			for (int i = [(NSCountedSet *)set countForObject:item] - 1; i > 0; i--)
-			{
-				adder(self, @selector(addObject:), item);
-			}
-		}
+		[self __addObject:item
+			count:(countedSet ? [(NSCountedSet *)set countForObject:item] : 1)];
 	}
 	return self;
 }
 
+- (void) __addObject:(id)object count:(NSUInteger)n
+{
+	/* A nil key marks an empty slot in the table. */
+	if (object == nil)
+	{
+		@throw([NSInvalidArgumentException
+				exceptionWithReason:@"Nil object to be added in counted set"
+				userInfo:nil]);
+	}
+
+	NSUInteger hash = _NSOpenTableHash(object);
+	_count_table::Slot *s = table.find(object, hash);
+
+	if (s != NULL)
+		s->value += n;
+	else
+		table.insert(object, hash, n);
+}
+
 -(NSUInteger)count
 {
 	return table.size();
@@ -102,15 +128,30 @@ typedef std::unordered_multiset<id> _map_table;
 
 -(id)member:(id)anObject
 {
-	_map_table::iterator i = table.find(anObject);
-	if (i != table.end())
-		return *i;
+	_count_table::Slot *s = table.find(anObject);
+	if (s != NULL)
+		return s->key;
 	return nil;
 }
 
 -(NSEnumerator *)objectEnumerator
 {
-	return [[_CountedSetEnumerator alloc] initWithTable:&table];
+	return [[_CountedSetEnumerator alloc] initWithSet:self table:&table];
+}
+
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	NSUInteger i = state->extra[1];
+	NSUInteger j = 0;
+
+	state->state = 1;
+	state->itemsPtr = stackBuf;
+	state->mutationsPtr = table.mutationsPtr();
+	for (; j < len && (i = table.next(i)) < table.capacity(); j++, i++)
+		state->itemsPtr[j] = table.slotAt(i).key;
+	state->extra[1] = i;
+	return j;
 }
 
 -(bool)isEqualToSet:(NSSet *)otherSet
@@ -123,10 +164,11 @@ typedef std::unordered_multiset<id> _map_table;
 
 	if ([otherSet isKindOfClass:[NSCountedSet class]])
 	{
-		_map_table::iterator i = table.begin();
-		for (; i != table.end(); i++)
+		for (NSUInteger i = 0; (i = table.next(i)) < table.capacity(); i++)
 		{
-			if ([(NSCountedSet *)otherSet countForObject:*i] != table.count(*i))
+			const _count_table::Slot &s = table.slotAt(i);
+
+			if ([(NSCountedSet *)otherSet countForObject:s.key] != s.value)
 				return false;
 		}
 		return true;
@@ -136,35 +178,60 @@ typedef std::unordered_multiset<id> _map_table;
 
 -(void)addObject:(id)object
 {
-	table.insert(object);
+	[self __addObject:object count:1];
+}
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+	/* Assume mostly new objects; duplicates only leave the table sparser. */
+	table.reserve(table.size() + [array count]);
+	for (id obj in array)
+	{
+		[self __addObject:obj count:1];
+	}
 }
 
 -(void)removeObject:(id)object
 {
-	_map_table::iterator i = table.find(object);
-	if (i != table.end())
-		table.erase(i);
+	NSUInteger hash = _NSOpenTableHash(object);
+	_count_table::Slot *s = table.find(object, hash);
+
+	if (s == NULL)
+		return;
+	if (s->value > 1)
+		s->value--;
+	else
+		table.erase(object, hash);
+}
+
+- (void)removeAllObjects
+{
+	table.clear();
 }
 
 - (size_t) countForObject:(id)object
 {
-	return table.count(object);
+	_count_table::Slot *s = table.find(object);
+
+	return (s != NULL) ? s->value : 0;
 }
 
 @end
 
 @implementation _CountedSetEnumerator
-- (id) initWithTable:(_map_table *)table
+- (id) initWithSet:(NSCountedSet *)s table:(_count_table *)table
 {
+	set = s;
 	t = table;
-	i = t->begin();
+	i = 0;
 	return self;
 }
 
 - (id) nextObject
 {
-	if (i == t->end())
+	i = t->next(i);
+	if (i >= t->capacity())
 		return nil;
-	return *(i++);
+	return t->slotAt(i++).key;
 }
 @end
@@ -31,13 +31,18 @@
 #import <Foundation/NSFileHandle.h>
 #import <Foundation/NSFileManager.h>
 #import <Foundation/NSRange.h>
+#import <Foundation/NSURL.h>
 #include <netinet/in.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <resolv.h>
 
 #import "internal.h"
+#import "NSConcreteData.h"
 #import "NSCoreData.h"
+#import "NSMappedData.h"
 
 @implementation NSData
 
@@ -60,7 +65,7 @@
 + (id)allocWithZone:(NSZone*)zone
 {
 	return NSAllocateObject(((self == [NSData class]) ?
-				[NSCoreData class] : (Class)self), 0, zone);
+				[NSConcreteData class] : (Class)self), 0, zone);
 }
 
 + (id)data
@@ -128,6 +133,17 @@
 	return self;
 }
 
+/* Subclasses that can't adopt the buffer copy it and give it straight back. */
+- (id)initWithBytesNoCopy:(void*)bytes
+    length:(NSUInteger)length
+	deallocator:(void (^)(void *, NSUInteger))deallocator
+{
+	self = [self initWithBytes:bytes length:length];
+	if (deallocator != nil)
+		deallocator(bytes, length);
+	return self;
+}
+
 - (id) initWithContentsOfURL:(NSURL *)uri
 {
 	return [self initWithContentsOfURL:uri options:0 error:NULL];
@@ -135,6 +151,21 @@
 
 - (id) initWithContentsOfURL:(NSURL *)url options:(NSUInteger)options error:(NSError **)errp
 {
+	if ((options & (NSDataReadingMappedIfSafe | NSDataReadingMappedAlways)) &&
+			[url isFileURL] && ![self isKindOfClass:[NSMutableData class]])
+	{
+		int fd = open([[url path] fileSystemRepresentation], O_RDONLY | O_CLOEXEC);
+
+		if (fd >= 0)
+		{
+			NSData *mapped = _NSMappedDataWithFileDescriptor(fd, options);
+
+			close(fd);
+			if (mapped != nil)
+				return mapped;
+		}
+	}
+
 	NSFileHandle *fh = [[NSFileManager defaultManager] fileHandleForReadingAtURL:url error:errp];
 
 	return [fh readDataToEndOfFile];
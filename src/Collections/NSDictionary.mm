@@ -69,6 +69,7 @@
 #import <Foundation/NSString.h>
 
 #import "NSCoreDictionary.h"
+#import "NSFrozenCollections.h"
 
 @interface NSDictionary(DictionaryExtensions)
 - (id)initWithObjectsAndKeys:(id)firstObject arguments:(va_list)argList;
@@ -100,9 +101,10 @@ static Class CoreDictionaryClass;
 
 + (id)allocWithZone:(NSZone *)zone
 {
-	id s = NSAllocateObject((self == DictionaryClass) ? CoreDictionaryClass : (Class)self, 0, zone);
-
-	return s;
+	/* Immutable instances are sized and built by their initializer. */
+	if (self == DictionaryClass)
+		return [NSTemporaryDictionary allocWithZone:zone];
+	return NSAllocateObject(self, 0, zone);
 }
 
 + (id)dictionary
@@ -724,6 +726,11 @@ static NSComparisonResult compareVals(id key1, id key2, void *ctx)
 	return self;
 }
 
+- (id)copyWithZone:(NSZone*)zone
+{
+	return [[NSDictionary allocWithZone:zone] initWithDictionary:self];
+}
+
 /* Adding and Removing Entries */
 
 - (void)addEntriesFromDictionary:(NSDictionary*)otherDictionary
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSSet.h>
+
+/*
+ * Frozen immutable dictionaries and sets.
+ *
+ * These are what NSDictionary and NSSet instantiate, and what copying a
+ * mutable dictionary or set produces.  Their contents are laid out once, in
+ * storage allocated along with the object: the keys (and values), their
+ * cached hashes, and a small open addressed index of 32-bit entry numbers,
+ * sized to the number of entries.
+ */
+
+@interface NSFrozenDictionary : NSDictionary
++ (id) allocWithCount:(NSUInteger)count zone:(NSZone *)zone;
+- (id) initWithObjects:(const id [])objects forKeys:(const id<NSCopying> [])keys
+	count:(NSUInteger)count;
+@end
+
+@interface NSFrozenSet : NSSet
++ (id) allocWithCount:(NSUInteger)count zone:(NSZone *)zone;
+- (id) initWithObjects:(const id [])objects count:(NSUInteger)count;
+@end
+
+/*
+ * What +[NSDictionary alloc] and +[NSSet alloc] return.  The initializers
+ * size and build the frozen instance.
+ */
+@interface NSTemporaryDictionary : NSDictionary
+@end
+
+@interface NSTemporarySet : NSSet
+@end
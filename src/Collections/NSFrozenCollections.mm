@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <stdint.h>
+
+#import <Foundation/NSEnumerator.h>
+#import <Foundation/NSException.h>
+
+#import "internal.h"
+#import "NSFrozenCollections.h"
+#import "NSOpenTable.h"
+
+/*
+ * Index slots for count entries: a power of two, at most two thirds full so
+ * probes stay short and always reach an empty slot.
+ */
+static NSUInteger _FrozenIndexSize(NSUInteger count)
+{
+	NSUInteger size = 4;
+
+	if (count == 0)
+		return 0;
+	while (size < count + (count + 1) / 2)
+		size *= 2;
+	return size;
+}
+
+static size_t _FrozenStorageSize(NSUInteger count, NSUInteger objectsPerEntry)
+{
+	if (count >= UINT32_MAX)
+	{
+		@throw [NSInvalidArgumentException
+			exceptionWithReason:@"Too many entries for an immutable collection"
+			userInfo:nil];
+	}
+	return count * (objectsPerEntry * sizeof(id) + sizeof(NSUInteger)) +
+		_FrozenIndexSize(count) * sizeof(uint32_t);
+}
+
+/*
+ * Index slots hold entry numbers plus one, so that zero marks an empty slot.
+ * Returns the entry holding key, or NSNotFound.
+ */
+static inline NSUInteger _FrozenFind(const uint32_t *index, NSUInteger mask,
+		__strong id *keys, const NSUInteger *hashes, id key, NSUInteger hash)
+{
+	for (NSUInteger i = hash & mask; ; i = (i + 1) & mask)
+	{
+		uint32_t e = index[i];
+
+		if (e-- == 0)
+			return NSNotFound;
+		if (keys[e] == key || (hashes[e] == hash && [keys[e] isEqual:key]))
+			return e;
+	}
+}
+
+/*
+ * Index key as entry n, unless an equal key is already present.  Returns the
+ * entry holding the key; if that's n the caller fills the entry in.
+ */
+static NSUInteger _FrozenAdd(uint32_t *index, NSUInteger mask,
+		__strong id *keys, const NSUInteger *hashes, id key, NSUInteger hash,
+		NSUInteger n)
+{
+	for (NSUInteger i = hash & mask; ; i = (i + 1) & mask)
+	{
+		uint32_t e = index[i];
+
+		if (e-- == 0)
+		{
+			index[i] = (uint32_t)(n + 1);
+			return n;
+		}
+		if (keys[e] == key || (hashes[e] == hash && [keys[e] isEqual:key]))
+			return e;
+	}
+}
+
+@implementation NSFrozenDictionary
+{
+	NSUInteger count;
+	NSUInteger mask;
+	__strong id *keys;
+	__strong id *values;
+	NSUInteger *hashes;
+	uint32_t *index;
+}
+
++ (id) allocWithCount:(NSUInteger)n zone:(NSZone *)zone
+{
+	return NSAllocateObject(self, _FrozenStorageSize(n, 2), zone);
+}
+
+/*
+ * Duplicate keys keep the first value given for them.  Storage must have
+ * come from +allocWithCount:zone: with at least n entries.
+ */
+- (id) initWithObjects:(const id [])objects forKeys:(const id<NSCopying> [])inKeys
+	count:(NSUInteger)n
+{
+	char *storage = (char *)object_getIndexedIvars(self);
+
+	keys = (__strong id *)(void *)storage;
+	values = keys + n;
+	hashes = (NSUInteger *)(void *)(values + n);
+	index = (uint32_t *)(void *)(hashes + n);
+	mask = _FrozenIndexSize(n) - 1;
+
+	for (NSUInteger i = 0; i < n; i++)
+	{
+		if (!inKeys[i] || !objects[i])
+		{
+			@throw([NSInvalidArgumentException
+					exceptionWithReason:@"Nil object to be added in dictionary"
+					userInfo:nil]);
+		}
+
+		NSUInteger hash = _NSOpenTableHash(inKeys[i]);
+
+		if (_FrozenAdd(index, mask, keys, hashes, inKeys[i], hash, count) == count)
+		{
+			keys[count] = [inKeys[i] copyWithZone:NULL];
+			values[count] = objects[i];
+			hashes[count] = hash;
+			count++;
+		}
+	}
+	return self;
+}
+
+- (void) dealloc
+{
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		keys[i] = nil;
+		values[i] = nil;
+	}
+}
+
+- (NSUInteger) count
+{
+	return count;
+}
+
+- (id) objectForKey:(id)aKey
+{
+	if (count == 0 || aKey == nil)
+		return nil;
+
+	NSUInteger e = _FrozenFind(index, mask, keys, hashes, aKey,
+			_NSOpenTableHash(aKey));
+
+	return (e == NSNotFound) ? nil : values[e];
+}
+
+- (NSEnumerator *) keyEnumerator
+{
+	__block NSUInteger i = 0;
+
+	return [[NSBlockEnumerator alloc] initWithBlock:^id(){
+		return (i < count) ? keys[i++] : nil;
+	}];
+}
+
+- (NSEnumerator *) objectEnumerator
+{
+	__block NSUInteger i = 0;
+
+	return [[NSBlockEnumerator alloc] initWithBlock:^id(){
+		return (i < count) ? values[i++] : nil;
+	}];
+}
+
+- (void) enumerateKeysAndObjectsWithOptions:(NSEnumerationOptions)opts
+	usingBlock:(void (^)(id key, id obj, bool *stop))block
+{
+	bool stop = false;
+
+	for (NSUInteger i = 0; i < count && !stop; i++)
+	{
+		block(keys[i], values[i], &stop);
+	}
+}
+
+/* The keys are contiguous, so they're handed out in one go. */
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	if (state->state != 0)
+		return 0;
+	state->state = 1;
+	state->itemsPtr = (__unsafe_unretained id *)(void *)keys;
+	state->mutationsPtr = (unsigned long *)&count;
+	return count;
+}
+
+@end
+
+@implementation NSFrozenSet
+{
+	NSUInteger count;
+	NSUInteger mask;
+	__strong id *objects;
+	NSUInteger *hashes;
+	uint32_t *index;
+}
+
++ (id) allocWithCount:(NSUInteger)n zone:(NSZone *)zone
+{
+	return NSAllocateObject(self, _FrozenStorageSize(n, 1), zone);
+}
+
+- (id) initWithObjects:(const id [])objs count:(NSUInteger)n
+{
+	char *storage = (char *)object_getIndexedIvars(self);
+
+	objects = (__strong id *)(void *)storage;
+	hashes = (NSUInteger *)(void *)(objects + n);
+	index = (uint32_t *)(void *)(hashes + n);
+	mask = _FrozenIndexSize(n) - 1;
+
+	for (NSUInteger i = 0; i < n; i++)
+	{
+		if (objs[i] == nil)
+		{
+			@throw([NSInvalidArgumentException
+					exceptionWithReason:@"Nil object to be added in set"
+					userInfo:nil]);
+		}
+
+		NSUInteger hash = _NSOpenTableHash(objs[i]);
+
+		if (_FrozenAdd(index, mask, objects, hashes, objs[i], hash, count) == count)
+		{
+			objects[count] = objs[i];
+			hashes[count] = hash;
+			count++;
+		}
+	}
+	return self;
+}
+
+- (void) dealloc
+{
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		objects[i] = nil;
+	}
+}
+
+- (id) copyWithZone:(NSZone *)zone
+{
+	return self;
+}
+
+- (NSUInteger) count
+{
+	return count;
+}
+
+- (id) member:(id)anObject
+{
+	if (count == 0 || anObject == nil)
+		return nil;
+
+	NSUInteger e = _FrozenFind(index, mask, objects, hashes, anObject,
+			_NSOpenTableHash(anObject));
+
+	return (e == NSNotFound) ? nil : objects[e];
+}
+
+- (NSEnumerator *) objectEnumerator
+{
+	__block NSUInteger i = 0;
+
+	return [[NSBlockEnumerator alloc] initWithBlock:^id(){
+		return (i < count) ? objects[i++] : nil;
+	}];
+}
+
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	if (state->state != 0)
+		return 0;
+	state->state = 1;
+	state->itemsPtr = (__unsafe_unretained id *)(void *)objects;
+	state->mutationsPtr = (unsigned long *)&count;
+	return count;
+}
+
+@end
+
+static NSTemporaryDictionary *placeholderDictionary;
+static NSFrozenDictionary *emptyDictionary;
+
+@implementation NSTemporaryDictionary
+
++ (void) initialize
+{
+	if (self == [NSTemporaryDictionary class])
+	{
+		placeholderDictionary = NSAllocateObject(self, 0, NULL);
+		emptyDictionary = [[NSFrozenDictionary allocWithCount:0 zone:NULL]
+			initWithObjects:NULL forKeys:NULL count:0];
+	}
+}
+
+/* Only ever one instance, which is never deallocated. */
++ (id) allocWithZone:(NSZone *)zone
+{
+	return placeholderDictionary;
+}
+
+- (id) init
+{
+	return emptyDictionary;
+}
+
+- (id) initWithObjects:(const id [])objects forKeys:(const id<NSCopying> [])keys
+	count:(NSUInteger)count
+{
+	if (count == 0)
+		return emptyDictionary;
+	return [[NSFrozenDictionary allocWithCount:count zone:NULL]
+		initWithObjects:objects forKeys:keys count:count];
+}
+
+@end
+
+static NSTemporarySet *placeholderSet;
+static NSFrozenSet *emptySet;
+
+@implementation NSTemporarySet
+
++ (void) initialize
+{
+	if (self == [NSTemporarySet class])
+	{
+		placeholderSet = NSAllocateObject(self, 0, NULL);
+		emptySet = [[NSFrozenSet allocWithCount:0 zone:NULL]
+			initWithObjects:NULL count:0];
+	}
+}
+
+/* Only ever one instance, which is never deallocated. */
++ (id) allocWithZone:(NSZone *)zone
+{
+	return placeholderSet;
+}
+
+- (id) init
+{
+	return emptySet;
+}
+
+- (id) initWithObjects:(const id [])objects count:(NSUInteger)count
+{
+	if (count == 0)
+		return emptySet;
+	return [[NSFrozenSet allocWithCount:count zone:NULL]
+		initWithObjects:objects count:count];
+}
+
+@end
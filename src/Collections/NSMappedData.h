@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#import <Foundation/NSData.h>
+
+/*
+ * Read-only data backed by a private file mapping.  The mapping is released
+ * when the object is deallocated.
+ */
+@interface NSMappedData : NSData
+{
+	void *map;
+	NSUInteger length;
+}
+- (id) initWithFileDescriptor:(int)fd length:(NSUInteger)len
+	options:(NSDataReadingOptions)options;
+@end
+
+/*
+ * Files at least this large are mapped by -[NSFileManager
+ * contentsOfFileAtURL:shared:error:] when sharing is allowed.
+ */
+#define NSMappedDataThreshold	(1UL << 20)
+
+__BEGIN_DECLS
+/*
+ * Returns true if the file referenced by fd lives on a local filesystem,
+ * where it can be mapped without pages vanishing under us.  Network and FUSE
+ * filesystems are not considered safe.
+ */
+bool _NSFileDescriptorIsSafeToMap(int fd);
+
+/*
+ * Map the regular file referenced by fd, honoring the mapping-related bits of
+ * options.  Returns nil if the file should not or could not be mapped, in
+ * which case the caller should fall back to reading it.  fd may be closed as
+ * soon as this returns.
+ */
+NSData *_NSMappedDataWithFileDescriptor(int fd, NSDataReadingOptions options);
+__END_DECLS
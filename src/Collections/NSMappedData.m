@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <sys/param.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+
+#import "internal.h"
+#import "NSMappedData.h"
+
+#ifdef __linux__
+/* Filesystem magic numbers from linux/magic.h and friends. */
+#define NFS_SUPER_MAGIC		0x6969
+#define SMB_SUPER_MAGIC		0x517B
+#define CIFS_SUPER_MAGIC	0xFF534D42
+#define SMB2_SUPER_MAGIC	0xFE534D42
+#define FUSE_SUPER_MAGIC	0x65735546
+#define CODA_SUPER_MAGIC	0x73757245
+#define AFS_SUPER_MAGIC		0x5346414F
+#define NCP_SUPER_MAGIC		0x564C
+#define CEPH_SUPER_MAGIC	0x00C36400
+#endif
+
+bool _NSFileDescriptorIsSafeToMap(int fd)
+{
+	struct statfs sfs;
+
+	if (fstatfs(fd, &sfs) < 0)
+		return false;
+#ifdef __linux__
+	switch ((uint32_t)sfs.f_type)
+	{
+		case NFS_SUPER_MAGIC:
+		case SMB_SUPER_MAGIC:
+		case CIFS_SUPER_MAGIC:
+		case SMB2_SUPER_MAGIC:
+		case FUSE_SUPER_MAGIC:
+		case CODA_SUPER_MAGIC:
+		case AFS_SUPER_MAGIC:
+		case NCP_SUPER_MAGIC:
+		case CEPH_SUPER_MAGIC:
+			return false;
+	}
+	return true;
+#else
+	if (!(sfs.f_flags & MNT_LOCAL))
+		return false;
+	return (strncmp(sfs.f_fstypename, "fusefs", 6) != 0);
+#endif
+}
+
+NSData *_NSMappedDataWithFileDescriptor(int fd, NSDataReadingOptions options)
+{
+	struct stat sb;
+
+	if (!(options & (NSDataReadingMappedIfSafe | NSDataReadingMappedAlways)))
+		return nil;
+	if (fstat(fd, &sb) < 0 || !S_ISREG(sb.st_mode))
+		return nil;
+	/* Zero-length mappings aren't allowed, and there's nothing to share. */
+	if (sb.st_size == 0 || (uintmax_t)sb.st_size > SIZE_MAX)
+		return nil;
+	if (!(options & NSDataReadingMappedAlways) &&
+			!_NSFileDescriptorIsSafeToMap(fd))
+		return nil;
+
+	return [[NSMappedData alloc] initWithFileDescriptor:fd
+												 length:sb.st_size
+												options:options];
+}
+
+@implementation NSMappedData
+
+- (id) initWithFileDescriptor:(int)fd length:(NSUInteger)len
+	options:(NSDataReadingOptions)options
+{
+	map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		map = NULL;
+		return nil;
+	}
+	length = len;
+
+	if (options & NSDataReadingSequentialAccess)
+		madvise(map, len, MADV_SEQUENTIAL);
+	else if (options & NSDataReadingRandomAccess)
+		madvise(map, len, MADV_RANDOM);
+	return self;
+}
+
+- (void) dealloc
+{
+	if (map != NULL)
+		munmap(map, length);
+}
+
+- (const void *) bytes
+{
+	return map;
+}
+
+- (NSUInteger) length
+{
+	return length;
+}
+
+@end
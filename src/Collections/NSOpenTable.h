@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#ifndef __NSOpenTable_h__
+#define __NSOpenTable_h__
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#import <Foundation/NSObject.h>
+
+/*
+ * Open addressing hash table keyed by objects, used as the backing store of
+ * the core collections.
+ *
+ * Probing is Robin Hood style, and removal shifts the following entries back
+ * rather than leaving tombstones, so lookups stop at the first slot that is
+ * empty or closer to its home than the key would be.  Each slot caches its
+ * key's hash next to the key and value: a probe compares pointers and hashes
+ * before sending -isEqual:, and growing the table never sends -hash again.
+ * Empty slots have a nil key.
+ */
+
+/* Spread the bits of -hash, which are often poor in the low bits. */
+static inline NSUInteger _NSOpenTableHash(id key)
+{
+	uint64_t h = [key hash];
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (NSUInteger)h;
+}
+
+template <typename V>
+class _NSOpenTable
+{
+public:
+	struct Slot
+	{
+		NSUInteger hash;
+		__strong id key;
+		V value;
+	};
+
+	_NSOpenTable() : count(0), mutations(0) {}
+
+	NSUInteger size() const { return count; }
+	/* Number of slots; occupied ones are found with next(). */
+	NSUInteger capacity() const { return slots.size(); }
+	Slot &slotAt(NSUInteger i) { return slots[i]; }
+	const Slot &slotAt(NSUInteger i) const { return slots[i]; }
+	unsigned long *mutationsPtr() { return &mutations; }
+
+	/* Index of the first occupied slot at or after i, or capacity(). */
+	NSUInteger next(NSUInteger i) const
+	{
+		while (i < slots.size() && slots[i].key == nil)
+			i++;
+		return i;
+	}
+
+	/* Make room for n entries without growing. */
+	void reserve(NSUInteger n)
+	{
+		NSUInteger cap = 8;
+
+		if (n == 0)
+			return;
+		while (cap - cap / 8 < n)
+			cap *= 2;
+		if (cap > slots.size())
+			resize(cap);
+	}
+
+	const Slot *find(id key, NSUInteger hash) const
+	{
+		if (count == 0)
+			return NULL;
+
+		NSUInteger mask = slots.size() - 1;
+		NSUInteger i = hash & mask;
+
+		for (NSUInteger dist = 0; ; dist++, i = (i + 1) & mask)
+		{
+			const Slot &s = slots[i];
+
+			if (s.key == nil || ((i - (s.hash & mask)) & mask) < dist)
+				return NULL;
+			if (s.key == key || (s.hash == hash && [s.key isEqual:key]))
+				return &s;
+		}
+	}
+
+	Slot *find(id key, NSUInteger hash)
+	{
+		return const_cast<Slot *>(
+				static_cast<const _NSOpenTable *>(this)->find(key, hash));
+	}
+
+	const Slot *find(id key) const
+	{
+		return (count == 0) ? NULL : find(key, _NSOpenTableHash(key));
+	}
+
+	Slot *find(id key)
+	{
+		return (count == 0) ? NULL : find(key, _NSOpenTableHash(key));
+	}
+
+	/* Add a key known not to be in the table yet. */
+	void insert(id key, NSUInteger hash, V value)
+	{
+		if (count + 1 > slots.size() - slots.size() / 8)
+			resize(slots.empty() ? 8 : slots.size() * 2);
+		place(Slot{hash, key, value});
+		count++;
+		mutations++;
+	}
+
+	bool erase(id key, NSUInteger hash)
+	{
+		Slot *s = find(key, hash);
+
+		if (s == NULL)
+			return false;
+
+		NSUInteger mask = slots.size() - 1;
+		NSUInteger i = s - slots.data();
+		NSUInteger j = (i + 1) & mask;
+		/*
+		 * Hold the removed entry until the table is consistent again, since
+		 * releasing it may run arbitrary code.
+		 */
+		Slot removed = std::move(*s);
+
+		while (slots[j].key != nil && ((j - (slots[j].hash & mask)) & mask) != 0)
+		{
+			slots[i] = std::move(slots[j]);
+			i = j;
+			j = (j + 1) & mask;
+		}
+		slots[i].key = nil;
+		slots[i].value = V();
+		count--;
+		mutations++;
+		return true;
+	}
+
+	bool erase(id key)
+	{
+		return (count == 0) ? false : erase(key, _NSOpenTableHash(key));
+	}
+
+	void clear()
+	{
+		std::vector<Slot> old;
+
+		old.swap(slots);
+		count = 0;
+		mutations++;
+		/* old releases its contents here, with the table already empty. */
+	}
+
+private:
+	std::vector<Slot> slots;
+	NSUInteger count;
+	unsigned long mutations;
+
+	void place(Slot s)
+	{
+		NSUInteger mask = slots.size() - 1;
+		NSUInteger i = s.hash & mask;
+
+		for (NSUInteger dist = 0; ; dist++, i = (i + 1) & mask)
+		{
+			Slot &cur = slots[i];
+
+			if (cur.key == nil)
+			{
+				cur = std::move(s);
+				return;
+			}
+
+			NSUInteger curDist = (i - (cur.hash & mask)) & mask;
+			if (curDist < dist)
+			{
+				std::swap(cur, s);
+				dist = curDist;
+			}
+		}
+	}
+
+	void resize(NSUInteger cap)
+	{
+		std::vector<Slot> old(cap);
+
+		old.swap(slots);
+		for (Slot &s : old)
+		{
+			if (s.key != nil)
+				place(std::move(s));
+		}
+	}
+};
+
+#endif /* __NSOpenTable_h__ */
@@ -37,6 +37,7 @@
 #include <vector>
 
 #import "internal.h"
+#import "NSCoreOrderedSet.h"
 
 #import <Foundation/NSOrderedSet.h>
 
@@ -58,8 +59,25 @@
 - (id) initWithOrderedSet:(NSOrderedSet *)set;
 @end
 
+static Class OrderedSetClass;
+static Class MutableOrderedSetClass;
+static Class CoreOrderedSetClass;
+
 @implementation NSOrderedSet
 
++ (void) initialize
+{
+	OrderedSetClass = [NSOrderedSet class];
+	MutableOrderedSetClass = [NSMutableOrderedSet class];
+	CoreOrderedSetClass = [NSCoreOrderedSet class];
+}
+
++ (id) allocWithZone:(NSZone *)zone
+{
+	return NSAllocateObject((self == OrderedSetClass) ?
+			CoreOrderedSetClass : (Class)self, 0, zone);
+}
+
 + (id) orderedSet
 {
 	return [self new];
@@ -89,10 +107,12 @@
 	objects.push_back(obj);
 	va_start(args, obj);
 
-	for (o = va_arg(args, __unsafe_unretained id); o != nil;)
+	for (o = va_arg(args, __unsafe_unretained id); o != nil;
+			o = va_arg(args, __unsafe_unretained id))
 	{
 		objects.push_back(o);
 	}
+	va_end(args);
 
 	return [[self alloc] initWithObjects:&objects[0] count:objects.size()];
 }
@@ -162,10 +182,12 @@
 	objects.push_back(obj);
 	va_start(args, obj);
 
-	for (o = va_arg(args, __unsafe_unretained id); o != nil;)
+	for (o = va_arg(args, __unsafe_unretained id); o != nil;
+			o = va_arg(args, __unsafe_unretained id))
 	{
 		objects.push_back(o);
 	}
+	va_end(args);
 
 	return [self initWithObjects:&objects[0] count:objects.size()];
 }
@@ -693,6 +715,12 @@
 @end
 
 @implementation NSMutableOrderedSet
++ (id) allocWithZone:(NSZone *)zone
+{
+	return NSAllocateObject((self == MutableOrderedSetClass) ?
+			CoreOrderedSetClass : (Class)self, 0, zone);
+}
+
 + (id) orderedSetWithCapacity:(NSUInteger)cap
 {
 	return [[self alloc] initWithCapacity:cap];
@@ -933,36 +961,77 @@
 
 @end
 
+/*
+ * The facades read straight out of the core class's storage when they can, so
+ * -array and -set are views, not copies.  Any other NSOrderedSet subclass goes
+ * through its primitives.
+ */
 @implementation _NSOrderedSetArrayFacade
 {
 	NSOrderedSet *realSet;
+	_NSOrderedSetObjects *objects;
 }
 
 - (id) initWithOrderedSet:(NSOrderedSet *)set
 {
 	realSet = set;
+	if ([set isKindOfClass:CoreOrderedSetClass])
+		objects = [(NSCoreOrderedSet *)set __objects];
 	return self;
 }
 
 - (NSUInteger) count
 {
+	if (objects != NULL)
+		return objects->size();
 	return [realSet count];
 }
 
 - (id) objectAtIndex:(NSUInteger)index
 {
+	if (objects != NULL)
+	{
+		if (index >= objects->size())
+		{
+			@throw [NSRangeException
+				exceptionWithReason:@"Index out of bounds in -[NSArray objectAtIndex:]"
+				userInfo:nil];
+		}
+		return (*objects)[index];
+	}
 	return [realSet objectAtIndex:index];
 }
+
+- (bool) containsObject:(id)obj
+{
+	return [realSet containsObject:obj];
+}
+
+- (NSUInteger) indexOfObject:(id)obj
+{
+	return [realSet indexOfObject:obj];
+}
+
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	return [realSet countByEnumeratingWithState:state
+		objects:stackBuf
+		  count:len];
+}
 @end
 
 @implementation _NSOrderedSetSetFacade
 {
 	NSOrderedSet *realSet;
+	_NSOrderedSetIndex *index;
 }
 
 - (id) initWithOrderedSet:(NSOrderedSet *)set
 {
 	realSet = set;
+	if ([set isKindOfClass:CoreOrderedSetClass])
+		index = [(NSCoreOrderedSet *)set __index];
 	return self;
 }
 
@@ -973,6 +1042,15 @@
 
 - (id) member:(id)obj
 {
+	if (index != NULL)
+	{
+		_NSOrderedSetIndex::const_iterator i = index->find(obj);
+
+		if (i != index->end())
+			return i->first;
+		return nil;
+	}
+
 	NSUInteger idx = [realSet indexOfObject:obj];
 
 	if (idx != NSNotFound)
@@ -988,4 +1066,12 @@
 	return [realSet objectEnumerator];
 }
 
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state
+	objects:(__unsafe_unretained id [])stackBuf count:(NSUInteger)len
+{
+	return [realSet countByEnumeratingWithState:state
+		objects:stackBuf
+		  count:len];
+}
+
 @end
@@ -66,6 +66,7 @@
 #import <Foundation/NSCoder.h>
 
 #import "NSCoreSet.h"
+#import "NSFrozenCollections.h"
 
 /*
  * NSSet
@@ -94,7 +95,10 @@ static Class CoreSetClass;
 
 + (id)allocWithZone:(NSZone*)zone
 {
-	return NSAllocateObject( (self == SetClass) ?  CoreSetClass : (Class)self, 0, zone);
+	/* Immutable instances are sized and built by their initializer. */
+	if (self == SetClass)
+		return [NSTemporarySet allocWithZone:zone];
+	return NSAllocateObject(self, 0, zone);
 }
 
 + (id)set
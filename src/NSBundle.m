@@ -198,6 +198,8 @@ NSMakeSymbol(NSBundleDidLoadNotification);
 
 	if (status)
 	{
+		/* Categories in the bundle may have added accessors. */
+		_NSKVCInvalidateAccessorCache();
 		[[NSNotificationCenter defaultCenter] 
 			postNotificationName:NSBundleDidLoadNotification
 						  object:self
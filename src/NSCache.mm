@@ -29,6 +29,9 @@
  */
 
 #import <Foundation/NSCache.h>
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
 #include <unordered_map>
 #include <mutex>
 using std::unordered_map;
@@ -42,22 +45,146 @@ using std::lock_guard;
 
 /* Policy states used in the cache:
    - Cost -- the cost of the object.  Used for cost-based eviction.
-   - Count -- Number of times the object is accessed.
-   - lastAccess -- Last access time.  For LRU-based eviction.
+   - prev/next -- Position in the LRU list.  For LRU-based eviction.
+   - tick -- Shard clock value at the last use, to compare shard tails.
  */
 struct cached_object
 {
-	cached_object(id inobj, NSUInteger _cost, NSUInteger _accTime, id k) :
-		obj(inobj), key(k), cost(_cost) {}
-	cached_object() {}
 	__strong id obj;
-	__weak id key;	// Weak reference to the key.
+	__unsafe_unretained id key;	// Owned by the table entry.
 	NSUInteger cost = 0;
-	NSUInteger count = 0;
-	NSUInteger lastAccess = 0;
+	bool discardable = false;
+	uint64_t tick = 0;
+	cached_object *prev = NULL;	// More recently used
+	cached_object *next = NULL;	// Less recently used
+};
+
+/*
+ * The cache table, threaded with an intrusive LRU list.  unordered_map nodes
+ * never move, so the links survive rehashing, and a hit, an insert, or
+ * popping the least recently used entry are all constant time.
+ */
+class lru_table
+{
+	typedef unordered_map<id, cached_object> table_type;
+
+	table_type table;
+	cached_object *head = NULL;
+	cached_object *tail = NULL;
+
+	void unlink(cached_object *c)
+	{
+		if (c->prev != NULL)
+			c->prev->next = c->next;
+		else
+			head = c->next;
+		if (c->next != NULL)
+			c->next->prev = c->prev;
+		else
+			tail = c->prev;
+		c->prev = c->next = NULL;
+	}
+
+	void push_front(cached_object *c)
+	{
+		c->prev = NULL;
+		c->next = head;
+		if (head != NULL)
+			head->prev = c;
+		head = c;
+		if (tail == NULL)
+			tail = c;
+	}
+
+	public:
+	NSUInteger totalCost = 0;
+
+	size_t size() const { return table.size(); }
+	cached_object *lru() const { return tail; }
+
+	cached_object *find(id key)
+	{
+		auto iter = table.find(key);
+
+		if (iter == table.end())
+			return NULL;
+		return &iter->second;
+	}
+
+	void touch(cached_object *c, uint64_t tick)
+	{
+		c->tick = tick;
+		if (c != head)
+		{
+			unlink(c);
+			push_front(c);
+		}
+	}
+
+	void insert(id key, id obj, NSUInteger cost, bool discardable,
+			uint64_t tick)
+	{
+		auto result = table.emplace(key, cached_object());
+		cached_object *c = &result.first->second;
+
+		if (!result.second)
+		{
+			totalCost -= c->cost;
+			unlink(c);
+		}
+		c->obj = obj;
+		c->key = result.first->first;
+		c->cost = cost;
+		c->discardable = discardable;
+		c->tick = tick;
+		totalCost += cost;
+		push_front(c);
+	}
+
+	id remove(cached_object *c)
+	{
+		id obj = c->obj;
+
+		unlink(c);
+		totalCost -= c->cost;
+		table.erase(c->key);
+		return obj;
+	}
+
+	void clear(std::vector<id> &removed)
+	{
+		for (cached_object *c = head; c != NULL; c = c->next)
+			removed.push_back(c->obj);
+		table.clear();
+		head = tail = NULL;
+		totalCost = 0;
+	}
+};
+
+/*
+ * The cache is striped by key hash so lookups on different keys don't contend
+ * on one lock.  Each shard has its own lock, LRU list, cost and clock; the
+ * global count and cost are tracked atomically, so the limits are exact.
+ *
+ * Entries are stamped from their shard's clock, which is pulled forward to
+ * the newest tick any insert has published, so ticks roughly agree across
+ * shards while hits never write shared memory.  Each shard publishes its
+ * tail's tick, and eviction compares the tails of a few non-empty shards and
+ * pops the oldest, which is the cache-wide LRU entry whenever no more than
+ * CACHE_EVICT_SAMPLES shards are in use.
+ */
+#define CACHE_SHARDS	16
+#define CACHE_EVICT_SAMPLES	4
+
+struct cache_shard
+{
+	mutex mtx;
+	lru_table table;
+	uint64_t clock = 0;	// Guarded by mtx.
+	std::atomic<uint64_t> tailTick{UINT64_MAX};
+	char pad[64];	// Keep neighbouring locks off the same cache line.
 };
 
-typedef unordered_map<id, cached_object> table_type;
 @implementation NSCache
 {
 	NSString *name;
@@ -65,115 +192,266 @@ typedef unordered_map<id, cached_object> table_type;
 	NSUInteger totalCostLimit;
 	bool evictsObjectsWithDiscardedContent;
 	id<NSCacheDelegate> delegate;
-	mutex mtx;
-	table_type table;
-	NSUInteger currentAccess;
-	NSUInteger currentCost;
+	cache_shard shards[CACHE_SHARDS];
+	std::atomic<NSUInteger> totalCount;
+	std::atomic<NSUInteger> totalCost;
+	/* Newest tick handed out by an insert. */
+	std::atomic<uint64_t> latestTick;
+	/* Bit n is set while shards[n] holds entries. */
+	std::atomic<uint32_t> liveShards;
+	std::atomic<NSUInteger> evictCursor;
 }
 @synthesize name;
-@synthesize countLimit;
-@synthesize totalCostLimit;
 @synthesize evictsObjectsWithDiscardedContent;
 
 - (id) init
 {
+	totalCount = 0;
+	totalCost = 0;
+	latestTick = 0;
+	liveShards = 0;
+	evictCursor = 0;
 	return self;
 }
 
-- (id) objectForKey:(id)key
+static inline cache_shard &shard_for_key(cache_shard *shards, id key)
 {
-	lock_guard<mutex> locker(mtx);
+	NSUInteger h = [key hash];
 
-	auto iter = table.find(key);
-	if (iter == table.end())
-		return nil;
-	++(currentAccess);
-	iter->second.lastAccess = currentAccess;
-	iter->second.count++;
-	return iter->second.obj;
+	// Hashes are often poorly distributed in the low bits, so mix first.
+	h ^= (h >> 16);
+	h *= 0x45d9f3b;
+	h ^= (h >> 16);
+	return shards[h % CACHE_SHARDS];
 }
 
-- (void) setObject:(id)obj forKey:(id)key
+/* Next tick for an entry in shard, which must be locked. */
+static inline uint64_t next_tick(cache_shard &shard,
+		const std::atomic<uint64_t> &latest)
 {
-	[self setObject:obj forKey:key cost:0];
+	shard.clock = std::max(shard.clock,
+			latest.load(std::memory_order_relaxed)) + 1;
+	return shard.clock;
 }
 
-- (void) setObject:(id)obj forKey:(id)key cost:(NSUInteger)cost
+/* Publish a locked shard's tail and emptiness after changing it. */
+- (void) _shardChanged:(cache_shard &)shard
 {
-	lock_guard<mutex> locker(mtx);
+	cached_object *tail = shard.table.lru();
+	uint32_t bit = 1U << (&shard - shards);
 
-	++(currentAccess);
-	currentCost += cost;
-	table[key] = cached_object(obj, cost, currentAccess, key);
+	shard.tailTick.store((tail != NULL) ? tail->tick : UINT64_MAX,
+			std::memory_order_relaxed);
+	if (tail != NULL)
+	{
+		if (!(liveShards.load(std::memory_order_relaxed) & bit))
+			liveShards.fetch_or(bit, std::memory_order_relaxed);
+	}
+	else
+		liveShards.fetch_and(~bit, std::memory_order_relaxed);
 }
 
-- (void) removeObjectForKey:(id)key
+- (bool) _isOverLimits
+{
+	return ((countLimit > 0 && totalCount > countLimit) ||
+			(totalCostLimit > 0 && totalCost > totalCostLimit));
+}
+
+/*
+ * Pop least recently used entries until the cache is back within its limits.
+ * Each round looks at the published tail ticks of up to CACHE_EVICT_SAMPLES
+ * non-empty shards, starting from a rotating cursor, and locks only the one
+ * with the oldest tail.  Must be called without any shard lock held.  A limit
+ * of 0 means no limit.
+ */
+- (void) _evictObjectsIfNeeded:(std::vector<id> &)evicted
 {
-	lock_guard<mutex> locker(mtx);
+	while ([self _isOverLimits])
+	{
+		uint32_t live = liveShards.load(std::memory_order_relaxed);
+		NSUInteger start = evictCursor++;
+		cache_shard *oldest = NULL;
+		uint64_t oldestTick = UINT64_MAX;
+		int sampled = 0;
 
-	auto iter = table.find(key);
+		if (live == 0)
+			return;
+		for (NSUInteger i = 0;
+				i < CACHE_SHARDS && sampled < CACHE_EVICT_SAMPLES; i++)
+		{
+			NSUInteger n = (start + i) % CACHE_SHARDS;
+			uint64_t tick;
 
-	if (iter == table.end())
-		return;
+			if (!(live & (1U << n)))
+				continue;
+			sampled++;
+			tick = shards[n].tailTick.load(std::memory_order_relaxed);
+			if (oldest == NULL || tick < oldestTick)
+			{
+				oldest = &shards[n];
+				oldestTick = tick;
+			}
+		}
+
+		lock_guard<mutex> locker(oldest->mtx);
+		// The shard may have been emptied since it was looked at.
+		cached_object *c = oldest->table.lru();
 
-	currentCost -= iter->second.cost;
-	table.erase(iter);
+		if (c == NULL)
+			continue;
+		totalCount--;
+		totalCost -= c->cost;
+		evicted.push_back(oldest->table.remove(c));
+		[self _shardChanged:*oldest];
+	}
 }
 
-- (void) removeAllObjects
+/* The delegate is only ever called after the locks are dropped. */
+- (void) _notifyDelegateOfEvictedObjects:(const std::vector<id> &)evicted
 {
-	lock_guard<mutex> locker(mtx);
-	table.clear();
+	id<NSCacheDelegate> del = delegate;
+
+	if (del == nil)
+		return;
+	for (id obj : evicted)
+		[del cache:self willEvictObject:obj];
 }
 
-- (id<NSCacheDelegate>) delegate
+- (id) objectForKey:(id)key
 {
-	return delegate;
+	cache_shard &shard = shard_for_key(shards, key);
+	std::vector<id> evicted;
+	id obj = nil;
+
+	{
+		lock_guard<mutex> locker(shard.mtx);
+		cached_object *c = shard.table.find(key);
+
+		if (c == NULL)
+			return nil;
+		if (c->discardable && evictsObjectsWithDiscardedContent &&
+				[c->obj isContentDiscarded])
+		{
+			totalCount--;
+			totalCost -= c->cost;
+			evicted.push_back(shard.table.remove(c));
+			[self _shardChanged:shard];
+		}
+		else
+		{
+			bool wasTail = (c == shard.table.lru());
+
+			shard.table.touch(c, next_tick(shard, latestTick));
+			obj = c->obj;
+			// Only a hit on the tail moves the shard's oldest tick.
+			if (wasTail)
+				[self _shardChanged:shard];
+		}
+	}
+	[self _notifyDelegateOfEvictedObjects:evicted];
+	return obj;
 }
 
-- (void) setDelegate:(id<NSCacheDelegate>) newDel
+- (void) setObject:(id)obj forKey:(id)key
 {
-	delegate = newDel;
+	[self setObject:obj forKey:key cost:0];
 }
 
-- (void) _evictOldObjectsIfNeededForObjectWithCost:(NSUInteger)cost
+- (void) setObject:(id)obj forKey:(id)key cost:(NSUInteger)cost
 {
-	if ((currentCost + cost <= totalCostLimit) && 
-			([self countLimit] > table.size()))
+	cache_shard &shard = shard_for_key(shards, key);
+	std::vector<id> evicted;
+	bool discardable =
+		[obj conformsToProtocol:@protocol(NSDiscardableContent)];
+
 	{
-		return;
+		lock_guard<mutex> locker(shard.mtx);
+		size_t oldCount = shard.table.size();
+		NSUInteger oldCost = shard.table.totalCost;
+
+		uint64_t tick = next_tick(shard, latestTick);
+
+		latestTick.store(tick, std::memory_order_relaxed);
+		shard.table.insert(key, obj, cost, discardable, tick);
+		totalCount += shard.table.size() - oldCount;
+		totalCost += shard.table.totalCost - oldCost;
+		[self _shardChanged:shard];
 	}
+	[self _evictObjectsIfNeeded:evicted];
+	[self _notifyDelegateOfEvictedObjects:evicted];
+}
 
-	std::vector<cached_object*> objs;
+- (void) removeObjectForKey:(id)key
+{
+	cache_shard &shard = shard_for_key(shards, key);
+	std::vector<id> evicted;
 
-	for (auto i : table)
 	{
-		objs.push_back(&i.second);
+		lock_guard<mutex> locker(shard.mtx);
+		cached_object *c = shard.table.find(key);
+
+		if (c == NULL)
+			return;
+		totalCount--;
+		totalCost -= c->cost;
+		evicted.push_back(shard.table.remove(c));
+		[self _shardChanged:shard];
 	}
-	std::sort(objs.begin(), objs.end(), [&](cached_object *a, cached_object *b){
-			return (a->lastAccess < b->lastAccess);
-			});
+	[self _notifyDelegateOfEvictedObjects:evicted];
+}
 
-	for (auto j : objs)
+- (void) removeAllObjects
+{
+	std::vector<id> evicted;
+
+	for (cache_shard &shard : shards)
 	{
-		if (table.size() <= countLimit || currentCost < (totalCostLimit - cost))
-		{
-			break;
-		}
-		currentCost -= j->cost;
-		if ([static_cast<id>(j->obj) conformsToProtocol:@protocol(NSDiscardableContent)])
-		{
-			if (![static_cast<id>(j->obj) isContentDiscarded])
-			{
-				[static_cast<id>(j->obj) discardContentIfPossible];
-			}
-			if (!evictsObjectsWithDiscardedContent)
-			{
-				continue;
-			}
-		}
-		table.erase(j->key);
+		lock_guard<mutex> locker(shard.mtx);
+
+		totalCount -= shard.table.size();
+		totalCost -= shard.table.totalCost;
+		shard.table.clear(evicted);
+		[self _shardChanged:shard];
 	}
+	[self _notifyDelegateOfEvictedObjects:evicted];
+}
+
+- (NSUInteger) countLimit
+{
+	return countLimit;
+}
+
+- (void) setCountLimit:(NSUInteger)limit
+{
+	std::vector<id> evicted;
+
+	countLimit = limit;
+	[self _evictObjectsIfNeeded:evicted];
+	[self _notifyDelegateOfEvictedObjects:evicted];
+}
+
+- (NSUInteger) totalCostLimit
+{
+	return totalCostLimit;
+}
+
+- (void) setTotalCostLimit:(NSUInteger)limit
+{
+	std::vector<id> evicted;
+
+	totalCostLimit = limit;
+	[self _evictObjectsIfNeeded:evicted];
+	[self _notifyDelegateOfEvictedObjects:evicted];
+}
+
+- (id<NSCacheDelegate>) delegate
+{
+	return delegate;
+}
+
+- (void) setDelegate:(id<NSCacheDelegate>) newDel
+{
+	delegate = newDel;
 }
 
 @end
@@ -30,7 +30,6 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/event.h>
 #include <sys/socket.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -53,6 +52,7 @@
 #import <Foundation/NSValue.h>
 
 #import "internal.h"
+#include "NSRunLoopEvent.h"
 
 @class NSArray;
 @class NSData;
@@ -59,6 +59,7 @@
 #import <Foundation/NSInvocation.h>
 #import <Foundation/NSMethodSignature.h>
 #import <Foundation/NSString.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ffi.h>
@@ -67,17 +68,46 @@
 
 static ffi_type *ffi_type_from_encoding(const char *str);
 
-struct _InvocationPrivate
+/*
+ * Call layouts
+ *
+ * Preparing a libffi call means walking the type encoding, building the
+ * ffi_type vector and running ffi_prep_cif, none of which depends on anything
+ * but the encoding.  Each distinct encoding is therefore prepared once and
+ * kept for the life of the process, together with the layout of an argument
+ * frame: the argument pointer vector, the return value, then each argument at
+ * its natural alignment, all in one block.
+ */
+struct _NSCallLayout
 {
-	ffi_closure *closure;
+	struct _NSCallLayout *next;
+	NSHashCode hash;
+	char *types;
 	ffi_cif cif;
+	unsigned int nargs;
+	size_t retOffset;
+	size_t frameSize;
+	/* Forwarding trampoline for this encoding, created on first use. */
+	ffi_closure *closure;
+	IMP forward;
+	size_t argOffsets[];
+};
+
+struct _InvocationPrivate
+{
+	struct _NSCallLayout *layout;
 	void **args;
 	void *ret;
+	void *heapFrame;		/* Frame storage too large to keep inline. */
 };
 
+/* Small frames live inside the invocation object itself. */
+#define INLINE_FRAME_SIZE	128
+#define FRAME_ALIGN			16
+
 @interface NSInvocation()
-+ (NSInvocation *)invocationWithCallbackData:(struct _InvocationPrivate *)data arguments:(void **)args signature:(NSMethodSignature *)sig;
-- (id) initWithCallbackData:(struct _InvocationPrivate *)data arguments:(void **)args signature:(NSMethodSignature *)sig;
++ (NSInvocation *)invocationWithCallLayout:(struct _NSCallLayout *)layout arguments:(void **)args returnValue:(void *)ret;
+- (id) initWithCallLayout:(struct _NSCallLayout *)layout arguments:(void **)args returnValue:(void *)ret;
 - (void) _verifySignature;
 - (void) _retainReleaseArguments:(bool)release;
 @end
@@ -129,7 +159,7 @@ static ffi_type * const ffi_type_match[CHAR_MAX] = {
 	[_C_ULNG] = &ffi_type_ulong,
 	[_C_LNG_LNG] = &ffi_type_sint64,
 	[_C_ULNG_LNG] = &ffi_type_uint64,
-	[_C_BOOL] = &ffi_type_uint,
+	[_C_BOOL] = &ffi_type_uchar,
 	[_C_PTR] = &ffi_type_pointer,
 	[_C_CLASS] = &ffi_type_pointer,
 	[_C_SEL] = &ffi_type_pointer,
@@ -152,75 +182,119 @@ static ffi_type *ffi_type_from_encoding(const char *str)
 	return NULL;
 }
 
-static struct _InvocationPrivate *_setupFrame(const char *types)
+static inline size_t roundAlign(size_t size, size_t align)
+{
+	return ((size + (align - 1)) / align) * align;
+}
+
+#define CALL_LAYOUT_BUCKETS	256
+static struct _NSCallLayout *callLayouts[CALL_LAYOUT_BUCKETS];
+static pthread_mutex_t callLayoutLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct _NSCallLayout *_NSCallLayoutCreate(const char *types, NSHashCode hash)
 {
-	struct _InvocationPrivate *frame;
+	struct _NSCallLayout *layout;
 	ffi_type *rtype;
 	ffi_type **arg_types;
-	int nargs;
-	const char *typesInd = types;
-	
-	for (nargs = 0; *typesInd; nargs++)
+	unsigned int nargs = 0;
+	const char *typesInd;
+	size_t offset;
+
+	for (typesInd = objc_skip_argspec(types); *typesInd;
+			typesInd = objc_skip_argspec(typesInd))
 	{
-		typesInd = objc_skip_argspec(typesInd);
+		nargs++;
 	}
 
-	frame = malloc(sizeof(*frame));
-	frame->closure = NULL;
-
-	// First get encoding for ffi...
+	layout = calloc(1, sizeof(*layout) + nargs * sizeof(size_t));
 	arg_types = malloc((nargs + 1) * sizeof(ffi_type *));
 	rtype = ffi_type_from_encoding(types);
-	types = objc_skip_argspec(types);
 
-	--nargs;
-	for (int i = 0; i < nargs; i++)
+	typesInd = objc_skip_argspec(types);
+	for (unsigned int i = 0; i < nargs; i++)
 	{
-		arg_types[i] = ffi_type_from_encoding(types);
-		types = objc_skip_argspec(types);
+		arg_types[i] = ffi_type_from_encoding(typesInd);
+		typesInd = objc_skip_argspec(typesInd);
+		if (arg_types[i] == NULL)
+			rtype = NULL;
 	}
 	arg_types[nargs] = NULL;
-	ffi_prep_cif(&frame->cif, FFI_DEFAULT_ABI, nargs, rtype, arg_types);
 
-	return frame;
-}
+	if (rtype == NULL ||
+			ffi_prep_cif(&layout->cif, FFI_DEFAULT_ABI, nargs, rtype, arg_types) != FFI_OK)
+	{
+		free(arg_types);
+		free(layout);
+		return NULL;
+	}
 
-static inline size_t roundAlign(size_t size, size_t align)
-{
-	return ((size + (align - 1)) / align) * align;
+	layout->hash = hash;
+	layout->types = strdup(types);
+	layout->nargs = nargs;
+
+	/* libffi writes at least a full ffi_arg for small integral returns. */
+	offset = roundAlign(nargs * sizeof(void *), FRAME_ALIGN);
+	layout->retOffset = offset;
+	offset += roundAlign(MAX(rtype->size, sizeof(ffi_arg)), FRAME_ALIGN);
+	for (unsigned int i = 0; i < nargs; i++)
+	{
+		offset = roundAlign(offset, MAX(arg_types[i]->alignment, 1));
+		layout->argOffsets[i] = offset;
+		offset += arg_types[i]->size;
+	}
+	layout->frameSize = roundAlign(offset, FRAME_ALIGN);
+	return layout;
 }
 
-/* Set up the frame argument storage.  O(n) operation, going forwards then back.
- * Forwards to gather the sizes of the arguments, backwards to set the pointers
- * to the storage.
+/*
+ * Layouts are never freed, so readers walk the bucket chains without a lock;
+ * new layouts are published at the head of a chain with a release store.
  */
-static void _setupFrameArgs(struct _InvocationPrivate *frame)
+static struct _NSCallLayout *_NSCallLayoutForTypes(const char *types)
 {
-	size_t frame_size = 0;
-	frame->ret = malloc(roundAlign(frame->cif.rtype->size, MAX(frame->cif.rtype->alignment, sizeof(void *))));
-	char *arg_frame;
-	void **args;
-	unsigned int i;
+	NSHashCode hash;
+	struct _NSCallLayout **bucket;
+	struct _NSCallLayout *layout;
+
+	if (types == NULL)
+		return NULL;
 
-	if (frame->cif.nargs == 0)
+	hash = hashjb(types, strlen(types));
+	bucket = &callLayouts[hash % CALL_LAYOUT_BUCKETS];
+	for (layout = __atomic_load_n(bucket, __ATOMIC_ACQUIRE); layout != NULL;
+			layout = layout->next)
 	{
-		frame->args = NULL;
-		return;
+		if (layout->hash == hash && strcmp(layout->types, types) == 0)
+			return layout;
 	}
 
-	for (i = 0; i < frame->cif.nargs; i++)
+	pthread_mutex_lock(&callLayoutLock);
+	for (layout = *bucket; layout != NULL; layout = layout->next)
 	{
-		frame_size += roundAlign(frame->cif.arg_types[i]->size, frame->cif.arg_types[i]->alignment);
+		if (layout->hash == hash && strcmp(layout->types, types) == 0)
+			break;
 	}
-	arg_frame = malloc(frame_size);
-	args = malloc((frame->cif.nargs) * sizeof(void *));
-	for (; i > 0; i--)
+	if (layout == NULL && (layout = _NSCallLayoutCreate(types, hash)) != NULL)
 	{
-		frame_size -= roundAlign(frame->cif.arg_types[i - 1]->size, frame->cif.arg_types[i - 1]->alignment);
-		args[i - 1] = arg_frame + frame_size;
+		layout->next = *bucket;
+		__atomic_store_n(bucket, layout, __ATOMIC_RELEASE);
 	}
+	pthread_mutex_unlock(&callLayoutLock);
+	return layout;
+}
+
+/* Point the frame's argument and return slots into the given storage. */
+static void _setupFrame(struct _InvocationPrivate *frame, char *storage)
+{
+	struct _NSCallLayout *layout = frame->layout;
 
-	frame->args = args;
+	memset(storage, 0, layout->frameSize);
+	frame->args = (void **)storage;
+	frame->ret = storage + layout->retOffset;
+	for (unsigned int i = 0; i < layout->nargs; i++)
+	{
+		frame->args[i] = storage + layout->argOffsets[i];
+	}
 }
 
 static void forwardCallback(ffi_cif *cif, void *ret, void **args, void *data)
@@ -241,23 +315,55 @@ static void forwardCallback(ffi_cif *cif, void *ret, void **args, void *data)
 		abort();
 	}
 
-	inv = [NSInvocation invocationWithCallbackData:data arguments:args signature:[NSMethodSignature signatureWithObjCTypes:sel_getType_np(_cmd)]];
+	inv = [NSInvocation invocationWithCallLayout:data arguments:args returnValue:ret];
 	[inv setTarget:self];
 	[inv setSelector:_cmd];
 	[self forwardInvocation:inv];
-	[inv getReturnValue:ret];
 }
 
+/*
+ * The forwarding trampoline depends only on the type encoding: the selector
+ * and receiver arrive as ordinary arguments, and the closure's user data is
+ * the shared call layout.  So each layout gets one closure, built the first
+ * time a message with that encoding is forwarded and reused from then on.
+ */
 static IMP forward2(id self, SEL _cmd)
 {
-	struct _InvocationPrivate *frame;
+	struct _NSCallLayout *layout;
+	const char *types = sel_getType_np(_cmd);
+	ffi_closure *closure;
 	void *func;
-	
-	frame = _setupFrame(sel_getType_np(_cmd));
+	IMP imp;
 
-	frame->closure = ffi_closure_alloc(sizeof(ffi_closure), &func);
-	ffi_prep_closure_loc(frame->closure, &frame->cif, forwardCallback, frame, func);
-	return (IMP)func;
+	if (types == NULL)
+	{
+		types = [[self methodSignatureForSelector:_cmd] types];
+	}
+	layout = _NSCallLayoutForTypes(types);
+	if (layout == NULL)
+	{
+		NSLog(@"Unable to forward selector %s with types '%s'",
+				sel_getName(_cmd), types ? types : "(unknown)");
+		abort();
+	}
+
+	imp = __atomic_load_n(&layout->forward, __ATOMIC_ACQUIRE);
+	if (imp != NULL)
+	{
+		return imp;
+	}
+
+	pthread_mutex_lock(&callLayoutLock);
+	if ((imp = layout->forward) == NULL)
+	{
+		closure = ffi_closure_alloc(sizeof(ffi_closure), &func);
+		ffi_prep_closure_loc(closure, &layout->cif, forwardCallback, layout, func);
+		layout->closure = closure;
+		imp = (IMP)func;
+		__atomic_store_n(&layout->forward, imp, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&callLayoutLock);
+	return imp;
 }
 
 static pthread_key_t slot_key;
@@ -275,6 +381,10 @@ static struct objc_slot *forward3(id self, SEL _cmd)
 }
 
 @implementation NSInvocation
+{
+	struct _InvocationPrivate _frame;
+	long double _inlineFrame[INLINE_FRAME_SIZE / sizeof(long double)];
+}
 
 + (void) initialize
 {
@@ -289,68 +399,53 @@ static struct objc_slot *forward3(id self, SEL _cmd)
 	return inv;
 }
 
-+ (NSInvocation *)invocationWithCallbackData:(struct _InvocationPrivate *)data arguments:(void **)args signature:(NSMethodSignature *)sig
++ (NSInvocation *)invocationWithCallLayout:(struct _NSCallLayout *)layout arguments:(void **)args returnValue:(void *)ret
 {
-	return [[self alloc] initWithCallbackData:data arguments:args signature:sig];
+	return [[self alloc] initWithCallLayout:layout arguments:args returnValue:ret];
 }
 
 - (id) initWithMethodSignature:(NSMethodSignature *)sig
 {
 	self->signature = sig;
-	_d = _setupFrame([sig types]);
-	_setupFrameArgs(_d);
+	_d = &_frame;
+	_d->layout = _NSCallLayoutForTypes([sig types]);
+	if (_d->layout == NULL)
+	{
+		return nil;
+	}
+	if (_d->layout->frameSize <= sizeof(_inlineFrame))
+	{
+		_setupFrame(_d, (char *)_inlineFrame);
+	}
+	else
+	{
+		_d->heapFrame = malloc(_d->layout->frameSize);
+		_setupFrame(_d, _d->heapFrame);
+	}
 	return self;
 }
 
-- (id) initWithCallbackData:(struct _InvocationPrivate *)data arguments:(void **)args signature:(NSMethodSignature *)sig
+/*
+ * A forwarded call's arguments and return slot belong to libffi, so the
+ * invocation works on them in place.
+ */
+- (id) initWithCallLayout:(struct _NSCallLayout *)layout arguments:(void **)args returnValue:(void *)ret
 {
-	_d = data;
+	_d = &_frame;
+	_d->layout = layout;
 	_d->args = args;
-	signature = sig;
+	_d->ret = ret;
+	signature = [NSMethodSignature signatureWithObjCTypes:layout->types];
 	return self;
 }
 
-/* Free a tree of ffi_type pointers.  If a given type's 'elements' pointer is
- * non-NULL, then it's a struct so recurse, otherwise it's a primitive, so
- * ignore it.
- */
-static void free_ffi_types(ffi_type **types)
-{
-	for (; *types != NULL; types++)
-	{
-		if ((*types)->elements != NULL)
-		{
-			free_ffi_types((*types)->elements);
-		}
-	}
-	free(types);
-}
-
 - (void) dealloc
 {
     if (argumentsRetained)
 	{
 		[self _retainReleaseArguments:true];
 	}
-    if (_d != NULL)
-	{
-		// If there is a closure, then we don't own the frame, it was a forward.
-		if (_d->args != NULL && _d->closure == NULL)
-		{
-			free(_d->args);
-		}
-		else if (_d->closure != NULL)
-		{
-			ffi_closure_free(_d->closure);
-		}
-
-		if (_d->ret != NULL)
-		{
-			free(_d->ret);
-		}
-		free_ffi_types(_d->cif.arg_types);
-	}
-	free(_d);
+	free(_frame.heapFrame);
 }
 
 - (bool)argumentsRetained
@@ -362,7 +457,7 @@ static void free_ffi_types(ffi_type **types)
 {
 	//NSAssert(*[signature methodReturnType] == _C_VOID, @"NSInvocation must be invoked first.");
 
-	if (*[signature methodReturnType] != _C_VOID)
+	if (*[signature methodReturnType] != _C_VOID && retLoc != _d->ret)
 		memcpy(retLoc, _d->ret, [signature methodReturnLength]);
 }
 
@@ -451,9 +546,12 @@ static void free_ffi_types(ffi_type **types)
 -(void)getArgument:(void *)arg atIndex:(int)argIndex
 {
 	NSAssert(signature != nil, @"Method signature must be created first.");
-	NSAssert((unsigned int)argIndex < _d->closure->cif->nargs, @"Index out of range");
 
-	memcpy(arg, _d->args[argIndex], _d->closure->cif->arg_types[argIndex]->size);
+	if ((unsigned int)argIndex >= _d->layout->nargs)
+		@throw([NSRangeException
+				exceptionWithReason:@"Argument index out of range."
+						   userInfo:nil]);
+	memcpy(arg, _d->args[argIndex], _d->layout->cif.arg_types[argIndex]->size);
 }
 
 -(void)setArgument:(void *)arg atIndex:(int)index
@@ -469,7 +567,7 @@ static void free_ffi_types(ffi_type **types)
 	else {
 		if (arg)
 		{
-			memcpy(_d->args[index], arg, _d->cif.arg_types[index]->size);
+			memcpy(_d->args[index], arg, _d->layout->cif.arg_types[index]->size);
 		}
 	}
 }
@@ -491,13 +589,13 @@ static void free_ffi_types(ffi_type **types)
     [self _verifySignature];
 
     {
-        Method m;
+        IMP imp;
 
-        m = class_getInstanceMethod(object_getClass(_target), selector);
+        imp = class_getMethodImplementation(object_getClass(_target), selector);
         
 		[self setArgument:&_target atIndex:0];
 		[self setArgument:&selector atIndex:1];
-		ffi_call(&_d->cif, (void (*)())method_getImplementation(m), _d->ret, _d->args);
+		ffi_call(&_d->layout->cif, (void (*)())imp, _d->ret, _d->args);
     }
 
     /* Restore the old target. */
@@ -38,13 +38,16 @@
 #import <Foundation/NSString.h>
 #import <Foundation/NSInvocation.h>
 #import <Foundation/NSMethodSignature.h>
+#include <cctype>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
-#include <ctype.h>
 #include <string>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
 #include <vector>
+#include <pthread.h>
 #include <objc/encoding.h>
 #import "NSKVCMutableArray.h"
 #import "NSKVCMutableOrderedSet.h"
@@ -73,6 +76,404 @@ NSString * const NSUnionOfArraysKeyValueOperator = @"unionOfArrays";
 NSString * const NSUnionOfObjectsKeyValueOperator = @"unionOfObjects";
 NSString * const NSUnionOfSetsKeyValueOperator = @"unionOfSets";
 
+Ivar findIvar(NSObject *self, NSString *key);
+
+/*
+ * Accessor cache
+ *
+ * Looking up an accessor means building several selector names, asking for
+ * a method signature and probing up to four ivar names, so each (class, key)
+ * pair is resolved once into an accessor: the getter or setter IMP, or the
+ * ivar offset, plus a thunk that boxes or unboxes the value for its type.
+ * Keys with no accessor are not cached: a method for them may still be
+ * added later, by class_addMethod() or +resolveInstanceMethod:, and a cached
+ * miss would hide it.
+ *
+ * Adding methods to a class can also change which accessor a key that did
+ * resolve would now find, so anything that does so in bulk, such as loading
+ * a category, must call _NSKVCInvalidateAccessorCache().
+ */
+struct _NSKVCAccessor;
+typedef id (*_NSKVCGetter)(id, const _NSKVCAccessor *);
+typedef void (*_NSKVCSetter)(id, const _NSKVCAccessor *, id);
+
+struct _NSKVCAccessor
+{
+	SEL selector = NULL;
+	IMP imp = NULL;
+	Ivar ivar = NULL;
+	ptrdiff_t offset = 0;
+	const char *type = NULL;
+	bool isObject = false;
+	/* Only needed to call accessors taking or returning arbitrary structs. */
+	NSMethodSignature *signature = nil;
+	_NSKVCGetter get = NULL;
+	_NSKVCSetter set = NULL;
+};
+
+template <typename T> struct _NSKVCType;
+
+#define KVC_TYPE(t, cls, boxSel, unboxSel) \
+	template <> struct _NSKVCType<t> \
+	{ \
+		static id box(t v) { return [cls boxSel:v]; } \
+		static t unbox(id v) { return [v unboxSel]; } \
+	}
+KVC_TYPE(bool, NSNumber, numberWithBool, boolValue);
+KVC_TYPE(char, NSNumber, numberWithChar, charValue);
+KVC_TYPE(double, NSNumber, numberWithDouble, doubleValue);
+KVC_TYPE(float, NSNumber, numberWithFloat, floatValue);
+KVC_TYPE(int, NSNumber, numberWithInt, intValue);
+KVC_TYPE(long, NSNumber, numberWithLong, longValue);
+KVC_TYPE(long long, NSNumber, numberWithLongLong, longLongValue);
+KVC_TYPE(short, NSNumber, numberWithShort, shortValue);
+KVC_TYPE(unsigned char, NSNumber, numberWithUnsignedChar, unsignedCharValue);
+KVC_TYPE(unsigned int, NSNumber, numberWithUnsignedInt, unsignedIntValue);
+KVC_TYPE(unsigned long, NSNumber, numberWithUnsignedLong, unsignedLongValue);
+KVC_TYPE(unsigned long long, NSNumber, numberWithUnsignedLongLong, unsignedLongLongValue);
+KVC_TYPE(unsigned short, NSNumber, numberWithUnsignedShort, unsignedShortValue);
+KVC_TYPE(NSPoint, NSValue, valueWithPoint, pointValue);
+KVC_TYPE(NSRange, NSValue, valueWithRange, rangeValue);
+KVC_TYPE(NSRect, NSValue, valueWithRect, rectValue);
+KVC_TYPE(NSSize, NSValue, valueWithSize, sizeValue);
+#undef KVC_TYPE
+
+static inline void *ivarAddress(id self, const _NSKVCAccessor *a)
+{
+	return (char *)(__bridge void *)self + a->offset;
+}
+
+template <typename T>
+static id getWithMethod(id self, const _NSKVCAccessor *a)
+{
+	return _NSKVCType<T>::box(((T (*)(id, SEL))a->imp)(self, a->selector));
+}
+
+template <typename T>
+static id getFromIvar(id self, const _NSKVCAccessor *a)
+{
+	return _NSKVCType<T>::box(*(T *)ivarAddress(self, a));
+}
+
+template <typename T>
+static void setWithMethod(id self, const _NSKVCAccessor *a, id value)
+{
+	((void (*)(id, SEL, T))a->imp)(self, a->selector, _NSKVCType<T>::unbox(value));
+}
+
+template <typename T>
+static void setIvar(id self, const _NSKVCAccessor *a, id value)
+{
+	*(T *)ivarAddress(self, a) = _NSKVCType<T>::unbox(value);
+}
+
+static id getObjectWithMethod(id self, const _NSKVCAccessor *a)
+{
+	return ((id (*)(id, SEL))a->imp)(self, a->selector);
+}
+
+static id getObjectFromIvar(id self, const _NSKVCAccessor *a)
+{
+	return object_getIvar(self, a->ivar);
+}
+
+static void setObjectWithMethod(id self, const _NSKVCAccessor *a, id value)
+{
+	((void (*)(id, SEL, id))a->imp)(self, a->selector, value);
+}
+
+static void setObjectIvar(id self, const _NSKVCAccessor *a, id value)
+{
+	object_setIvar(self, a->ivar, value);
+}
+
+static id getStructWithMethod(id self, const _NSKVCAccessor *a)
+{
+	NSUInteger size;
+	NSInvocation *inv = [NSInvocation
+		invocationWithMethodSignature:a->signature];
+
+	NSGetSizeAndAlignment(a->type, &size, NULL);
+
+	[inv setTarget:self];
+	[inv setSelector:a->selector];
+	[inv invoke];
+
+	char bytes[size];
+	[inv getReturnValue:bytes];
+	return [NSValue valueWithBytes:bytes objCType:a->type];
+}
+
+static id getStructFromIvar(id self, const _NSKVCAccessor *a)
+{
+	return [NSValue valueWithBytes:ivarAddress(self, a) objCType:a->type];
+}
+
+static void setStructWithMethod(id self, const _NSKVCAccessor *a, id value)
+{
+	NSUInteger size;
+	NSInvocation *inv = [NSInvocation
+		invocationWithMethodSignature:a->signature];
+
+	NSGetSizeAndAlignment(a->type, &size, NULL);
+	char bytes[size];
+
+	[value getValue:bytes];
+	[inv setTarget:self];
+	[inv setSelector:a->selector];
+	[inv setArgument:bytes atIndex:2];
+	[inv invoke];
+}
+
+static void setStructIvar(id self, const _NSKVCAccessor *a, id value)
+{
+	[value getValue:ivarAddress(self, a)];
+}
+
+struct _NSKVCThunks
+{
+	_NSKVCGetter getWithMethod;
+	_NSKVCGetter getFromIvar;
+	_NSKVCSetter setWithMethod;
+	_NSKVCSetter setIvar;
+};
+
+static bool thunksForType(const char *type, _NSKVCThunks *thunks)
+{
+	switch (*type)
+	{
+#define KVC_THUNKS(t) \
+	*thunks = { getWithMethod<t>, getFromIvar<t>, setWithMethod<t>, setIvar<t> }
+#define KVC_SCALAR(code, t) \
+		case code: \
+			KVC_THUNKS(t); \
+			return true
+		KVC_SCALAR(_C_BOOL, bool);
+		KVC_SCALAR(_C_CHR, char);
+		KVC_SCALAR(_C_DBL, double);
+		KVC_SCALAR(_C_FLT, float);
+		KVC_SCALAR(_C_INT, int);
+		KVC_SCALAR(_C_LNG, long);
+		KVC_SCALAR(_C_LNG_LNG, long long);
+		KVC_SCALAR(_C_SHT, short);
+		KVC_SCALAR(_C_UCHR, unsigned char);
+		KVC_SCALAR(_C_UINT, unsigned int);
+		KVC_SCALAR(_C_ULNG, unsigned long);
+		KVC_SCALAR(_C_ULNG_LNG, unsigned long long);
+		KVC_SCALAR(_C_USHT, unsigned short);
+		case _C_ID:
+		case _C_CLASS:
+			*thunks = { getObjectWithMethod, getObjectFromIvar,
+				setObjectWithMethod, setObjectIvar };
+			return true;
+		case _C_STRUCT_B:
+#define KVC_STRUCT(t) \
+			if (strcmp(type, @encode(t)) == 0) \
+			{ \
+				KVC_THUNKS(t); \
+				return true; \
+			}
+			KVC_STRUCT(NSPoint);
+			KVC_STRUCT(NSRange);
+			KVC_STRUCT(NSRect);
+			KVC_STRUCT(NSSize);
+			*thunks = { getStructWithMethod, getStructFromIvar,
+				setStructWithMethod, setStructIvar };
+			return true;
+#undef KVC_STRUCT
+#undef KVC_SCALAR
+#undef KVC_THUNKS
+		default:
+			return false;
+	}
+}
+
+/* Builds <prefix><key><suffix>, with the first letter of key uppercased. */
+static SEL accessorSelector(const char *prefix, const char *key,
+		bool capitalize, const char *suffix)
+{
+	std::string name(prefix);
+	size_t at = name.size();
+
+	name += key;
+	if (capitalize && name.size() > at)
+		name[at] = std::toupper(name[at]);
+	name += suffix;
+	return sel_registerName(name.c_str());
+}
+
+static bool resolveIvar(id self, Class cls, NSString *key, _NSKVCAccessor &acc,
+		bool setter)
+{
+	_NSKVCThunks thunks;
+	Ivar ivar;
+
+	if (![cls accessInstanceVariablesDirectly])
+		return false;
+	if ((ivar = findIvar(self, key)) == NULL)
+		return false;
+
+	acc.type = objc_skip_type_qualifiers(ivar_getTypeEncoding(ivar));
+	if (!thunksForType(acc.type, &thunks))
+		return false;
+	acc.ivar = ivar;
+	acc.offset = ivar_getOffset(ivar);
+	acc.isObject = (*acc.type == _C_ID || *acc.type == _C_CLASS);
+	if (setter)
+		acc.set = thunks.setIvar;
+	else
+		acc.get = thunks.getFromIvar;
+	return true;
+}
+
+/*
+   Search order for getters:
+   - get<Key>
+   - <key>
+   - is<Key>
+   - _get<Key>
+   - _<key>
+   followed by the instance variables, as in findIvar().
+ */
+static void resolveGetter(id self, Class cls, NSString *key, _NSKVCAccessor &acc)
+{
+	const char *k = [key UTF8String];
+	SEL candidates[] = {
+		accessorSelector("get", k, true, ""),
+		accessorSelector("", k, false, ""),
+		accessorSelector("is", k, true, ""),
+		accessorSelector("_get", k, true, ""),
+		accessorSelector("_", k, false, ""),
+	};
+
+	for (SEL sel: candidates)
+	{
+		NSMethodSignature *sig;
+		_NSKVCThunks thunks;
+
+		if (!class_respondsToSelector(cls, sel))
+			continue;
+		sig = [self methodSignatureForSelector:sel];
+		if (sig == nil || [sig numberOfArguments] != 2)
+			continue;
+		acc.type = objc_skip_type_qualifiers([sig methodReturnType]);
+		if (!thunksForType(acc.type, &thunks))
+			continue;
+		acc.selector = sel;
+		acc.imp = class_getMethodImplementation(cls, sel);
+		acc.signature = sig;
+		acc.isObject = (*acc.type == _C_ID || *acc.type == _C_CLASS);
+		acc.get = thunks.getWithMethod;
+		return;
+	}
+	resolveIvar(self, cls, key, acc, false);
+}
+
+/*
+   Search order for setters:
+   - set<Key>:
+   - _set<Key>:
+   followed by the instance variables, as in findIvar().
+ */
+static void resolveSetter(id self, Class cls, NSString *key, _NSKVCAccessor &acc)
+{
+	const char *k = [key UTF8String];
+	SEL candidates[] = {
+		accessorSelector("set", k, true, ":"),
+		accessorSelector("_set", k, true, ":"),
+	};
+
+	for (SEL sel: candidates)
+	{
+		NSMethodSignature *sig;
+		_NSKVCThunks thunks;
+
+		if (!class_respondsToSelector(cls, sel))
+			continue;
+		sig = [self methodSignatureForSelector:sel];
+		if (sig == nil || [sig numberOfArguments] != 3)
+			continue;
+		acc.type = objc_skip_type_qualifiers([sig getArgumentTypeAtIndex:2]);
+		if (!thunksForType(acc.type, &thunks))
+			continue;
+		acc.selector = sel;
+		acc.imp = class_getMethodImplementation(cls, sel);
+		acc.signature = sig;
+		acc.isObject = (*acc.type == _C_ID || *acc.type == _C_CLASS);
+		acc.set = thunks.setWithMethod;
+		return;
+	}
+	resolveIvar(self, cls, key, acc, true);
+}
+
+struct _NSKVCCacheKey
+{
+	Class cls;
+	NSString *key;
+	size_t hash;
+
+	bool operator==(const _NSKVCCacheKey &other) const
+	{
+		return cls == other.cls && hash == other.hash &&
+			(key == other.key || [key isEqualToString:other.key]);
+	}
+};
+
+struct _NSKVCCacheHash
+{
+	size_t operator()(const _NSKVCCacheKey &k) const
+	{
+		return k.hash;
+	}
+};
+
+typedef std::shared_ptr<const _NSKVCAccessor> _NSKVCAccessorRef;
+typedef std::unordered_map<_NSKVCCacheKey, _NSKVCAccessorRef, _NSKVCCacheHash> _NSKVCCache;
+
+static pthread_rwlock_t accessorCacheLock = PTHREAD_RWLOCK_INITIALIZER;
+static _NSKVCCache getterCache;
+static _NSKVCCache setterCache;
+
+static _NSKVCAccessorRef accessorForKey(id self, NSString *key, bool setter)
+{
+	Class cls = object_getClass(self);
+	uintptr_t h = (uintptr_t)cls >> 4;
+	_NSKVCCacheKey cacheKey{cls, key, (size_t)((h ^ (h >> 16)) * 0x45d9f3b) ^ [key hash]};
+	_NSKVCCache &cache = setter ? setterCache : getterCache;
+	_NSKVCAccessorRef accessor;
+
+	pthread_rwlock_rdlock(&accessorCacheLock);
+	auto i = cache.find(cacheKey);
+	if (i != cache.end())
+		accessor = i->second;
+	pthread_rwlock_unlock(&accessorCacheLock);
+	if (accessor)
+		return accessor;
+
+	auto resolved = std::make_shared<_NSKVCAccessor>();
+	if (setter)
+		resolveSetter(self, cls, key, *resolved);
+	else
+		resolveGetter(self, cls, key, *resolved);
+	if ((setter ? resolved->set : resolved->get) == NULL)
+		return resolved;
+
+	/* The caller's key may be mutable; keep our own copy. */
+	cacheKey.key = [key copy];
+	pthread_rwlock_wrlock(&accessorCacheLock);
+	accessor = cache.emplace(cacheKey, resolved).first->second;
+	pthread_rwlock_unlock(&accessorCacheLock);
+	return accessor;
+}
+
+void _NSKVCInvalidateAccessorCache(void)
+{
+	pthread_rwlock_wrlock(&accessorCacheLock);
+	getterCache.clear();
+	setterCache.clear();
+	pthread_rwlock_unlock(&accessorCacheLock);
+}
+
 @implementation NSObject (KeyValueCoding)
 
 + (bool) accessInstanceVariablesDirectly
@@ -262,238 +663,41 @@ Ivar findIvar(NSObject *self, NSString *key)
 
 - (id) valueForKey:(NSString *)key
 {
-	SEL getSel;
-	IMP imp;
-	Ivar ivar;
-	void *varAddr;
-	const char *type;
-	NSMethodSignature *sig;
-
-	getSel = NSSelectorFromString([NSString
-			stringWithFormat:@"get%@:",[key capitalizedString]]);
-	sig = [self methodSignatureForSelector:getSel];
-	imp = [self methodForSelector:getSel];
-
-	if (sig != nil && imp != NULL)
+	if (key == nil)
 	{
-		if ([sig numberOfArguments] != 2)
-		{
-			@throw [NSInvalidArgumentException
-				exceptionWithReason:@"Key-value getter has wrong number of arguments"
-				userInfo:nil];
-		}
-		type = [sig methodReturnType];
+		return [self valueForUndefinedKey:key];
 	}
-	else
-	{
-		if (![[self class] accessInstanceVariablesDirectly])
-		{
-			return [self valueForUndefinedKey:key];
-		}
-		
-		ivar = findIvar(self, key);
-		if (ivar == NULL)
-		{
-			return [self valueForUndefinedKey:key];
-		}
 
-		type = ivar_getTypeEncoding(ivar);
-		varAddr = (char *)(__bridge void *)self + ivar_getOffset(ivar);
-	}
+	_NSKVCAccessorRef accessor = accessorForKey(self, key, false);
 
-	switch (*type)
+	if (accessor->get == NULL)
 	{
-#define GET_VALUE(code, type, sel)\
-		case code:\
-			do { type v; \
-				if (imp != NULL) \
-				{ v = ((type (*)(id, SEL))imp)(self, getSel); } \
-				else { v = *(type *)varAddr; } \
-				break; \
-				return [NSNumber sel:v]; \
-			} while (0)
-		GET_VALUE(_C_BOOL, bool, numberWithBool);
-		GET_VALUE(_C_CHR, char, numberWithChar);
-		GET_VALUE(_C_DBL, double, numberWithDouble);
-		GET_VALUE(_C_FLT, float, numberWithFloat);
-		GET_VALUE(_C_INT, int, numberWithInt);
-		GET_VALUE(_C_LNG, long, numberWithLong);
-		GET_VALUE(_C_LNG_LNG, long long, numberWithLongLong);
-		GET_VALUE(_C_SHT, short, numberWithShort);
-		GET_VALUE(_C_UCHR, unsigned char, numberWithUnsignedChar);
-		GET_VALUE(_C_UINT, unsigned int, numberWithUnsignedInt);
-		GET_VALUE(_C_ULNG, unsigned long, numberWithUnsignedLong);
-		GET_VALUE(_C_ULNG_LNG, unsigned long long, numberWithUnsignedLongLong);
-		GET_VALUE(_C_USHT, unsigned short, numberWithUnsignedShort);
-		case _C_ID:
-		case _C_CLASS:
-			if (imp != NULL)
-			{
-				return ((id (*)(id, SEL))imp)(self, getSel);
-			}
-			else
-			{
-				return object_getIvar(self, ivar);
-			}
-		case _C_STRUCT_B:
-#define GET_VALUE_STRUCT(t, sel)\
-		if (strcmp(type, @encode(t)) == 0)\
-			do { t v; \
-				if (imp != NULL) \
-				{ v = ((t (*)(id, SEL))imp)(self, getSel); } \
-				else { v = *(t *)varAddr; } \
-				break;\
-				return [NSValue sel:v]; \
-			} while (0)
-			GET_VALUE_STRUCT(NSPoint, valueWithPoint);
-			GET_VALUE_STRUCT(NSRange, valueWithRange);
-			GET_VALUE_STRUCT(NSRect, valueWithRect);
-			GET_VALUE_STRUCT(NSSize, valueWithSize);
-			if (imp != NULL)
-			{
-				NSUInteger size;
-				NSInvocation *inv = [NSInvocation
-					invocationWithMethodSignature:sig];
-
-				NSGetSizeAndAlignment(type, &size, NULL);
-
-				[inv setTarget:self];
-				[inv setSelector:getSel];
-				[inv invoke];
-
-				char bytes[size];
-				[inv getReturnValue:bytes];
-				return [NSValue valueWithBytes:bytes objCType:type];
-			}
-			else
-			{
-				return [NSValue valueWithBytes:varAddr
-					objCType:ivar_getTypeEncoding(ivar)];
-			}
-
-#undef GET_VALUE_STRUCT
-#undef GET_VALUE
-		default:
-			{
-				return [self valueForUndefinedKey:key];
-			}
+		return [self valueForUndefinedKey:key];
 	}
+	return accessor->get(self, accessor.get());
 }
 
 - (void) setValue:(id)value forKey:(NSString *)key
 {
-	SEL setSel = NSSelectorFromString([NSString
-			stringWithFormat:@"set%@:",[key capitalizedString]]);
-	IMP imp;
-	Ivar ivar;
-	void *varAddr;
-	const char *type;
-	NSMethodSignature *sig;
-
-	if (value == nil || value == [NSNull null])
+	if (key == nil)
 	{
-		[self setNilValueForKey:key];
+		[self setValue:value forUndefinedKey:key];
 		return;
 	}
-	sig = [self methodSignatureForSelector:setSel];
-	imp = [self methodForSelector:setSel];
 
-	if (sig != nil && imp != NULL)
-	{
-		if ([sig numberOfArguments] != 3)
-		{
-			@throw [NSInvalidArgumentException
-				exceptionWithReason:@"Key-value setter has wrong number of arguments"
-				userInfo:nil];
-		}
-		type = [sig getArgumentTypeAtIndex:2];
-	}
-	else
-	{
-		if (![[self class] accessInstanceVariablesDirectly])
-		{
-			[self setValue:value forUndefinedKey:key];
-			return;
-		}
-		
-		ivar = findIvar(self, key);
-		if (ivar == NULL)
-		{
-			[self setValue:value forUndefinedKey:key];
-		}
+	_NSKVCAccessorRef accessor = accessorForKey(self, key, true);
 
-		type = ivar_getTypeEncoding(ivar);
-		varAddr = (char *)(__bridge void *)self + ivar_getOffset(ivar);
+	if (accessor->set == NULL)
+	{
+		[self setValue:value forUndefinedKey:key];
+		return;
 	}
-
-	switch (*type)
+	if (!accessor->isObject && (value == nil || value == [NSNull null]))
 	{
-#define SET_VALUE(code, type, sel)\
-		case code:\
-			do { type v = [value sel]; \
-				if (imp != NULL) \
-				{ ((void (*)(id, SEL, type))imp)(self, setSel, v); } \
-				else { *(type *)varAddr = v; } \
-				break; \
-			} while (0)
-		SET_VALUE(_C_BOOL, bool, boolValue);
-		SET_VALUE(_C_CHR, char, charValue);
-		SET_VALUE(_C_DBL, double, doubleValue);
-		SET_VALUE(_C_FLT, float, floatValue);
-		SET_VALUE(_C_INT, int, intValue);
-		SET_VALUE(_C_LNG, long, longValue);
-		SET_VALUE(_C_LNG_LNG, long long, longLongValue);
-		SET_VALUE(_C_SHT, short, shortValue);
-		SET_VALUE(_C_UCHR, unsigned char, unsignedCharValue);
-		SET_VALUE(_C_UINT, unsigned int, unsignedIntValue);
-		SET_VALUE(_C_ULNG, unsigned long, unsignedLongValue);
-		SET_VALUE(_C_ULNG_LNG, unsigned long long, unsignedLongLongValue);
-		SET_VALUE(_C_USHT, unsigned short, unsignedShortValue);
-		case _C_ID:
-		case _C_CLASS:
-			if (imp != NULL)
-			{
-				((void (*)(id, SEL, id))imp)(self, setSel, value);
-			}
-			else
-			{
-				object_setIvar(self, ivar, value);
-			}
-		case _C_STRUCT_B:
-#define SET_VALUE_STRUCT(t, sel)\
-		if (strcmp(type, @encode(t)) == 0)\
-			do { t v = [value sel]; \
-				if (imp != NULL) \
-				{ ((void (*)(id, SEL, t))imp)(self, setSel, v); } \
-				else { *(t *)varAddr = v; } \
-				break;\
-			} while (0)
-			SET_VALUE_STRUCT(NSPoint, pointValue);
-			SET_VALUE_STRUCT(NSRange, rangeValue);
-			SET_VALUE_STRUCT(NSRect, rectValue);
-			SET_VALUE_STRUCT(NSSize, sizeValue);
-			if (imp != NULL)
-			{
-				NSUInteger byteSize;
-
-				NSGetSizeAndAlignment(type, &byteSize, NULL);
-				char bytes[byteSize];
-
-				[value getValue:bytes];
-				imp(self, setSel, bytes);
-			}
-			else
-			{
-				[value getValue:varAddr];
-			}
-
-#undef SET_VALUE_STRUCT
-#undef SET_VALUE
-		default:
-			{
-				[self setValue:value forUndefinedKey:key];
-			}
+		[self setNilValueForKey:key];
+		return;
 	}
+	accessor->set(self, accessor.get(), value);
 }
 
 - (bool) validateValue:(id *)ioValue forKey:(NSString *)key error:(out NSError **)outError
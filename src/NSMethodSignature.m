@@ -57,6 +57,7 @@
 #import <Foundation/NSException.h>
 #import <Foundation/NSMethodSignature.h>
 #import <Foundation/NSValue.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #import "internal.h"
@@ -71,55 +72,141 @@
    y,z,a - Size of argument preceding it
  */
 
+struct _NSArgumentInfo
+{
+	const char *type;
+	NSUInteger size;
+	NSUInteger alignment;
+};
+
+/*
+ * Signatures are interned by type string.  Each one is immutable once
+ * published and lives for the rest of the process, so lookups walk the bucket
+ * chains without a lock; only inserting a new signature takes the mutex.
+ */
+#define SIGNATURE_BUCKETS	512
+static void *signatureTable[SIGNATURE_BUCKETS];
+static pthread_mutex_t signatureLock = PTHREAD_MUTEX_INITIALIZER;
+
 @implementation NSMethodSignature
+{
+	NSHashCode hash;
+	NSUInteger frameLength;
+	/* Return type at index 0, then the arguments. */
+	struct _NSArgumentInfo *argInfo;
+	__unsafe_unretained NSMethodSignature *next;
+}
+
+static NSMethodSignature *findSignature(void *head, const char *types, NSHashCode hash)
+{
+	__unsafe_unretained NSMethodSignature *sig;
+
+	for (sig = (__bridge NSMethodSignature *)head; sig != nil; sig = sig->next)
+	{
+		if (sig->hash == hash && strcmp(sig->types, types) == 0)
+			return sig;
+	}
+	return nil;
+}
+
+- (id) _initWithObjCTypes:(const char *)_types hash:(NSHashCode)h
+{
+	const char *typesInd;
+	NSUInteger count = 0;
+	NSUInteger i;
+
+	types = strdup(_types);
+	hash = h;
+
+	/* Compute no of arguments. The first type is the return type. */
+	for (typesInd = types; *typesInd; typesInd = objc_skip_argspec(typesInd))
+	{
+		count++;
+	}
+	numberOfArguments = count - 1;
+
+	argInfo = malloc(count * sizeof(*argInfo));
+	for (typesInd = types, i = 0; i < count; i++)
+	{
+		argInfo[i].type = typesInd;
+		if (*objc_skip_type_qualifiers(typesInd) == _C_VOID)
+		{
+			argInfo[i].size = 0;
+			argInfo[i].alignment = 1;
+		}
+		else
+		{
+			argInfo[i].size = objc_sizeof_type(typesInd);
+			argInfo[i].alignment = objc_alignof_type(typesInd);
+		}
+		typesInd = objc_skip_argspec(typesInd);
+
+		/* Arguments occupy at least a word each. */
+		if (i > 0)
+		{
+			frameLength += ((argInfo[i].size + sizeof(void *) - 1) /
+					sizeof(void *)) * sizeof(void *);
+		}
+	}
+	return self;
+}
 
 + (NSMethodSignature *)signatureWithObjCTypes:(const char *)_types
 {
 	NSMethodSignature   *signature;
-	//const char *p;
+	NSHashCode h;
+	void **bucket;
 
-	if(_types == NULL) {
+	if(_types == NULL || *_types == 0) {
 		@throw [NSInvalidArgumentException
 			exceptionWithReason:@"Null types passed to signatureWithObjCTypes:"
 			userInfo:nil];
 	}
 
-	signature = [NSMethodSignature alloc];
-	NSAssert(signature, @"couldn't allocate method signature");
-
-	signature->types = strdup(_types);
+	h = hashjb(_types, strlen(_types));
+	bucket = &signatureTable[h % SIGNATURE_BUCKETS];
+	signature = findSignature(__atomic_load_n(bucket, __ATOMIC_ACQUIRE), _types, h);
+	if (signature != nil)
+	{
+		return signature;
+	}
 
-	/* Compute no of arguments. The first type is the return type. */
-	for(signature->numberOfArguments = -1; *_types; signature->numberOfArguments++)
+	pthread_mutex_lock(&signatureLock);
+	signature = findSignature(*bucket, _types, h);
+	if (signature == nil)
 	{
-		_types = objc_skip_argspec(_types);
+		signature = [[NSMethodSignature alloc] _initWithObjCTypes:_types hash:h];
+		signature->next = (__bridge NSMethodSignature *)*bucket;
+		/* The table keeps its own reference, forever. */
+		__atomic_store_n(bucket, (__bridge_retained void *)signature,
+				__ATOMIC_RELEASE);
 	}
+	pthread_mutex_unlock(&signatureLock);
 
 	return signature;
 }
 
 - (void)dealloc
 {
+	free(argInfo);
 	free(types);
 }
 
 - (NSHashCode)hash
 {
-	return hashjb(types, strlen(types));
+	return hash;
 }
 
 - (bool)isEqual:anotherSignature
 {
-	return [anotherSignature isKindOfClass:object_getClass(self)]
-		&& !strcmp(types, [anotherSignature types]);
+	return anotherSignature == self ||
+		([anotherSignature isKindOfClass:object_getClass(self)]
+		&& !strcmp(types, [anotherSignature types]));
 }
 
 - (const char *)getArgumentTypeAtIndex:(NSUInteger)_index
 {
-	const char *typesInd = types;
-	const char *end;
-
-	if (_index > numberOfArguments)
+	if (_index >= numberOfArguments)
 	{
 		@throw [NSInvalidArgumentException exceptionWithReason:@"Index out of range"
 			userInfo:@{
@@ -128,28 +215,25 @@
 		return NULL;
 	}
 
-	for (;_index > 0; _index--)
-	{
-		typesInd = objc_skip_argspec(typesInd);
-	}
-	end = objc_skip_argspec(typesInd);
-	return end;
+	return argInfo[_index + 1].type;
+}
+
+/* Layout of an argument, range checked like -getArgumentTypeAtIndex:. */
+static const struct _NSArgumentInfo *argumentInfo(NSMethodSignature *sig,
+		NSUInteger index)
+{
+	[sig getArgumentTypeAtIndex:index];
+	return &sig->argInfo[index + 1];
 }
 
 - (NSUInteger)frameLength
 {
-	size_t len = 0;
-	const char *typeInd = types;
-	for (;*typeInd != 0;typeInd = objc_skip_argspec(typeInd))
-	{
-		len += objc_sizeof_type(typeInd);
-	}
-	return len;
+	return frameLength;
 }
 
 - (NSUInteger)methodReturnLength
 {
-	return objc_sizeof_type(types);
+	return argInfo[0].size;
 }
 
 - (const char*)methodReturnType
@@ -173,4 +257,14 @@
 
 - (const char*)types	{ return types; }
 
+- (NSUInteger)argumentSizeAtIndex:(NSUInteger)_index
+{
+	return argumentInfo(self, _index)->size;
+}
+
+- (NSUInteger)argumentAlignmentAtIndex:(NSUInteger)_index
+{
+	return argumentInfo(self, _index)->alignment;
+}
+
 @end /* MethodSignature (Extensions) */
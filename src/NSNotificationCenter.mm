@@ -33,7 +33,12 @@
 #import <Foundation/NSNotification.h>
 #import <Foundation/NSOperation.h>
 #import <Foundation/NSString.h>
-#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 
@@ -48,6 +53,11 @@
 @implementation _NSNotificationBlock
 - (void) invokeWithNotification:(NSNotification *)note
 {
+	if (queue == nil)
+	{
+		block(note);
+		return;
+	}
 	[queue addOperationWithBlock:^(){
 		block(note);
 	}];
@@ -56,21 +66,191 @@
 
 /*
  * NSNotificationCenter	
+ *
+ * Registrations are indexed by (name, object) pair, with nil standing in for
+ * "any" on either side.  A post therefore looks at no more than four lists:
+ * (name, object), (name, nil), (nil, object) and (nil, nil).
+ *
+ * The index is published copy-on-write: each hash slot holds an immutable
+ * bucket, which writers replace wholesale under the registration lock.
+ * Posting takes no lock.  It loads the table and the slots it needs through
+ * atomic pointers, and takes references to the observer lists it finds, so
+ * it never waits on a registration in progress, and observers are free to
+ * add or remove registrations (including their own) from inside a handler.
+ * A post that races a registration may or may not see it.  Replaced buckets
+ * and tables are freed once no post can still be reading them; see
+ * _NSObserverReclaimer.
  */
 
 static NSNotificationCenter *defaultCenter = nil;
-class _NSNotificationDispatcher
+
+static inline uintptr_t _NSObjectKey(id obj)
+{
+	return (uintptr_t)(__bridge void *)obj;
+}
+
+struct _NSNotificationObserver
+{
+	__weak id observer;
+	__strong id retained;	/* Block observers are owned by the center. */
+	__weak id object;
+	uintptr_t observerKey;
+	SEL selector;
+	bool anyObject;
+	uint64_t order;
+};
+
+typedef std::shared_ptr<const _NSNotificationObserver> _NSObserverRef;
+typedef std::vector<_NSObserverRef> _NSObserverList;
+typedef std::shared_ptr<const _NSObserverList> _NSObserverListRef;
+
+struct _NSNotificationKey
+{
+	NSString *name;
+	uintptr_t object;
+	size_t hash;
+
+	_NSNotificationKey(NSString *n, NSUInteger nameHash, uintptr_t obj) :
+		name(n), object(obj)
+	{
+		uintptr_t h = obj >> 4;
+		h ^= h >> 16;
+		h *= 0x45d9f3b;
+		h ^= h >> 16;
+		hash = (size_t)nameHash * 31 + h;
+	}
+
+	bool operator==(const _NSNotificationKey &other) const
+	{
+		return hash == other.hash && object == other.object &&
+			(name == other.name ||
+			 (name != nil && other.name != nil &&
+			  [name isEqualToString:other.name]));
+	}
+};
+
+struct _NSObserverBucket
 {
-	public:
-		__weak id source;
-		NSString *name;
-		__weak id observer;
-		SEL selector;
+	std::vector<std::pair<_NSNotificationKey, _NSObserverListRef>> entries;
+
+	_NSObserverListRef find(const _NSNotificationKey &key) const
+	{
+		for (auto &entry: entries)
+			if (entry.first == key)
+				return entry.second;
+		return nullptr;
+	}
+};
+
+typedef std::atomic<const _NSObserverBucket *> _NSObserverSlot;
+
+/*
+ * The slot array never changes size once published; growing builds a new
+ * table and swaps it in.  The table owns the buckets in its slots.
+ */
+struct _NSObserverTable
+{
+	std::vector<_NSObserverSlot> slots;
+
+	explicit _NSObserverTable(size_t count) : slots(count) {}
+
+	~_NSObserverTable()
+	{
+		for (auto &slot: slots)
+			delete slot.load(std::memory_order_relaxed);
+	}
+
+	_NSObserverSlot &slotFor(const _NSNotificationKey &key)
+	{
+		return slots[key.hash & (slots.size() - 1)];
+	}
+
+	_NSObserverListRef find(const _NSNotificationKey &key) const
+	{
+		const _NSObserverBucket *bucket =
+			slots[key.hash & (slots.size() - 1)].load(std::memory_order_acquire);
+		return bucket ? bucket->find(key) : nullptr;
+	}
+};
+
+/*
+ * Epoch based reclamation for replaced buckets and tables.
+ *
+ * A post counts itself as a reader of the epoch it starts in, for as long as
+ * it reads the table.  Writers retire what they unpublish into the list for
+ * the current epoch, and advance the epoch once no reader of the previous
+ * one is left; everything retired two epochs back is then unreachable and
+ * freed.  Writers never wait for readers, so a handler may register while a
+ * post is in progress on its own thread.
+ */
+struct _NSObserverReclaimer
+{
+	std::atomic<unsigned long> epoch{0};
+	std::atomic<unsigned long> readers[2];
+	std::vector<std::unique_ptr<const _NSObserverBucket>> buckets[2];
+	std::vector<std::unique_ptr<_NSObserverTable>> tables[2];
+
+	_NSObserverReclaimer()
+	{
+		readers[0] = 0;
+		readers[1] = 0;
+	}
+
+	unsigned enter()
+	{
+		for (;;)
+		{
+			unsigned long e = epoch.load();
+
+			readers[e & 1].fetch_add(1);
+			if (epoch.load() == e)
+				return e & 1;
+			readers[e & 1].fetch_sub(1);
+		}
+	}
+
+	void leave(unsigned parity)
+	{
+		readers[parity].fetch_sub(1, std::memory_order_release);
+	}
+
+	/* The rest must be called with the registration lock held. */
+	void retire(const _NSObserverBucket *bucket)
+	{
+		buckets[epoch.load(std::memory_order_relaxed) & 1].emplace_back(bucket);
+		advance();
+	}
+
+	void retire(_NSObserverTable *table)
+	{
+		tables[epoch.load(std::memory_order_relaxed) & 1].emplace_back(table);
+		advance();
+	}
+
+	void advance()
+	{
+		unsigned long e = epoch.load(std::memory_order_relaxed);
+		unsigned previous = (e + 1) & 1;
+
+		if (readers[previous].load() != 0)
+			return;
+		buckets[previous].clear();
+		tables[previous].clear();
+		epoch.store(e + 1);
+	}
 };
 
+#define OBSERVER_TABLE_INITIAL_SIZE 64
+
 @implementation NSNotificationCenter 
 {
-	std::vector<_NSNotificationDispatcher> objects;
+	std::mutex registrationLock;
+	std::atomic<_NSObserverTable *> table;
+	_NSObserverReclaimer reclaimer;
+	size_t keyCount;
+	uint64_t nextOrder;
+	/* Keys each observer is registered under, for removeObserver:. */
+	std::unordered_map<uintptr_t, std::vector<_NSNotificationKey>> byObserver;
 }
 
 /* Class methods */
@@ -93,14 +273,82 @@ class _NSNotificationDispatcher
 
 - (id)init
 {
+	table = new _NSObserverTable(OBSERVER_TABLE_INITIAL_SIZE);
 	return self;
 }
 
+- (void) dealloc
+{
+	delete table.load();
+}
+
+/* Must be called with registrationLock held. */
+- (void) _replaceList:(_NSObserverListRef)list forKey:(const _NSNotificationKey &)key
+{
+	auto &slot = table.load(std::memory_order_relaxed)->slotFor(key);
+	const _NSObserverBucket *old = slot.load(std::memory_order_relaxed);
+	std::unique_ptr<_NSObserverBucket> bucket(old ?
+		new _NSObserverBucket(*old) : new _NSObserverBucket());
+	auto &entries = bucket->entries;
+	auto i = std::find_if(entries.begin(), entries.end(),
+			[&](const std::pair<_NSNotificationKey, _NSObserverListRef> &e){
+			return e.first == key;
+			});
+
+	if (i != entries.end())
+	{
+		if (list)
+			i->second = list;
+		else
+		{
+			entries.erase(i);
+			keyCount--;
+		}
+	}
+	else if (list)
+	{
+		entries.emplace_back(key, list);
+		keyCount++;
+	}
+	slot.store(entries.empty() ? nullptr : bucket.release(),
+			std::memory_order_release);
+	if (old != nullptr)
+		reclaimer.retire(old);
+}
+
+/* Must be called with registrationLock held. */
+- (void) _growTable
+{
+	_NSObserverTable *current = table.load(std::memory_order_relaxed);
+	std::unique_ptr<_NSObserverTable> grown(
+		new _NSObserverTable(current->slots.size() * 2));
+	std::vector<std::unique_ptr<_NSObserverBucket>> buckets(grown->slots.size());
+
+	for (auto &slot: current->slots)
+	{
+		const _NSObserverBucket *old = slot.load(std::memory_order_relaxed);
+
+		if (old == nullptr)
+			continue;
+		for (auto &entry: old->entries)
+		{
+			auto &b = buckets[entry.first.hash & (buckets.size() - 1)];
+			if (!b)
+				b.reset(new _NSObserverBucket());
+			b->entries.push_back(entry);
+		}
+	}
+	for (size_t i = 0; i < buckets.size(); i++)
+		grown->slots[i].store(buckets[i].release(), std::memory_order_relaxed);
+	table.store(grown.release(), std::memory_order_release);
+	reclaimer.retire(current);
+}
+
 /* Register && post notifications */
 
 - (void)postNotification:(NSNotification *)notification
 {
-	id name;
+	NSString *name;
 	id object;
 
 	name   = [notification name];
@@ -111,25 +359,99 @@ class _NSNotificationDispatcher
 		@throw [NSInvalidArgumentException exceptionWithReason:@"`nil' notification name in postNotification:" userInfo:nil];
 	}
 
-	for (auto &item: objects)
+	NSUInteger nameHash = [name hash];
+	uintptr_t objKey = _NSObjectKey(object);
+	_NSObserverListRef lists[4];
+	size_t listCount = 0;
+	unsigned epoch = reclaimer.enter();
+	const _NSObserverTable *current = table.load(std::memory_order_acquire);
+
+	lists[listCount++] = current->find(_NSNotificationKey(name, nameHash, 0));
+	lists[listCount++] = current->find(_NSNotificationKey(nil, 0, 0));
+	if (objKey != 0)
+	{
+		lists[listCount++] = current->find(_NSNotificationKey(name, nameHash, objKey));
+		lists[listCount++] = current->find(_NSNotificationKey(nil, 0, objKey));
+	}
+	reclaimer.leave(epoch);
+
+	/* Merge the lists so observers see posts in registration order. */
+	size_t cursor[4] = {0, 0, 0, 0};
+	for (;;)
 	{
-		id obj = item.source;
-		id noteName = item.name;
-		
-		if (obj != object && obj != nil)
+		const _NSNotificationObserver *next = NULL;
+		size_t from = 0;
+
+		for (size_t i = 0; i < listCount; i++)
+		{
+			if (!lists[i] || cursor[i] >= lists[i]->size())
+				continue;
+			auto &candidate = (*lists[i])[cursor[i]];
+			if (next == NULL || candidate->order < next->order)
+			{
+				next = candidate.get();
+				from = i;
+			}
+		}
+		if (next == NULL)
+			break;
+		cursor[from]++;
+
+		/*
+		 * A registration for a specific object that has since been
+		 * deallocated may share its address with the object being posted.
+		 */
+		if (!next->anyObject && next->object != object)
 			continue;
-		if (noteName != name && noteName != nil)
+		id observer = next->observer;
+		if (observer == nil)
 			continue;
+		[observer performSelector:next->selector withObject:notification];
+	}
+}
 
-		[obj performSelector:item.selector withObject:notification];
+- (void) _addObserver:(id)observer retain:(bool)retain selector:(SEL)selector
+				 name:(NSString *)notificationName object:(id)object
+{
+	if (observer == nil)
+	{
+		@throw [NSInvalidArgumentException exceptionWithReason:@"`nil' observer in addObserver:selector:name:object:" userInfo:nil];
 	}
+
+	auto entry = std::make_shared<_NSNotificationObserver>();
+	NSString *name = [notificationName copy];
+	_NSNotificationKey key(name, [name hash], _NSObjectKey(object));
+
+	entry->observer = observer;
+	if (retain)
+		entry->retained = observer;
+	entry->object = object;
+	entry->observerKey = _NSObjectKey(observer);
+	entry->selector = selector;
+	entry->anyObject = (object == nil);
+
+	std::lock_guard<std::mutex> guard(registrationLock);
+	entry->order = nextOrder++;
+
+	auto old = table.load(std::memory_order_relaxed)->find(key);
+	auto list = old ? std::make_shared<_NSObserverList>(*old) :
+		std::make_shared<_NSObserverList>();
+	list->push_back(entry);
+	[self _replaceList:list forKey:key];
+
+	auto &keys = byObserver[entry->observerKey];
+	if (std::find(keys.begin(), keys.end(), key) == keys.end())
+		keys.push_back(key);
+
+	if (keyCount > table.load(std::memory_order_relaxed)->slots.size() * 2)
+		[self _growTable];
 }
 
 - (void)addObserver:(id)observer selector:(SEL)selector 
 			   name:(NSString *)notificationName object:(id)object
 {
-	_NSNotificationDispatcher t{object, notificationName, observer, selector};
-	objects.push_back(t);
+	[self _addObserver:observer retain:false selector:selector
+				  name:notificationName object:object];
 }
 
 - (id) addObserverForName:(NSString *)name object:(id)obj queue:(NSOperationQueue *)queue usingBlock:(void (^)(NSNotification *))block
@@ -138,28 +460,52 @@ class _NSNotificationDispatcher
 
 	observerObj->block = [block copy];
 	observerObj->queue = queue;
-	[self addObserver:observerObj selector:@selector(invokeWithNotification) name:name
-		object:obj];
+	[self _addObserver:observerObj retain:true
+			  selector:@selector(invokeWithNotification:) name:name
+				object:obj];
 	return observerObj;
 }
 
 - (void)removeObserver:(id)observer 
 				  name:(NSString*)notificationName object:(id)object
 {
-	objects.erase(std::remove_if(objects.begin(), objects.end(),
-				[=](_NSNotificationDispatcher dispatch){
-				return (observer == dispatch.observer && 
-					((notificationName == dispatch.name || notificationName == nil) ||
-					(object == dispatch.source || object == nil)));
-				}), objects.end());
+	uintptr_t observerKey = _NSObjectKey(observer);
+	uintptr_t objKey = _NSObjectKey(object);
+
+	std::lock_guard<std::mutex> guard(registrationLock);
+	auto found = byObserver.find(observerKey);
+
+	if (found == byObserver.end())
+		return;
+
+	auto &keys = found->second;
+	for (auto i = keys.begin(); i != keys.end();)
+	{
+		if ((notificationName != nil && ![notificationName isEqualToString:i->name]) ||
+				(objKey != 0 && i->object != objKey))
+		{
+			++i;
+			continue;
+		}
+
+		auto old = table.load(std::memory_order_relaxed)->find(*i);
+		if (old)
+		{
+			auto list = std::make_shared<_NSObserverList>();
+			for (auto &entry: *old)
+				if (entry->observerKey != observerKey)
+					list->push_back(entry);
+			[self _replaceList:(list->empty() ? nullptr : list) forKey:*i];
+		}
+		i = keys.erase(i);
+	}
+	if (keys.empty())
+		byObserver.erase(found);
 }
 
 - (void)removeObserver:(id)observer
 {
-	objects.erase(std::remove_if(objects.begin(), objects.end(),
-				[=](_NSNotificationDispatcher dispatch){
-				return observer == dispatch.observer;
-				}), objects.end());
+	[self removeObserver:observer name:nil object:nil];
 }
 
 - (void)postNotificationName:(NSString*)notificationName object:object
@@ -683,6 +683,7 @@ void class_addBehavior(Class targetClass, Class behavior)
 		class_addMethod(cls, method_getName(m), method_getImplementation(m), method_getTypeEncoding(m));
 	}
 	free(itsMethodList);
+	_NSKVCInvalidateAccessorCache();
 }
 
 bool class_isKindOfClass(Class aClass, Class kindClass)
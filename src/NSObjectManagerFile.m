@@ -70,6 +70,8 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #import <Foundation/Plugins/Filesystem.h>
 #import <Foundation/NSFileManager.h>
 
+#import "Collections/NSMappedData.h"
+
 /* The actual scheme handler interface. */
 @interface SchemeFileHandler : NSObject <NSFilesystem>
 @end
@@ -399,47 +401,80 @@ static int delete_item(const char *path, const struct stat *sb, int flag, struct
 
 - (NSData *)contentsOfFileAtURL:(NSURL *)uri shared:(bool)shared error:(NSError **)errOut
 {
-	void *buffer;
+	char *buffer;
 	struct stat sb;
 	const char *path = [[uri path] fileSystemRepresentation];
 	NSString *errMess;
+	NSData *mapped;
+	size_t total = 0;
 	int fd;
 
-	if (stat(path, &sb) < 0)
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
 	{
-		errMess = @"Unable to stat file";
+		errMess = @"Error opening file.";
 		goto err_out;
 	}
 
-	if ((fd = open(path, O_RDONLY)) < 0)
+	if (fstat(fd, &sb) < 0)
 	{
-		errMess = @"Error opening file.";
-		goto err_out;
+		errMess = @"Unable to stat file";
+		goto close_out;
+	}
+
+	/*
+	 * Large files are mapped rather than copied when the caller allows the
+	 * data to be shared with the file, so long as the filesystem is local.
+	 */
+	if (shared && (uintmax_t)sb.st_size >= NSMappedDataThreshold &&
+			(mapped = _NSMappedDataWithFileDescriptor(fd,
+				NSDataReadingMappedIfSafe)) != nil)
+	{
+		close(fd);
+		return mapped;
 	}
 
 	/* If it won't fit in the buffer anyway, fail */
 	if ((uintmax_t)sb.st_size > SIZE_MAX)
 	{
-		TODO; // Add support for mapped data files.
+		errno = EFBIG;
 		errMess = @"File size too big for buffer.";
-		goto err_out;
+		goto close_out;
 	}
 
 	buffer = malloc(sb.st_size);
 
-	if (buffer == NULL)
+	if (buffer == NULL && sb.st_size != 0)
 	{
 		errMess = @"File size too big for buffer.";
-		goto err_out;
+		goto close_out;
 	}
 
-	if (read(fd, buffer, sb.st_size) < 0)
+	while (total < (size_t)sb.st_size)
 	{
-		free(buffer);
-		errMess = @"Error reading file.";
-		goto err_out;
+		ssize_t len = read(fd, buffer + total, sb.st_size - total);
+
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0)
+		{
+			free(buffer);
+			errMess = @"Error reading file.";
+			goto close_out;
+		}
+		/* The file shrank underneath us. */
+		if (len == 0)
+			break;
+		total += len;
+	}
+	close(fd);
+	return [NSData dataWithBytesNoCopy:buffer length:total freeWhenDone:true];
+
+close_out:
+	{
+		int saved = errno;
+		close(fd);
+		errno = saved;
 	}
-	return [NSData dataWithBytesNoCopy:buffer length:sb.st_size freeWhenDone:true];
 
 err_out:
 
@@ -0,0 +1,818 @@
+/* $Gold$	*/
+/*
+ * All rights reserved.
+ * Copyright (c) 2009-2012	Justin Hibbits
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSInvocation.h>
+#import <Foundation/NSKeyValueObserving.h>
+#import <Foundation/NSMethodSignature.h>
+#import <Foundation/NSObject.h>
+#import <Foundation/NSOperation.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSThread.h>
+#include <stdlib.h>
+#include <dispatch/dispatch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+@interface NSOperationQueue()
+- (void) _operationBecameReady:(NSOperation *)op;
+- (void) _operationFinished:(NSOperation *)op;
+@end
+
+/*
+ * Scheduler bookkeeping kept on each operation, so the queue never has to
+ * search for it.
+ */
+@interface NSOperation()
+{
+	@package
+	/* Unfinished dependencies.  The operation is ready when this hits 0. */
+	std::atomic<NSInteger> _pendingDependencies;
+	/* Operations waiting on this one; guarded by @synchronized(self). */
+	NSMutableArray *_dependents;
+	/* Set once the operation has been handed to its queue's ready list. */
+	std::atomic<bool> _enqueued;
+	/* Set once its queue has started it; guarded by the queue's lock. */
+	bool _dispatched;
+	std::atomic<bool> _finishing;
+	/* Links in the owning queue's list of operations, in insertion order. */
+	NSOperationQueue *_queue;
+	NSOperation *_queueNext;
+	__unsafe_unretained NSOperation *_queuePrev;
+}
+- (void) _becameReady;
+- (void) _finish;
+@end
+
+@implementation NSOperation
+{
+	dispatch_group_t wait_group;
+	NSMutableArray *dependencies;
+	NSOperationQueuePriority _priority;
+	void (^completionBlock)(void);
+	double _threadPriority;
+	bool _isFinished;
+	bool _isExecuting;
+	bool _isCancelled;
+}
+
++ (bool) automaticallyNotifiesObserversForKey:(NSString *)key
+{
+	return false;
+}
+
+- (id) init
+{
+	wait_group = dispatch_group_create();
+	dispatch_group_enter(wait_group);
+	dependencies = [NSMutableArray new];
+	_threadPriority = 0.5;
+	_pendingDependencies = 0;
+	_enqueued = false;
+	_dispatched = false;
+	_finishing = false;
+	return self;
+}
+
+- (void) dealloc
+{
+	// A group can't be released with an unbalanced enter.
+	if (!_finishing)
+		dispatch_group_leave(wait_group);
+	dispatch_release(wait_group);
+}
+
+- (void) setThreadPriority:(double)prio
+{
+	_threadPriority = prio;
+}
+
+- (double) threadPriority
+{
+	return _threadPriority;
+}
+
+- (void) start
+{
+	double prio = [NSThread threadPriority];
+	[NSThread setThreadPriority:_threadPriority];
+	@try
+	{
+		if (![self isCancelled])
+		{
+			[self willChangeValueForKey:@"isExecuting"];
+			_isExecuting = true;
+			[self didChangeValueForKey:@"isExecuting"];
+			[self main];
+		}
+	}
+	@finally
+	{
+		[NSThread setThreadPriority:prio];
+		[self _finish];
+	}
+}
+
+- (void) main
+{
+	// Empty by default
+}
+
+/*
+ * Marks the operation finished, releases anything that depends on it, and
+ * hands its slot back to the queue.  Safe to call more than once.
+ */
+- (void) _finish
+{
+	NSArray *waiting;
+	NSOperationQueue *queue;
+
+	if (_finishing.exchange(true))
+		return;
+
+	@synchronized(self)
+	{
+		if (_isExecuting)
+		{
+			[self willChangeValueForKey:@"isExecuting"];
+			_isExecuting = false;
+			[self didChangeValueForKey:@"isExecuting"];
+		}
+		[self willChangeValueForKey:@"isFinished"];
+		_isFinished = true;
+		[self didChangeValueForKey:@"isFinished"];
+		waiting = _dependents;
+		_dependents = nil;
+	}
+
+	for (NSOperation *op in waiting)
+	{
+		if (--op->_pendingDependencies == 0)
+			[op _becameReady];
+	}
+	/* Off the queue before waiters wake, so they don't find it again. */
+	queue = _queue;
+	[queue _operationFinished:self];
+
+	if (completionBlock != NULL)
+		completionBlock();
+	dispatch_group_leave(wait_group);
+}
+
+/*
+ * Concurrent operations report their own completion by posting isFinished.
+ * Catch that here rather than through an observer, since KVO notifications
+ * aren't delivered, so the queue gets the operation's slot back either way.
+ */
+- (void) didChangeValueForKey:(NSString *)key
+{
+	[super didChangeValueForKey:key];
+	if (!_finishing && [key isEqualToString:@"isFinished"] && [self isFinished])
+		[self _finish];
+}
+
+- (void) _becameReady
+{
+	[_queue _operationBecameReady:self];
+}
+
+- (bool) isCancelled
+{
+	return _isCancelled;
+}
+
+- (void) cancel
+{
+	if (!_isCancelled)
+	{
+		@synchronized(self)
+		{
+			if (_isCancelled)
+				return;
+			[self willChangeValueForKey:@"isCancelled"];
+			_isCancelled = true;
+			[self didChangeValueForKey:@"isCancelled"];
+		}
+		// A cancelled operation is ready regardless of its dependencies.
+		[self _becameReady];
+	}
+}
+
+- (bool) isConcurrent
+{
+	return false;
+}
+
+- (bool) isExecuting
+{
+	return _isExecuting;
+}
+
+- (bool) isFinished
+{
+	return _isFinished;
+}
+
+- (bool) isReady
+{
+	return (_pendingDependencies == 0 || _isCancelled);
+}
+
+- (NSOperationQueuePriority) queuePriority
+{
+	return _priority;
+}
+
+- (void) setQueuePriority:(NSOperationQueuePriority)newPrio
+{
+	if (newPrio <= NSOperationQueuePriorityVeryLow)
+		newPrio = NSOperationQueuePriorityVeryLow;
+	else if (newPrio <= NSOperationQueuePriorityLow)
+		newPrio = NSOperationQueuePriorityLow;
+	else if (newPrio <= NSOperationQueuePriorityNormal)
+		newPrio = NSOperationQueuePriorityNormal;
+	else if (newPrio <= NSOperationQueuePriorityHigh)
+		newPrio = NSOperationQueuePriorityHigh;
+	else
+		newPrio = NSOperationQueuePriorityVeryHigh;
+
+	if (newPrio != _priority)
+	{
+		@synchronized(self)
+		{
+			if (newPrio == _priority)
+				return;
+			[self willChangeValueForKey:@"queuePriority"];
+			_priority = newPrio;
+			[self didChangeValueForKey:@"queuePriority"];
+		}
+	}
+}
+
+- (void) setCompletionBlock:(void (^)(void))block
+{
+	completionBlock = [block copy];
+}
+
+- (void (^)(void)) completionBlock
+{
+	return completionBlock;
+}
+
+- (NSArray *) dependencies
+{
+	@synchronized(self)
+	{
+		return [dependencies copy];
+	}
+}
+
+- (void) addDependency:(NSOperation *)dep
+{
+	@synchronized(self)
+	{
+		if ([dependencies indexOfObjectIdenticalTo:dep] != NSNotFound)
+			return;
+		[self willChangeValueForKey:@"dependencies"];
+		[dependencies addObject:dep];
+		[self didChangeValueForKey:@"dependencies"];
+	}
+
+	@synchronized(dep)
+	{
+		if (!dep->_isFinished)
+		{
+			_pendingDependencies++;
+			if (dep->_dependents == nil)
+				dep->_dependents = [NSMutableArray new];
+			[dep->_dependents addObject:self];
+		}
+	}
+}
+
+- (void) removeDependency:(NSOperation *)dep
+{
+	bool wasPending = false;
+
+	@synchronized(self)
+	{
+		NSParameterAssert([dependencies indexOfObjectIdenticalTo:dep] != NSNotFound);
+		[self willChangeValueForKey:@"dependencies"];
+		[dependencies removeObjectIdenticalTo:dep];
+		[self didChangeValueForKey:@"dependencies"];
+	}
+
+	@synchronized(dep)
+	{
+		NSUInteger idx = [dep->_dependents indexOfObjectIdenticalTo:self];
+
+		if (idx != NSNotFound)
+		{
+			[dep->_dependents removeObjectAtIndex:idx];
+			wasPending = true;
+		}
+	}
+	if (wasPending && --_pendingDependencies == 0)
+		[self _becameReady];
+}
+
+- (void) waitUntilFinished
+{
+	dispatch_group_wait(wait_group, DISPATCH_TIME_FOREVER);
+}
+@end
+
+@implementation NSInvocationOperationVoidResultException
+@end
+@implementation NSInvocationOperationCancelledException
+@end
+
+@implementation NSInvocationOperation
+- (id) initWithTarget:(id)target selector:(SEL)sel object:(id)object
+{
+	NSInvocation *inv;
+	
+	inv = [NSInvocation invocationWithMethodSignature:[target methodSignatureForSelector:sel]];
+	[inv setTarget:target];
+	[inv setSelector:sel];
+	[inv setArgument:(__bridge void *)object atIndex:2];
+	return [self initWithInvocation:inv];
+}
+
+- (id) initWithInvocation:(NSInvocation *)inv
+{
+	if ((self = [super init]) == nil)
+		return nil;
+
+	_inv = inv;
+	return self;
+}
+
+- (NSInvocation *) invocation
+{
+	return _inv;
+}
+
+- (id) result
+{
+	id retval;
+	if (_except != nil)
+		@throw _except;
+	if ([self isCancelled])
+		@throw [NSInvocationOperationCancelledException
+			exceptionWithReason:@"InvocationOperation cancelled." userInfo:nil];
+	if (*[[_inv methodSignature] methodReturnType] == _C_VOID)
+		@throw [NSInvocationOperationVoidResultException
+			exceptionWithReason:@"Void return value" userInfo:nil];
+
+	[_inv getReturnValue:&retval];
+	return retval;
+}
+
+- (void) main
+{
+	@try
+	{
+		[_inv invoke];
+	}
+	@catch (id except)
+	{
+		_except = except;
+	}
+}
+
+@end
+
+@implementation NSBlockOperation
+{
+	NSMutableArray *blocks;
+}
+
++ (id) blockOperationWithBlock:(void (^)(void))block
+{
+	NSBlockOperation *op = [self new];
+
+	[op addExecutionBlock:block];
+	return op;
+}
+
+- (void) addExecutionBlock:(void (^)(void))block
+{
+	@synchronized(self)
+	{
+		if (blocks == nil)
+			blocks = [NSMutableArray new];
+		[blocks addObject:[block copy]];
+	}
+}
+
+- (NSArray *) executionBlocks
+{
+	@synchronized(self)
+	{
+		return [blocks copy];
+	}
+}
+
+- (void) main
+{
+	for (void (^block)(void) in [self executionBlocks])
+	{
+		block();
+	}
+}
+@end
+
+/*
+ * Implementation of NSOperationQueue:
+ *
+ * The queue does its own scheduling rather than leaning on a private serial
+ * dispatch queue.  Ready operations wait in one FIFO per priority level; as
+ * long as fewer than maxConcurrentOperationCount operations are running, the
+ * highest priority ready operation is dispatched onto the global queue that
+ * matches its priority (or the main queue, for +mainQueue).
+ *
+ * Readiness is driven by each operation's count of unfinished dependencies.
+ * When the count drops to zero, or the operation is cancelled, it is handed to
+ * its queue exactly once.  All operations are also kept on an intrusive list,
+ * in the order added, so a finished operation is unlinked in constant time.
+ *
+ * Operations returning true from -isConcurrent may still be running when
+ * -start returns; they release their slot from -didChangeValueForKey: once
+ * they post isFinished.
+ */
+#define PRIORITY_LEVELS	5
+
+static inline int priority_level(NSOperationQueuePriority prio)
+{
+	return (prio - NSOperationQueuePriorityVeryLow) /
+		(NSOperationQueuePriorityLow - NSOperationQueuePriorityVeryLow);
+}
+
+static __thread __unsafe_unretained NSOperationQueue *currentQueue;
+
+@implementation NSOperationQueue
+{
+@private
+	dispatch_queue_t _private;	// Target queue, NULL for the global queues.
+	bool _suspended;
+	NSInteger maxConcurrentOperationCount;
+	std::mutex lock;
+	std::deque<NSOperation *> ready[PRIORITY_LEVELS];
+	NSInteger running;
+	NSUInteger count;
+	NSOperation *head;
+	__unsafe_unretained NSOperation *tail;
+}
+@synthesize name;
+
+static NSOperationQueue *mainQueue = nil;
+static NSString * const mainQueueKey = @"_NSOperationQueueMainQueryKey";
+
+static void run_operation(void *ctx);
+
++ (bool) automaticallyNotifiesObserversForKey:(NSString *)key
+{
+	return false;
+}
+
++ (id) currentQueue
+{
+	return currentQueue;
+}
+
++ (id) mainQueue
+{
+	if (mainQueue == nil)
+	{
+		@synchronized(mainQueueKey)
+		{
+			if (mainQueue == nil)
+			{
+				mainQueue = [self new];
+				mainQueue->_private = dispatch_get_main_queue();
+				mainQueue->maxConcurrentOperationCount = 1;
+			}
+		}
+	}
+	return mainQueue;
+}
+
+- (id) init
+{
+	maxConcurrentOperationCount = NSOperationQueueDefaultMaxConcurrentOperationCount;
+	return self;
+}
+
+- (void) dealloc
+{
+	// Unlink iteratively, so a long list isn't released recursively.
+	while (head != nil)
+	{
+		NSOperation *op = head;
+		head = op->_queueNext;
+		op->_queueNext = nil;
+	}
+}
+
+- (void) _validateOperation:(NSOperation *)op
+{
+	if ([op isExecuting] || [op isFinished])
+		@throw [NSInvalidArgumentException exceptionWithReason:@"Operation already executing or finished." userInfo:[NSDictionary dictionaryWithObject:op forKey:@"Object"]];
+	if (op->_queue != nil)
+	{
+		@throw [NSInvalidArgumentException exceptionWithReason:@"Operation already in another queue." userInfo:[NSDictionary dictionaryWithObject:op forKey:@"Object"]];
+	}
+}
+
+- (void) _addOperation:(NSOperation *)op
+{
+	{
+		std::lock_guard<std::mutex> locker(lock);
+
+		op->_queue = self;
+		op->_queuePrev = tail;
+		if (tail != nil)
+			tail->_queueNext = op;
+		else
+			head = op;
+		tail = op;
+		count++;
+	}
+	if ([op isReady])
+		[self _operationBecameReady:op];
+}
+
+- (void) _operationBecameReady:(NSOperation *)op
+{
+	if (op->_enqueued.exchange(true))
+		return;
+
+	{
+		std::lock_guard<std::mutex> locker(lock);
+
+		// It may already have finished, and left the queue, without running.
+		if (op->_queue != self)
+			return;
+		ready[priority_level([op queuePriority])].push_back(op);
+	}
+	[self _schedule];
+}
+
+/* Start ready operations until the queue is full or out of ready work. */
+- (void) _schedule
+{
+	for (;;)
+	{
+		NSOperation *op = nil;
+		dispatch_queue_t target = _private;
+
+		{
+			std::lock_guard<std::mutex> locker(lock);
+
+			if (_suspended)
+				return;
+			if (maxConcurrentOperationCount >= 0 &&
+					running >= maxConcurrentOperationCount)
+				return;
+			for (int level = PRIORITY_LEVELS - 1; level >= 0; level--)
+			{
+				if (!ready[level].empty())
+				{
+					op = ready[level].front();
+					ready[level].pop_front();
+					break;
+				}
+			}
+			if (op == nil)
+				return;
+			op->_dispatched = true;
+			running++;
+		}
+
+		if (target == NULL)
+		{
+			long prio;
+
+			switch ([op queuePriority])
+			{
+				case NSOperationQueuePriorityVeryLow:
+				case NSOperationQueuePriorityLow:
+					prio = DISPATCH_QUEUE_PRIORITY_LOW;
+					break;
+				case NSOperationQueuePriorityVeryHigh:
+				case NSOperationQueuePriorityHigh:
+					prio = DISPATCH_QUEUE_PRIORITY_HIGH;
+					break;
+				default:
+					prio = DISPATCH_QUEUE_PRIORITY_DEFAULT;
+					break;
+			}
+			target = dispatch_get_global_queue(prio, 0);
+		}
+		dispatch_async_f(target, (__bridge_retained void *)op, run_operation);
+	}
+}
+
+- (void) _operationFinished:(NSOperation *)op
+{
+	{
+		std::lock_guard<std::mutex> locker(lock);
+
+		if (op->_queue != self)
+			return;
+		if (op->_queuePrev != nil)
+			op->_queuePrev->_queueNext = op->_queueNext;
+		else
+			head = op->_queueNext;
+		if (op->_queueNext != nil)
+			op->_queueNext->_queuePrev = op->_queuePrev;
+		else
+			tail = op->_queuePrev;
+		op->_queuePrev = nil;
+		op->_queueNext = nil;
+		op->_queue = nil;
+		count--;
+		if (op->_dispatched)
+			running--;
+		else if (op->_enqueued)
+		{
+			/*
+			 * Finished without being started, as a concurrent operation may
+			 * when cancelled; it must not be dispatched later.
+			 */
+			for (auto &level : ready)
+			{
+				auto i = std::find(level.begin(), level.end(), op);
+
+				if (i != level.end())
+				{
+					level.erase(i);
+					break;
+				}
+			}
+		}
+	}
+	[self _schedule];
+}
+
+- (void) addOperation:(NSOperation *)op
+{
+	[self _validateOperation:op];
+	[self _addOperation:op];
+}
+
+- (void) addOperationWithBlock:(void (^)(void))block
+{
+	[self addOperation:[NSBlockOperation blockOperationWithBlock:block]];
+}
+
+- (void) addOperations:(NSArray *)ops waitUntilFinished:(bool)wait
+{
+	for (id op in ops)
+	{
+		[self _validateOperation:op];
+	}
+
+	for (id op in ops)
+	{
+		[self _addOperation:op];
+	}
+
+	if (wait)
+	{
+		for (id op in ops)
+		{
+			[op waitUntilFinished];
+		}
+	}
+}
+
+- (void) cancelAllOperations
+{
+	[[self operations] makeObjectsPerformSelector:@selector(cancel)];
+}
+
+- (NSUInteger) operationCount
+{
+	std::lock_guard<std::mutex> locker(lock);
+
+	return count;
+}
+
+- (NSArray *) operations
+{
+	NSMutableArray *ops;
+	std::lock_guard<std::mutex> locker(lock);
+
+	ops = [NSMutableArray arrayWithCapacity:count];
+	for (NSOperation *op = head; op != nil; op = op->_queueNext)
+		[ops addObject:op];
+	return ops;
+}
+
+- (NSInteger) maxConcurrentOperationCount
+{
+	return maxConcurrentOperationCount;
+}
+
+- (void) setMaxConcurrentOperationCount:(NSInteger)newCount
+{
+	{
+		std::lock_guard<std::mutex> locker(lock);
+		maxConcurrentOperationCount = newCount;
+	}
+	[self _schedule];
+}
+
+- (bool) isSuspended
+{
+	return _suspended;
+}
+
+- (void) setSuspended:(bool)suspend
+{
+	{
+		std::lock_guard<std::mutex> locker(lock);
+
+		if (suspend == _suspended)
+			return;
+		_suspended = suspend;
+	}
+	if (!suspend)
+		[self _schedule];
+}
+
+- (void) waitUntilAllOperationsAreFinished
+{
+	NSOperation *op;
+	do
+	{
+		// Synchronization is only required when retrieving an operation, not
+		// releasing it.
+		{
+			std::lock_guard<std::mutex> locker(lock);
+			op = tail;
+		}
+		[op waitUntilFinished];
+	} while (op != nil);
+}
+
+/* Runs one NSOperation on the dispatch queue it was scheduled onto. */
+static void run_operation(void *ctx)
+{
+	NSOperation *op = (__bridge_transfer NSOperation *)ctx;
+	NSOperationQueue *queue = op->_queue;
+	NSOperationQueue *oldQueue = currentQueue;
+
+	currentQueue = queue;
+	@autoreleasepool
+	{
+		if ([op isConcurrent])
+		{
+			[op start];
+			/* In case it finished without posting isFinished. */
+			if ([op isFinished])
+				[op _finish];
+		}
+		else
+		{
+			[op start];
+			[op _finish];
+		}
+	}
+	currentQueue = oldQueue;
+}
+@end
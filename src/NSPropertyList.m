@@ -28,6 +28,8 @@
  * 
  */
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #import <Foundation/NSPropertyList.h>
@@ -56,6 +58,639 @@ static NSUInteger writeXMLPropertyList(id plist, NSOutputStream *outStream,
 static NSUInteger writeBinaryPropertyList(id plist, NSOutputStream *outStream,
 		NSPropertyListWriteOptions opts, NSUInteger indent, NSError **err);
 
+/*
+ * Binary property lists (bplist00)
+ *
+ * A binary plist is a header, a flat table of objects, an offset table giving
+ * the position of each object, and a trailer describing the integer sizes
+ * used by the tables.  Collections refer to their members by index into the
+ * offset table, so equal leaf objects need only be written once, and a reader
+ * can decode any object directly from the buffer without scanning the rest.
+ */
+
+#define BPLIST_HEADER		"bplist00"
+#define BPLIST_HEADER_LEN	8
+#define BPLIST_TRAILER_LEN	32
+
+#define BPLIST_NULL		0x00
+#define BPLIST_FALSE	0x08
+#define BPLIST_TRUE		0x09
+#define BPLIST_INT		0x10
+#define BPLIST_REAL		0x20
+#define BPLIST_DATE		0x33
+#define BPLIST_DATA		0x40
+#define BPLIST_ASCII	0x50
+#define BPLIST_UNICODE	0x60
+#define BPLIST_UID		0x80
+#define BPLIST_ARRAY	0xA0
+#define BPLIST_SET		0xC0
+#define BPLIST_DICT		0xD0
+
+/*
+ * Containers nested deeper than this are treated as corrupt, rather than
+ * letting a crafted file recurse the reader off the end of the stack.
+ */
+#define BPLIST_MAX_DEPTH	512
+
+static inline void appendBigEndian(NSMutableData *out, uint64_t value, size_t size)
+{
+	uint8_t buf[8];
+
+	for (size_t i = 0; i < size; i++)
+		buf[i] = value >> (8 * (size - i - 1));
+	[out appendBytes:buf length:size];
+}
+
+static inline uint64_t readBigEndian(const uint8_t *bytes, size_t size)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; i++)
+		value = (value << 8) | bytes[i];
+	return value;
+}
+
+static inline uint8_t bytesNeeded(uint64_t value)
+{
+	if (value <= UINT8_MAX)
+		return 1;
+	if (value <= UINT16_MAX)
+		return 2;
+	if (value <= UINT32_MAX)
+		return 4;
+	return 8;
+}
+
+/* log2 of an integer size of 1, 2, 4 or 8 bytes. */
+static inline uint8_t sizeExponent(uint8_t size)
+{
+	return (size == 1) ? 0 : (size == 2) ? 1 : (size == 4) ? 2 : 3;
+}
+
+static void writeInteger(NSMutableData *out, uint64_t value)
+{
+	uint8_t size = bytesNeeded(value);
+
+	appendBigEndian(out, BPLIST_INT | sizeExponent(size), 1);
+	appendBigEndian(out, value, size);
+}
+
+static void writeMarker(NSMutableData *out, uint8_t type, uint64_t count)
+{
+	if (count < 0xF)
+	{
+		appendBigEndian(out, type | count, 1);
+		return;
+	}
+	appendBigEndian(out, type | 0xF, 1);
+	writeInteger(out, count);
+}
+
+static void writeDouble(NSMutableData *out, uint8_t marker, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	appendBigEndian(out, marker, 1);
+	appendBigEndian(out, bits, 8);
+}
+
+@interface _NSBinaryPropertyListWriter : NSObject
+{
+	NSMutableArray *objects;
+	/* Member references for collections, NSNull for leaves. */
+	NSMutableArray *members;
+	/* Leaf objects already written, one table per encoding. */
+	NSMutableDictionary *strings;
+	NSMutableDictionary *integers;
+	NSMutableDictionary *reals;
+	NSMutableDictionary *others;
+}
+- (NSData *) dataWithPropertyList:(id)plist;
+@end
+
+@implementation _NSBinaryPropertyListWriter
+
+- (id) init
+{
+	objects = [NSMutableArray new];
+	members = [NSMutableArray new];
+	strings = [NSMutableDictionary new];
+	integers = [NSMutableDictionary new];
+	reals = [NSMutableDictionary new];
+	others = [NSMutableDictionary new];
+	return self;
+}
+
+- (NSMutableDictionary *) _uniqueTableForObject:(id)obj
+{
+	if ([obj isKindOfClass:[NSString class]])
+		return strings;
+	if ([obj isKindOfClass:[NSNumber class]])
+	{
+		switch (*[obj objCType])
+		{
+			case _C_FLT:
+			case _C_DBL:
+				return reals;
+			case _C_BOOL:
+				return others;
+			default:
+				return integers;
+		}
+	}
+	if ([obj isKindOfClass:[NSArray class]] ||
+			[obj isKindOfClass:[NSDictionary class]] ||
+			[obj isKindOfClass:[NSSet class]])
+		return nil;
+	return others;
+}
+
+static void appendReference(NSMutableData *refs, uint64_t ref)
+{
+	[refs appendBytes:&ref length:sizeof(ref)];
+}
+
+/* Assigns object references depth-first, so the root is always object 0. */
+- (uint64_t) _addObject:(id)obj
+{
+	NSMutableDictionary *table = [self _uniqueTableForObject:obj];
+	NSNumber *known;
+	uint64_t ref;
+
+	if (table != nil && (known = [table objectForKey:obj]) != nil)
+		return [known unsignedLongLongValue];
+
+	ref = [objects count];
+	[objects addObject:obj];
+	if (table != nil)
+	{
+		[table setObject:@(ref) forKey:obj];
+		[members addObject:[NSNull null]];
+		return ref;
+	}
+
+	NSMutableData *refs = [NSMutableData new];
+	[members addObject:refs];
+	if ([obj isKindOfClass:[NSDictionary class]])
+	{
+		NSArray *keys = [obj allKeys];
+
+		for (id key in keys)
+			appendReference(refs, [self _addObject:key]);
+		for (id key in keys)
+			appendReference(refs, [self _addObject:[obj objectForKey:key]]);
+	}
+	else
+	{
+		for (id member in obj)
+			appendReference(refs, [self _addObject:member]);
+	}
+	return ref;
+}
+
+- (void) _writeObject:(id)obj members:(id)refs refSize:(uint8_t)refSize
+	to:(NSMutableData *)out
+{
+	if ([obj isKindOfClass:[NSNull class]])
+	{
+		appendBigEndian(out, BPLIST_NULL, 1);
+	}
+	else if ([obj isKindOfClass:[NSNumber class]])
+	{
+		switch (*[obj objCType])
+		{
+			case _C_BOOL:
+				appendBigEndian(out, [obj boolValue] ? BPLIST_TRUE : BPLIST_FALSE, 1);
+				break;
+			case _C_FLT:
+			case _C_DBL:
+				writeDouble(out, BPLIST_REAL | 3, [obj doubleValue]);
+				break;
+			case _C_UCHR:
+			case _C_USHT:
+			case _C_UINT:
+			case _C_ULNG:
+			case _C_ULNG_LNG:
+				{
+					unsigned long long value = [obj unsignedLongLongValue];
+
+					/* Values that don't fit a signed 64-bit int take 128 bits. */
+					if (value > INT64_MAX)
+					{
+						appendBigEndian(out, BPLIST_INT | 4, 1);
+						appendBigEndian(out, 0, 8);
+						appendBigEndian(out, value, 8);
+					}
+					else
+						writeInteger(out, value);
+				}
+				break;
+			default:
+				{
+					long long value = [obj longLongValue];
+
+					/* Negative values are always written as 64 bits. */
+					if (value < 0)
+					{
+						appendBigEndian(out, BPLIST_INT | 3, 1);
+						appendBigEndian(out, (uint64_t)value, 8);
+					}
+					else
+						writeInteger(out, value);
+				}
+				break;
+		}
+	}
+	else if ([obj isKindOfClass:[NSDate class]])
+	{
+		writeDouble(out, BPLIST_DATE, [obj timeIntervalSinceReferenceDate]);
+	}
+	else if ([obj isKindOfClass:[NSData class]])
+	{
+		writeMarker(out, BPLIST_DATA, [obj length]);
+		[out appendData:obj];
+	}
+	else if ([obj isKindOfClass:[NSString class]])
+	{
+		NSUInteger length = [obj length];
+
+		if ([obj canBeConvertedToEncoding:NSASCIIStringEncoding])
+		{
+			writeMarker(out, BPLIST_ASCII, length);
+			[out appendData:[obj dataUsingEncoding:NSASCIIStringEncoding]];
+		}
+		else
+		{
+			NSUniChar *chars __cleanup(cleanup_pointer) =
+				malloc(length * sizeof(NSUniChar));
+
+			[obj getCharacters:chars range:NSMakeRange(0, length)];
+			for (NSUInteger i = 0; i < length; i++)
+				chars[i] = NSSwapHostShortToBig(chars[i]);
+			writeMarker(out, BPLIST_UNICODE, length);
+			[out appendBytes:chars length:length * sizeof(NSUniChar)];
+		}
+	}
+	else
+	{
+		const uint64_t *refList = [refs bytes];
+		NSUInteger refCount = [refs length] / sizeof(uint64_t);
+
+		if ([obj isKindOfClass:[NSDictionary class]])
+			writeMarker(out, BPLIST_DICT, refCount / 2);
+		else if ([obj isKindOfClass:[NSSet class]])
+			writeMarker(out, BPLIST_SET, refCount);
+		else
+			writeMarker(out, BPLIST_ARRAY, refCount);
+		for (NSUInteger i = 0; i < refCount; i++)
+			appendBigEndian(out, refList[i], refSize);
+	}
+}
+
+- (NSData *) dataWithPropertyList:(id)plist
+{
+	NSMutableData *out = [NSMutableData dataWithBytes:BPLIST_HEADER
+											   length:BPLIST_HEADER_LEN];
+	uint64_t *offsets __cleanup(cleanup_pointer) = NULL;
+	uint64_t tableOffset;
+	uint8_t refSize;
+	uint8_t offsetSize;
+	NSUInteger count;
+
+	[self _addObject:plist];
+	count = [objects count];
+	refSize = bytesNeeded(count);
+	offsets = malloc(count * sizeof(*offsets));
+
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		offsets[i] = [out length];
+		[self _writeObject:[objects objectAtIndex:i]
+				   members:[members objectAtIndex:i]
+				   refSize:refSize
+						to:out];
+	}
+
+	tableOffset = [out length];
+	offsetSize = bytesNeeded(tableOffset);
+	for (NSUInteger i = 0; i < count; i++)
+		appendBigEndian(out, offsets[i], offsetSize);
+
+	/* Trailer: 5 unused bytes, sort version, then the table layout. */
+	appendBigEndian(out, 0, 6);
+	appendBigEndian(out, offsetSize, 1);
+	appendBigEndian(out, refSize, 1);
+	appendBigEndian(out, count, 8);
+	appendBigEndian(out, 0, 8);
+	appendBigEndian(out, tableOffset, 8);
+	return out;
+}
+
+@end
+
+static NSUInteger writeBinaryPropertyList(id plist, NSOutputStream *outStream,
+		NSPropertyListWriteOptions opts, NSUInteger indent, NSError **err)
+{
+	NSData *data = [[_NSBinaryPropertyListWriter new] dataWithPropertyList:plist];
+	const uint8_t *bytes = [data bytes];
+	NSUInteger length = [data length];
+	NSUInteger total = 0;
+
+	while (total < length)
+	{
+		NSInteger sub = [outStream write:bytes + total maxLength:length - total];
+
+		if (sub <= 0)
+			break;
+		total += sub;
+	}
+	return total;
+}
+
+/*
+ * The reader decodes objects on demand straight out of the data buffer,
+ * starting from the top object.  Every offset, length and reference is
+ * bounds-checked against the object table, and references back into an
+ * object still being decoded are rejected, so corrupt input fails cleanly.
+ */
+@interface _NSBinaryPropertyListReader : NSObject
+{
+	NSData *data;
+	const uint8_t *bytes;
+	uint64_t tableOffset;
+	uint64_t objectCount;
+	uint64_t topObject;
+	uint8_t offsetSize;
+	uint8_t refSize;
+	NSPropertyListReadOptions options;
+	/* Objects already decoded; NSNull marks those not decoded yet. */
+	NSMutableArray *decoded;
+	uint8_t *inProgress;
+}
+- (id) initWithData:(NSData *)d options:(NSPropertyListReadOptions)opts;
+- (id) propertyList;
+@end
+
+@implementation _NSBinaryPropertyListReader
+
+- (id) initWithData:(NSData *)d options:(NSPropertyListReadOptions)opts
+{
+	NSUInteger length = [d length];
+	const uint8_t *trailer;
+
+	data = d;
+	bytes = [d bytes];
+	options = opts;
+
+	if (length < BPLIST_HEADER_LEN + BPLIST_TRAILER_LEN ||
+			memcmp(bytes, BPLIST_HEADER, BPLIST_HEADER_LEN) != 0)
+		return nil;
+
+	trailer = bytes + length - BPLIST_TRAILER_LEN;
+	offsetSize = trailer[6];
+	refSize = trailer[7];
+	objectCount = readBigEndian(trailer + 8, 8);
+	topObject = readBigEndian(trailer + 16, 8);
+	tableOffset = readBigEndian(trailer + 24, 8);
+
+	if (offsetSize < 1 || offsetSize > 8 || refSize < 1 || refSize > 8)
+		return nil;
+	if (objectCount == 0 || topObject >= objectCount)
+		return nil;
+	if (tableOffset < BPLIST_HEADER_LEN ||
+			tableOffset > length - BPLIST_TRAILER_LEN ||
+			objectCount > (length - BPLIST_TRAILER_LEN - tableOffset) / offsetSize)
+		return nil;
+
+	inProgress = calloc(objectCount, 1);
+	if (inProgress == NULL)
+		return nil;
+	decoded = [[NSMutableArray alloc] initWithCapacity:objectCount];
+	for (uint64_t i = 0; i < objectCount; i++)
+		[decoded addObject:[NSNull null]];
+	return self;
+}
+
+- (void) dealloc
+{
+	free(inProgress);
+}
+
+/*
+ * Reads the count following a marker, which is either the low nibble of the
+ * marker or, when that is 0xF, an integer object of its own.
+ */
+- (bool) _readCount:(uint64_t *)count info:(uint8_t)info
+	cursor:(const uint8_t **)cursor end:(const uint8_t *)end
+{
+	const uint8_t *p = *cursor;
+	uint8_t size;
+
+	if (info != 0xF)
+	{
+		*count = info;
+		return true;
+	}
+	if (p >= end || (*p & 0xF0) != BPLIST_INT || (*p & 0xF) > 3)
+		return false;
+	size = 1 << (*p++ & 0xF);
+	if ((uint64_t)(end - p) < size)
+		return false;
+	*count = readBigEndian(p, size);
+	*cursor = p + size;
+	return true;
+}
+
+- (id) _objectForReference:(uint64_t)ref depth:(unsigned)depth
+{
+	const uint8_t *end = bytes + tableOffset;
+	const uint8_t *p;
+	uint64_t offset;
+	uint64_t count;
+	uint8_t marker;
+	uint8_t info;
+	id result = nil;
+	bool mutableContainers = (options != NSPropertyListImmutable);
+	bool mutableLeaves = (options == NSPropertyListMutableContainersAndLeaves);
+
+	if (ref >= objectCount || depth > BPLIST_MAX_DEPTH)
+		return nil;
+	result = [decoded objectAtIndex:ref];
+	if (result != [NSNull null])
+		return result;
+	result = nil;
+	if (inProgress[ref])
+		return nil;
+
+	offset = readBigEndian(bytes + tableOffset + ref * offsetSize, offsetSize);
+	if (offset < BPLIST_HEADER_LEN || offset >= tableOffset)
+		return nil;
+	p = bytes + offset;
+	marker = *p++;
+	info = marker & 0xF;
+
+	switch (marker & 0xF0)
+	{
+		case 0x00:
+			if (marker == BPLIST_NULL)
+				result = [NSNull null];
+			else if (marker == BPLIST_FALSE)
+				result = @NO;
+			else if (marker == BPLIST_TRUE)
+				result = @YES;
+			break;
+		case BPLIST_INT:
+			{
+				size_t size = 1 << info;
+
+				if (info > 4 || (uint64_t)(end - p) < size)
+					break;
+				if (size == 16)
+					result = @((unsigned long long)readBigEndian(p + 8, 8));
+				else if (size == 8)
+					result = @((long long)readBigEndian(p, 8));
+				else
+					result = @((long long)readBigEndian(p, size));
+			}
+			break;
+		case BPLIST_REAL:
+			if (info == 2 && end - p >= 4)
+			{
+				uint32_t bits = readBigEndian(p, 4);
+				float value;
+
+				memcpy(&value, &bits, sizeof(value));
+				result = @(value);
+			}
+			else if (info == 3 && end - p >= 8)
+			{
+				uint64_t bits = readBigEndian(p, 8);
+				double value;
+
+				memcpy(&value, &bits, sizeof(value));
+				result = @(value);
+			}
+			break;
+		case (BPLIST_DATE & 0xF0):
+			if (marker == BPLIST_DATE && end - p >= 8)
+			{
+				uint64_t bits = readBigEndian(p, 8);
+				double value;
+
+				memcpy(&value, &bits, sizeof(value));
+				result = [NSDate dateWithTimeIntervalSinceReferenceDate:value];
+			}
+			break;
+		case BPLIST_DATA:
+			if (![self _readCount:&count info:info cursor:&p end:end] ||
+					count > (uint64_t)(end - p))
+				break;
+			result = [(mutableLeaves ? [NSMutableData class] : [NSData class])
+				dataWithBytes:p length:count];
+			break;
+		case BPLIST_ASCII:
+			if (![self _readCount:&count info:info cursor:&p end:end] ||
+					count > (uint64_t)(end - p))
+				break;
+			result = [[(mutableLeaves ? [NSMutableString class] : [NSString class]) alloc]
+				initWithBytes:p length:count encoding:NSASCIIStringEncoding];
+			break;
+		case BPLIST_UNICODE:
+			if (![self _readCount:&count info:info cursor:&p end:end] ||
+					count > (uint64_t)(end - p) / 2)
+				break;
+			result = [[(mutableLeaves ? [NSMutableString class] : [NSString class]) alloc]
+				initWithBytes:p length:count * 2 encoding:NSUTF16BigEndianStringEncoding];
+			break;
+		case BPLIST_UID:
+			if ((uint64_t)(end - p) < (uint64_t)info + 1)
+				break;
+			/* Keyed archives store object references as UIDs. */
+			result = @{ @"CF$UID" : @((unsigned long long)readBigEndian(p, info + 1)) };
+			break;
+		case BPLIST_ARRAY:
+		case BPLIST_SET:
+		case BPLIST_DICT:
+			{
+				uint64_t maxCount;
+
+				if (![self _readCount:&count info:info cursor:&p end:end])
+					break;
+				maxCount = (uint64_t)(end - p) / refSize;
+				if ((marker & 0xF0) == BPLIST_DICT)
+					maxCount /= 2;
+				if (count > maxCount)
+					break;
+				inProgress[ref] = 1;
+				result = [self _collectionWithMarker:marker & 0xF0
+											   count:count
+												refs:p
+											 mutable:mutableContainers
+											   depth:depth + 1];
+				inProgress[ref] = 0;
+			}
+			break;
+	}
+
+	/* Mutable objects must be distinct, even if referenced twice. */
+	if (result != nil)
+	{
+		bool isContainer = ((marker & 0xF0) >= BPLIST_ARRAY);
+
+		if (isContainer ? !mutableContainers : !mutableLeaves)
+			[decoded replaceObjectAtIndex:ref withObject:result];
+	}
+	return result;
+}
+
+- (id) _collectionWithMarker:(uint8_t)type count:(uint64_t)count
+	refs:(const uint8_t *)refs mutable:(bool)isMutable depth:(unsigned)depth
+{
+	if (type == BPLIST_DICT)
+	{
+		NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithCapacity:count];
+
+		for (uint64_t i = 0; i < count; i++)
+		{
+			id key = [self _objectForReference:readBigEndian(refs + i * refSize, refSize)
+										 depth:depth];
+			id value = [self _objectForReference:readBigEndian(refs + (count + i) * refSize, refSize)
+										   depth:depth];
+
+			if (key == nil || value == nil)
+				return nil;
+			[dict setObject:value forKey:key];
+		}
+		return isMutable ? dict : [NSDictionary dictionaryWithDictionary:dict];
+	}
+
+	id collection = (type == BPLIST_SET) ?
+		[NSMutableSet setWithCapacity:count] :
+		[NSMutableArray arrayWithCapacity:count];
+
+	for (uint64_t i = 0; i < count; i++)
+	{
+		id member = [self _objectForReference:readBigEndian(refs + i * refSize, refSize)
+										depth:depth];
+
+		if (member == nil)
+			return nil;
+		[collection addObject:member];
+	}
+	if (isMutable)
+		return collection;
+	return (type == BPLIST_SET) ? [NSSet setWithSet:collection] :
+		[NSArray arrayWithArray:collection];
+}
+
+- (id) propertyList
+{
+	return [self _objectForReference:topObject depth:0];
+}
+
+@end
+
 @implementation NSPropertyListSerialization
 {
 }
@@ -104,21 +739,69 @@ static NSUInteger writeBinaryPropertyList(id plist, NSOutputStream *outStream,
 + (id)propertyListWithData:(NSData *)data options:(NSPropertyListReadOptions)opts
 	format:(NSPropertyListFormat *)format error:(NSError **)err
 {
-	NSInputStream *input = [NSInputStream inputStreamWithData:data];
-	return [self propertyListWithStream:input options:opts format:format error:err];
+	id plist = nil;
+
+	if ([data length] >= BPLIST_HEADER_LEN &&
+			memcmp([data bytes], BPLIST_HEADER, BPLIST_HEADER_LEN) == 0)
+	{
+		plist = [[[_NSBinaryPropertyListReader alloc] initWithData:data
+														   options:opts] propertyList];
+		if (plist != nil)
+		{
+			if (format != NULL)
+				*format = NSPropertyListBinaryFormat_v1_0;
+			return plist;
+		}
+		if (err != NULL)
+		{
+			*err = [NSError errorWithDomain:NSCocoaErrorDomain code:0
+								   userInfo:@{
+				 NSLocalizedDescriptionKey : @"Corrupt binary property list"
+								   }];
+		}
+		return nil;
+	}
+
+	TODO;	// Parse XML and OpenStep property lists
+	if (err != NULL)
+	{
+		*err = [NSError errorWithDomain:NSCocoaErrorDomain code:0
+							   userInfo:@{
+			 NSLocalizedDescriptionKey : @"Unsupported property list format"
+							   }];
+	}
+	return nil;
 }
 
 + (id) propertyListWithStream:(NSInputStream *)stream options:(NSPropertyListReadOptions)opt
 	format:(NSPropertyListFormat *)format error:(NSError **)err
 {
-	TODO;	// -[NSPropertyListSerialization propertyListWithStream:options:format:error:]
-	return nil;
+	NSMutableData *data = [NSMutableData data];
+	uint8_t buffer[4096];
+	NSInteger len;
+
+	if ([stream streamStatus] == NSStreamStatusNotOpen)
+		[stream open];
+	while ((len = [stream read:buffer maxLength:sizeof(buffer)]) > 0)
+		[data appendBytes:buffer length:len];
+	return [self propertyListWithData:data options:opt format:format error:err];
 }
 
 
 static bool _NSPropertyListCheckTypes(id plist, NSArray *validTypes)
 {
-	if (![validTypes containsObject:[plist class]])
+	bool valid = false;
+
+	/* Concrete classes are private subclasses of the public ones. */
+	for (Class cls in validTypes)
+	{
+		if ([plist isKindOfClass:cls])
+		{
+			valid = true;
+			break;
+		}
+	}
+	if (!valid)
 	{
 		return false;
 	}
@@ -338,113 +1021,6 @@ static NSUInteger writeOpenStepPropertyList(id plist, NSOutputStream *outStream,
 	return total;
 }
 
-static NSUInteger writeBinaryPropertyList(id plist, NSOutputStream *outStream,
-		NSPropertyListWriteOptions opts, NSUInteger indent, NSError **err)
-{
-	//NSMutableArray *offsets = [NSMutableArray array];
-
-	TODO; // writeBinaryPropertyList()
-	NSInteger sub;
-	NSUInteger total = 0;
-
-	sub = [outStream write:"bplist01" maxLength:strlen("bplist01")];
-	if (sub < 0)
-		return 0;
-
-	total += sub;
-
-
-	return total;
-}
-
-static NSUInteger writeBinaryPropertyListInt(id plist, NSOutputStream *outStream,
-		NSPropertyListWriteOptions opts, NSUInteger indent, NSError **err)
-{
-	NSInteger sub = 0;
-	if ([plist isKindOfClass:[NSNull class]])
-	{
-		sub = [outStream write:&(uint8_t){0} maxLength:1];
-		return (sub >= 0 ? sub : 0);
-	}
-	else if ([plist isKindOfClass:[NSNumber class]])
-	{
-		if (strcmp([plist objCType], @encode(bool)) == 0)
-		{
-			sub = [outStream write:&(uint8_t){0x08 | [plist boolValue]} maxLength:1];
-			return (sub >= 0 ? sub : 0);
-		}
-	}
-	else if ([plist isKindOfClass:[NSString class]])
-	{
-		NSData *d;
-		uint8_t prefix;
-		if ([plist canBeConvertedToEncoding:NSASCIIStringEncoding])
-		{
-			prefix = 0x50;
-			d = [plist dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:false];
-		}
-		else
-		{
-			prefix = 0x60;
-			d = [plist dataUsingEncoding:NSUTF16BigEndianStringEncoding allowLossyConversion:false];
-		}
-		if ([d length] > 15)
-		{
-			prefix |= 0xF;
-			uint32_t len = [d length];
-			sub = [outStream write:&(uint8_t){prefix} maxLength:1];
-			if (sub < 0)
-				return 0;
-			len = NSSwapHostIntToBig(len);
-			sub = [outStream write:(uint8_t *)&len maxLength:sizeof(len)];
-			if (sub < 0)
-				return 0;
-		}
-	}
-	else if ([plist isKindOfClass:[NSData class]])
-	{
-		if ([plist length] > 15)
-		{
-			uint32_t i = [plist length];
-
-			sub = [outStream write:&(uint8_t){0x4F} maxLength:1];
-			if (sub < 0)
-				return 0;
-			i = NSSwapHostIntToBig(i);
-			sub = [outStream write:(uint8_t *)&i maxLength:sizeof(i)];
-			if (sub < 0)
-				return 0;
-		}
-		else
-		{
-			sub = [outStream write:&(uint8_t){0x40 | [plist length]} maxLength:1];
-			if (sub < 0)
-				return 0;
-		}
-		sub = [outStream write:[plist bytes] maxLength:[plist length]];
-		return (sub > 0 ? sub : 0);
-	}
-	else if ([plist isKindOfClass:[NSDate class]])
-	{
-		unsigned long long date = NSSwapHostDoubleToBig([plist timeIntervalSinceReferenceDate]).v;
-		sub = [outStream write:&(uint8_t){0x33} maxLength:1];
-		if (sub < 0 )
-			return 0;
-		sub = [outStream write:(uint8_t *)&date maxLength:8];
-		return (sub >= 0 ? sub : 0);
-	}
-	else if ([plist isKindOfClass:[NSSet class]])
-	{
-	}
-	else if ([plist isKindOfClass:[NSArray class]])
-	{
-	}
-	else if ([plist isKindOfClass:[NSDictionary class]])
-	{
-	}
-	return sub;
-}
-
 static NSUInteger writeXMLPropertyListInt(id plist, NSOutputStream *outStream,
 		NSPropertyListWriteOptions opts, NSUInteger indent, NSError **err);
 
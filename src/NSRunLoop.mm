@@ -30,17 +30,19 @@
  */
 
 #include <sys/types.h>
-#include <sys/event.h>
 #include <sys/time.h>
-#include <sys/timex.h>	// for NANOSECOND
 
+#include <errno.h>
 #include <math.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <dispatch/dispatch.h>
 
@@ -55,6 +57,7 @@
 #import <Foundation/NSThread.h>
 #import <Foundation/NSTimer.h>
 #include "internal.h"
+#include "NSRunLoopEvent.h"
 
 #define MAX_EVENTS 100
 
@@ -65,10 +68,28 @@ NSMakeSymbol(NSRunLoopCommonModes);
 
 typedef std::multimap<NSUInteger,NSInvocation *> performMap;
 
+/*
+ * Each mode keeps its timers in a binary min-heap on the monotonic fire time.
+ * Entries are never updated in place: rescheduling a timer pushes a new entry,
+ * and entries that no longer match their timer (invalidated, or rescheduled
+ * since) are dropped when they reach the top.  The heap is rebuilt from the
+ * live set whenever stale entries outnumber live ones.
+ */
+struct _NSTimerEntry {
+	uint64_t when;
+	NSTimer *timer;
+
+	bool operator>(const _NSTimerEntry &other) const
+	{
+		return when > other.when;
+	}
+};
+
 struct _NSRunLoopMode {
-	NSMutableArray *timers = nil;
+	std::vector<_NSTimerEntry> timerHeap;
+	std::unordered_set<NSTimer *> timers;
 	performMap performers;
-	int queue = kqueue();
+	_NSRunLoopEventQueue queue;
 };
 
 @implementation NSRunLoop
@@ -108,14 +129,6 @@ struct _NSRunLoopMode {
 	return self;
 }
 
-- (void) dealloc
-{
-	for (auto i: modes)
-	{
-		close(i.second.queue);
-	}
-}
-
 - (void) addPort:(NSPort *)port forMode:(NSString *)mode
 {
 	[port scheduleInRunLoop:self forMode:mode];
@@ -126,49 +139,116 @@ struct _NSRunLoopMode {
 	[port removeFromRunLoop:self forMode:mode];
 }
 
-/*
-   Design of timers in NSRunLoop:
- */
+static void pushTimer(_NSRunLoopMode &m, NSTimer *timer)
+{
+	m.timerHeap.push_back(_NSTimerEntry{[timer _fireTime], timer});
+	std::push_heap(m.timerHeap.begin(), m.timerHeap.end(),
+			std::greater<_NSTimerEntry>());
+}
+
+static void compactTimers(_NSRunLoopMode &m)
+{
+	if (m.timerHeap.size() <= 2 * m.timers.size() + 16)
+		return;
+
+	m.timerHeap.clear();
+	for (NSTimer *timer : m.timers)
+		m.timerHeap.push_back(_NSTimerEntry{[timer _fireTime], timer});
+	std::make_heap(m.timerHeap.begin(), m.timerHeap.end(),
+			std::greater<_NSTimerEntry>());
+}
+
 - (void) addTimer:(NSTimer *)timer forMode:(NSString *)mode
 {
 	/* Don't add an invalidated timer */
 	if (![timer isValid])
 		return;
 
-	if (modes[mode].timers == nil)
-		modes[mode].timers = [NSMutableArray array];
-	[modes[mode].timers addObject:timer];
+	_NSRunLoopMode &m = modes[mode];
+
+	if (!m.timers.insert(timer).second)
+		return;
+	[timer _setRunLoop:self];
+	pushTimer(m, timer);
+	compactTimers(m);
+}
+
+- (void) _timerDidReschedule:(NSTimer *)timer
+{
+	for (auto &mode : modes)
+	{
+		if (mode.second.timers.count(timer) != 0)
+		{
+			pushTimer(mode.second, timer);
+			compactTimers(mode.second);
+		}
+	}
+}
+
+- (void) _removeTimer:(NSTimer *)timer
+{
+	for (auto &mode : modes)
+	{
+		if (mode.second.timers.erase(timer) != 0)
+			compactTimers(mode.second);
+	}
+}
+
+/*
+ * Fire every timer due by 'now', and return when the next one is due, or
+ * UINT64_MAX if there are none.
+ */
+static uint64_t fireTimers(_NSRunLoopMode &m, uint64_t now)
+{
+	while (!m.timerHeap.empty())
+	{
+		_NSTimerEntry top = m.timerHeap.front();
+
+		if (top.when > now && [top.timer isValid] &&
+				top.when == [top.timer _fireTime])
+			return top.when;
+
+		std::pop_heap(m.timerHeap.begin(), m.timerHeap.end(),
+				std::greater<_NSTimerEntry>());
+		m.timerHeap.pop_back();
+
+		if (![top.timer isValid])
+		{
+			m.timers.erase(top.timer);
+			continue;
+		}
+		if (top.when != [top.timer _fireTime])
+			continue;
+		[top.timer fire];
+	}
+	return UINT64_MAX;
 }
 
 - (void) addEventSource:(struct kevent *)source
 	target:(id<_NSRunLoopEventSource>)target
 	modes:(NSArray *)runModes
 {
-	struct timespec timeout{0, 0};
-
 	// The target is weakly held
 	source->udata = (__bridge void *)target;
 
 	for (NSString *mode in runModes)
 	{
-		struct kevent s = *source;
-		s.flags |= EV_ADD;
-		kevent(modes[mode].queue, &s, 1, NULL, 0, &timeout);
+		if (modes[mode].queue.add(*source) < 0)
+			@throw [NSInternalInconsistencyException
+				exceptionWithReason:[NSString stringWithFormat:
+					@"Unable to add run loop event source: %s", strerror(errno)]
+				userInfo:nil];
 	}
 }
 
 - (void) removeEventSource:(struct kevent *)source fromModes:(NSArray *)rlModes
 {
-	struct timespec timeout{0, 0};
-
 	for (id mode in rlModes)
 	{
 		auto i = modes.find(mode);
 		if (i != modes.end())
 		{
-			struct kevent s = *source;
-			s.flags |= EV_DELETE;
-			kevent(i->second.queue, &s, 1, NULL, 0, &timeout);
+			i->second.queue.remove(*source);
 		}
 	}
 }
@@ -214,7 +294,7 @@ struct _NSRunLoopMode {
 
 - (void) cancelPerformSelector:(SEL)sel target:(id)target argument:(id)arg
 {
-	for (auto mode : modes)
+	for (auto &mode : modes)
 	{
 		auto &m = mode.second.performers;
 		for (auto i = m.begin(); i != m.end();)
@@ -233,7 +313,7 @@ struct _NSRunLoopMode {
 
 - (void) cancelPerformSelectorsWithTarget:(id)target
 {
-	for (auto mode : modes)
+	for (auto &mode : modes)
 	{
 		auto &m = mode.second.performers;
 		for (auto i = m.begin(); i != m.end();)
@@ -255,39 +335,54 @@ struct _NSRunLoopMode {
 	struct kevent events[MAX_EVENTS];
 	currentMode = mode;
 
-	while ([limit earlierDate:[NSDate date]] != limit)
+	NSTimeInterval limitInterval = [limit timeIntervalSinceNow];
+	uint64_t start = monotonic_time();
+	uint64_t deadline;
+
+	/* A limit already passed still gets one pass, polling without blocking. */
+	if (limitInterval <= 0)
+		deadline = start;
+	else if (limitInterval >= (double)((UINT64_MAX - start) / NANOSECONDS))
+		deadline = UINT64_MAX;
+	else
+		deadline = start + (uint64_t)(limitInterval * NANOSECONDS);
+
+	uint64_t now = start;
+	do
 	{
-		NSDate *d = [limit earlierDate:[self limitDateForMode:mode]];
-		NSTimeInterval ti = [d timeIntervalSinceNow];
-		struct timespec ts{(time_t)ti,
-			static_cast<long>((ti - (long)ti) * NANOSECOND)};
-		int count = kevent(i->second.queue, NULL, 0, events, MAX_EVENTS, &ts);
+		uint64_t wake = std::min(deadline, fireTimers(i->second, now));
+
+		now = monotonic_time();
+		if (wake <= now && now < deadline)
+			continue;
+
+		uint64_t wait = (wake > now) ? wake - now : 0;
+		struct timespec ts{(time_t)(wait / NANOSECONDS),
+			(long)(wait % NANOSECONDS)};
+		int count = i->second.queue.wait(events, MAX_EVENTS, &ts);
 
 		if (count > 0)
 		{
-			for (; count > 0; --count)
+			struct timespec poll{0, 0};
+
+			/*
+			 * A full batch means more may be ready, so keep draining without
+			 * blocking before going back to the timers.
+			 */
+			do
 			{
-				struct kevent *ev = &events[count];
-				[(__bridge id<_NSRunLoopEventSource>)ev handleEvent:ev];
-			}
-			break;
-		}
-		__block NSMutableArray *a = nil;
-		[i->second.timers enumerateObjectsUsingBlock:
-			^(id obj, NSUInteger idx, bool *stop){
-				if (![obj isValid])
-				{
-					if (a == nil)
-						a = [NSMutableArray array];
-					[a addObject:obj];
-				}
-				if ([[NSDate date] compare:[obj fireDate]] != NSOrderedAscending)
+				for (int n = 0; n < count; n++)
 				{
-					[obj fire];
+					struct kevent *ev = &events[n];
+					[(__bridge id<_NSRunLoopEventSource>)ev->udata
+						handleEvent:ev];
 				}
-			}];
-		[i->second.timers removeObjectsInArray:a];
-	}
+			} while (count == MAX_EVENTS &&
+					(count = i->second.queue.wait(events, MAX_EVENTS,
+						&poll)) > 0);
+			break;
+		}
+	} while ((now = monotonic_time()) < deadline);
 	performMap map = i->second.performers;
 	i->second.performers.clear();
 
@@ -299,15 +394,18 @@ struct _NSRunLoopMode {
 
 - (NSDate *) limitDateForMode:(NSString *)mode
 {
-	__block NSDate *limitDate = [NSDate date];
-
-	[modes[mode].timers enumerateObjectsUsingBlock:^(id obj, NSUInteger idx,
-			bool *stop){
-		NSDate *itsLimit = [obj fireDate];
-		if ([limitDate compare:itsLimit] == NSOrderedDescending)
-			limitDate = itsLimit;
-	}];
-	return limitDate;
+	auto i = modes.find(mode);
+
+	if (i == modes.end())
+		return nil;
+
+	uint64_t now = monotonic_time();
+	uint64_t next = fireTimers(i->second, now);
+
+	if (next == UINT64_MAX)
+		return nil;
+	return [NSDate dateWithTimeIntervalSinceNow:
+		(NSTimeInterval)(next - std::min(next, monotonic_time())) / NANOSECONDS];
 }
 
 - (NSString *) currentMode
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Event sources describe themselves to NSRunLoop with a struct kevent, as on
+ * the BSDs.  Where there is no kqueue, a minimal copy of its vocabulary is
+ * provided here and the run loop translates it to the native facility.
+ */
+
+#ifndef NSRUNLOOPEVENT_H
+#define NSRUNLOOPEVENT_H
+
+#ifdef __linux__
+#include <stdint.h>
+#include <time.h>
+
+struct kevent
+{
+	uintptr_t	 ident;
+	short		 filter;
+	unsigned short	 flags;
+	unsigned int	 fflags;
+	intptr_t	 data;
+	void		*udata;
+};
+
+#define EV_SET(kevp_, a, b, c, d, e, f) do {	\
+	struct kevent *kevp = (kevp_);		\
+	(kevp)->ident = (a);			\
+	(kevp)->filter = (b);			\
+	(kevp)->flags = (c);			\
+	(kevp)->fflags = (d);			\
+	(kevp)->data = (e);			\
+	(kevp)->udata = (f);			\
+} while(0)
+
+#define EVFILT_READ	(-1)
+#define EVFILT_WRITE	(-2)
+#define EVFILT_VNODE	(-4)
+#define EVFILT_PROC	(-5)
+#define EVFILT_SIGNAL	(-6)
+#define EVFILT_TIMER	(-7)
+#define EVFILT_USER	(-11)
+
+#define EV_ADD		0x0001
+#define EV_DELETE	0x0002
+#define EV_ENABLE	0x0004
+#define EV_DISABLE	0x0008
+#define EV_ONESHOT	0x0010
+#define EV_CLEAR	0x0020
+#define EV_ERROR	0x4000
+#define EV_EOF		0x8000
+
+/* EVFILT_USER */
+#define NOTE_TRIGGER	0x01000000
+
+/* EVFILT_VNODE */
+#define NOTE_DELETE	0x0001
+#define NOTE_WRITE	0x0002
+#define NOTE_EXTEND	0x0004
+#define NOTE_ATTRIB	0x0008
+#define NOTE_LINK	0x0010
+#define NOTE_RENAME	0x0020
+#define NOTE_REVOKE	0x0040
+
+/* EVFILT_TIMER, default is milliseconds */
+#define NOTE_SECONDS	0x0001
+#define NOTE_MSECONDS	0x0002
+#define NOTE_USECONDS	0x0004
+#define NOTE_NSECONDS	0x0008
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#endif
+
+#ifdef __cplusplus
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <signal.h>
+#endif
+
+/*
+ * One event queue per run loop mode.  Sources are added and removed with the
+ * same struct kevent they were registered with, and wait() harvests up to
+ * 'max' ready events in one go.  add() and remove() return -1 and set errno
+ * if the source can't be registered.
+ */
+class _NSRunLoopEventQueue
+{
+	public:
+	_NSRunLoopEventQueue();
+	~_NSRunLoopEventQueue();
+	_NSRunLoopEventQueue(const _NSRunLoopEventQueue &) = delete;
+	_NSRunLoopEventQueue &operator=(const _NSRunLoopEventQueue &) = delete;
+
+	int add(const struct kevent &ev);
+	int remove(const struct kevent &ev);
+	int wait(struct kevent *events, int max, const struct timespec *timeout);
+
+	private:
+#ifdef __linux__
+	enum source_kind
+	{
+		FD_SOURCE,
+		TIMER_SOURCE,
+		USER_SOURCE,
+		SIGNAL_SOURCE,
+		VNODE_SOURCE,
+	};
+
+	/* What an epoll_event's data.ptr points to. */
+	struct source
+	{
+		source_kind kind;
+		int fd = -1;
+		bool reading = false;
+		bool writing = false;
+		/* epoll refuses regular files, which are always ready anyway. */
+		bool alwaysReady = false;
+		struct kevent read = {};	// EVFILT_READ, or the only filter
+		struct kevent write = {};	// EVFILT_WRITE
+	};
+
+	int epfd;
+	int createError;	// errno from epoll_create1(), if it failed
+	std::unordered_map<int, source> fds;
+	std::unordered_map<uintptr_t, source> timers;
+	std::unordered_map<uintptr_t, source> users;
+
+	source signalSource;
+	sigset_t signalMask;
+	std::unordered_map<int, struct kevent> signals;
+
+	source vnodeSource;
+	std::unordered_map<int, struct kevent> vnodes;	// inotify wd -> source
+	std::unordered_map<uintptr_t, int> vnodeWatches;	// fd -> inotify wd
+
+	std::deque<struct kevent> pending;
+	std::vector<struct epoll_event> ready;
+	/* Descriptors of always ready sources, reported on every wait. */
+	std::vector<int> readyFds;
+
+	int update_fd(source &s, bool existed);
+	void drop_source(std::unordered_map<uintptr_t, source> &table,
+			uintptr_t ident);
+	void fd_events(source &s, uint32_t revents, struct kevent *events,
+			int &count, int max);
+	void harvest_signals(struct kevent *events, int &count, int max);
+	void harvest_vnodes();
+#else
+	int kq;
+#endif
+};
+#endif
+
+#endif
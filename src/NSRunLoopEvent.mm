@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "NSRunLoopEvent.h"
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+
+/*
+ * Linux backend: epoll for descriptors, timerfd for EVFILT_TIMER, eventfd for
+ * EVFILT_USER, a single signalfd for EVFILT_SIGNAL and a single inotify
+ * instance for EVFILT_VNODE, all multiplexed on one epoll instance.
+ *
+ * signalfd only sees signals that are blocked, so registering a signal blocks
+ * it in the calling thread.  Other threads must block it too for delivery to
+ * be reliable.
+ */
+
+static uint32_t vnode_to_inotify(unsigned int fflags)
+{
+	uint32_t mask = 0;
+
+	if (fflags & NOTE_DELETE)
+		mask |= IN_DELETE_SELF;
+	if (fflags & (NOTE_WRITE | NOTE_EXTEND))
+		mask |= IN_MODIFY;
+	if (fflags & (NOTE_ATTRIB | NOTE_LINK))
+		mask |= IN_ATTRIB;
+	if (fflags & NOTE_RENAME)
+		mask |= IN_MOVE_SELF;
+	return mask;
+}
+
+static unsigned int inotify_to_vnode(uint32_t mask)
+{
+	unsigned int fflags = 0;
+
+	if (mask & IN_DELETE_SELF)
+		fflags |= NOTE_DELETE;
+	if (mask & IN_MODIFY)
+		fflags |= NOTE_WRITE | NOTE_EXTEND;
+	if (mask & IN_ATTRIB)
+		fflags |= NOTE_ATTRIB | NOTE_LINK;
+	if (mask & IN_MOVE_SELF)
+		fflags |= NOTE_RENAME;
+	if (mask & IN_UNMOUNT)
+		fflags |= NOTE_REVOKE;
+	return fflags;
+}
+
+static struct itimerspec timer_period(const struct kevent &ev)
+{
+	struct itimerspec its = {};
+	long long ns = ev.data;
+
+	if (ev.fflags & NOTE_SECONDS)
+		ns *= 1000000000LL;
+	else if (ev.fflags & NOTE_USECONDS)
+		ns *= 1000LL;
+	else if (!(ev.fflags & NOTE_NSECONDS))
+		ns *= 1000000LL;
+	// A zero it_value disarms the timer, so fire as soon as possible instead.
+	if (ns <= 0)
+		ns = 1;
+
+	its.it_value.tv_sec = ns / 1000000000LL;
+	its.it_value.tv_nsec = ns % 1000000000LL;
+	if (!(ev.flags & EV_ONESHOT))
+		its.it_interval = its.it_value;
+	return its;
+}
+
+_NSRunLoopEventQueue::_NSRunLoopEventQueue()
+{
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	// Kept for add() and wait() to report, since a constructor can't.
+	createError = (epfd < 0) ? errno : 0;
+	signalSource.kind = SIGNAL_SOURCE;
+	vnodeSource.kind = VNODE_SOURCE;
+	sigemptyset(&signalMask);
+}
+
+_NSRunLoopEventQueue::~_NSRunLoopEventQueue()
+{
+	for (auto &i : timers)
+		close(i.second.fd);
+	for (auto &i : users)
+		close(i.second.fd);
+	if (signalSource.fd >= 0)
+	{
+		pthread_sigmask(SIG_UNBLOCK, &signalMask, NULL);
+		close(signalSource.fd);
+	}
+	if (vnodeSource.fd >= 0)
+		close(vnodeSource.fd);
+	if (epfd >= 0)
+		close(epfd);
+}
+
+int _NSRunLoopEventQueue::update_fd(source &s, bool existed)
+{
+	struct epoll_event ev = {};
+	int fd = s.fd;
+
+	if (!s.reading && !s.writing)
+	{
+		if (s.alwaysReady)
+			readyFds.erase(std::find(readyFds.begin(), readyFds.end(), fd));
+		else
+			// Fails harmlessly if the descriptor was already closed.
+			epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+		fds.erase(fd);
+		return 0;
+	}
+	if (s.alwaysReady)
+		return 0;
+	if (s.reading)
+		ev.events |= EPOLLIN | EPOLLRDHUP;
+	if (s.writing)
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = &s;
+	if (epoll_ctl(epfd, existed ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) == 0)
+		return 0;
+	if (errno == EPERM && !existed)
+	{
+		s.alwaysReady = true;
+		readyFds.push_back(fd);
+		return 0;
+	}
+	return -1;
+}
+
+/* Translate readiness of a descriptor into its EVFILT_READ/WRITE events. */
+void _NSRunLoopEventQueue::fd_events(source &s, uint32_t revents,
+		struct kevent *events, int &count, int max)
+{
+	struct kevent rev = s.read;
+	struct kevent wev = s.write;
+	bool readable = s.reading &&
+		(revents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR));
+	bool writable = s.writing &&
+		(revents & (EPOLLOUT | EPOLLHUP | EPOLLERR));
+	int avail = 0;
+
+	if (readable)
+	{
+		ioctl(s.fd, FIONREAD, &avail);
+		// Like kqueue, a regular file is only readable short of its end.
+		if (s.alwaysReady && avail <= 0)
+			readable = false;
+	}
+	if (readable)
+	{
+		rev.data = avail;
+		if (revents & (EPOLLRDHUP | EPOLLHUP))
+			rev.flags |= EV_EOF;
+		events[count++] = rev;
+	}
+	if (writable)
+	{
+		if (revents & EPOLLHUP)
+			wev.flags |= EV_EOF;
+		if (count < max)
+			events[count++] = wev;
+		else
+			pending.push_back(wev);
+	}
+	// s may be gone after the first remove().
+	if (readable && (rev.flags & EV_ONESHOT))
+		remove(rev);
+	if (writable && (wev.flags & EV_ONESHOT))
+		remove(wev);
+}
+
+int _NSRunLoopEventQueue::add(const struct kevent &kev)
+{
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+
+	if (epfd < 0)
+	{
+		errno = createError;
+		return -1;
+	}
+	switch (kev.filter)
+	{
+		case EVFILT_READ:
+		case EVFILT_WRITE:
+		{
+			source &s = fds[(int)kev.ident];
+			bool existed = (s.reading || s.writing);
+			bool wasReading = s.reading;
+			bool wasWriting = s.writing;
+
+			s.kind = FD_SOURCE;
+			s.fd = (int)kev.ident;
+			if (kev.filter == EVFILT_READ)
+			{
+				s.reading = true;
+				s.read = kev;
+			}
+			else
+			{
+				s.writing = true;
+				s.write = kev;
+			}
+			if (update_fd(s, existed) < 0)
+			{
+				int err = errno;
+
+				s.reading = wasReading;
+				s.writing = wasWriting;
+				if (!existed)
+					fds.erase((int)kev.ident);
+				errno = err;
+				return -1;
+			}
+			break;
+		}
+		case EVFILT_TIMER:
+		{
+			source &s = timers[kev.ident];
+			bool created = (s.fd < 0);
+
+			if (created)
+			{
+				s.kind = TIMER_SOURCE;
+				s.fd = timerfd_create(CLOCK_MONOTONIC,
+						TFD_NONBLOCK | TFD_CLOEXEC);
+				ev.data.ptr = &s;
+				if (s.fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, s.fd, &ev) < 0)
+				{
+					drop_source(timers, kev.ident);
+					return -1;
+				}
+			}
+			struct itimerspec its = timer_period(kev);
+			if (timerfd_settime(s.fd, 0, &its, NULL) < 0)
+			{
+				if (created)
+					drop_source(timers, kev.ident);
+				return -1;
+			}
+			s.read = kev;
+			break;
+		}
+		case EVFILT_USER:
+		{
+			source &s = users[kev.ident];
+
+			if (s.fd < 0)
+			{
+				s.kind = USER_SOURCE;
+				s.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				ev.data.ptr = &s;
+				if (s.fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, s.fd, &ev) < 0)
+				{
+					drop_source(users, kev.ident);
+					return -1;
+				}
+			}
+			s.read = kev;
+			if (kev.fflags & NOTE_TRIGGER)
+			{
+				uint64_t one = 1;
+				write(s.fd, &one, sizeof(one));
+			}
+			break;
+		}
+		case EVFILT_SIGNAL:
+		{
+			sigset_t sig;
+
+			sigemptyset(&sig);
+			sigaddset(&sig, (int)kev.ident);
+			sigaddset(&signalMask, (int)kev.ident);
+			pthread_sigmask(SIG_BLOCK, &sig, NULL);
+			signals[(int)kev.ident] = kev;
+			if (signalSource.fd < 0)
+			{
+				signalSource.fd = signalfd(-1, &signalMask,
+						SFD_NONBLOCK | SFD_CLOEXEC);
+				ev.data.ptr = &signalSource;
+				if (signalSource.fd < 0 ||
+						epoll_ctl(epfd, EPOLL_CTL_ADD, signalSource.fd, &ev) < 0)
+				{
+					int err = errno;
+
+					if (signalSource.fd >= 0)
+						close(signalSource.fd);
+					signalSource.fd = -1;
+					errno = err;
+					return -1;
+				}
+			}
+			else if (signalfd(signalSource.fd, &signalMask, 0) < 0)
+				return -1;
+			break;
+		}
+		case EVFILT_VNODE:
+		{
+			char fdpath[32];
+			char path[PATH_MAX];
+			ssize_t len;
+			int wd;
+
+			// inotify watches paths, not descriptors.
+			snprintf(fdpath, sizeof(fdpath), "/proc/self/fd/%d",
+					(int)kev.ident);
+			if ((len = readlink(fdpath, path, sizeof(path) - 1)) < 0)
+				return -1;
+			path[len] = '\0';
+
+			if (vnodeSource.fd < 0)
+			{
+				vnodeSource.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+				ev.data.ptr = &vnodeSource;
+				if (vnodeSource.fd < 0 ||
+						epoll_ctl(epfd, EPOLL_CTL_ADD, vnodeSource.fd, &ev) < 0)
+				{
+					int err = errno;
+
+					if (vnodeSource.fd >= 0)
+						close(vnodeSource.fd);
+					vnodeSource.fd = -1;
+					errno = err;
+					return -1;
+				}
+			}
+			wd = inotify_add_watch(vnodeSource.fd, path,
+					vnode_to_inotify(kev.fflags));
+			if (wd < 0)
+				return -1;
+			vnodes[wd] = kev;
+			vnodeWatches[kev.ident] = wd;
+			break;
+		}
+	}
+	return 0;
+}
+
+void _NSRunLoopEventQueue::drop_source(
+		std::unordered_map<uintptr_t, source> &table, uintptr_t ident)
+{
+	int err = errno;
+	auto i = table.find(ident);
+
+	if (i->second.fd >= 0)
+		close(i->second.fd);
+	table.erase(i);
+	errno = err;
+}
+
+int _NSRunLoopEventQueue::remove(const struct kevent &kev)
+{
+	/*
+	 * As with EV_DELETE, drop anything queued for the source; its target may
+	 * be gone once it's removed.
+	 */
+	pending.erase(std::remove_if(pending.begin(), pending.end(),
+				[&](const struct kevent &p) {
+					return p.ident == kev.ident && p.filter == kev.filter;
+				}), pending.end());
+	switch (kev.filter)
+	{
+		case EVFILT_READ:
+		case EVFILT_WRITE:
+		{
+			auto i = fds.find((int)kev.ident);
+
+			if (i == fds.end())
+				break;
+			if (kev.filter == EVFILT_READ)
+				i->second.reading = false;
+			else
+				i->second.writing = false;
+			update_fd(i->second, true);
+			break;
+		}
+		case EVFILT_TIMER:
+		case EVFILT_USER:
+		{
+			auto &table = (kev.filter == EVFILT_TIMER) ? timers : users;
+			auto i = table.find(kev.ident);
+
+			if (i == table.end())
+				break;
+			epoll_ctl(epfd, EPOLL_CTL_DEL, i->second.fd, NULL);
+			close(i->second.fd);
+			table.erase(i);
+			break;
+		}
+		case EVFILT_SIGNAL:
+		{
+			sigset_t sig;
+
+			if (signals.erase((int)kev.ident) == 0)
+				break;
+			sigemptyset(&sig);
+			sigaddset(&sig, (int)kev.ident);
+			sigdelset(&signalMask, (int)kev.ident);
+			signalfd(signalSource.fd, &signalMask, 0);
+			pthread_sigmask(SIG_UNBLOCK, &sig, NULL);
+			break;
+		}
+		case EVFILT_VNODE:
+		{
+			auto i = vnodeWatches.find(kev.ident);
+
+			if (i == vnodeWatches.end())
+				break;
+			inotify_rm_watch(vnodeSource.fd, i->second);
+			vnodes.erase(i->second);
+			vnodeWatches.erase(i);
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Signals are read one per free slot; anything left stays queued in the
+ * signalfd and is picked up on the next wait.
+ */
+void _NSRunLoopEventQueue::harvest_signals(struct kevent *events, int &count,
+		int max)
+{
+	struct signalfd_siginfo info;
+
+	while (count < max &&
+			read(signalSource.fd, &info, sizeof(info)) == sizeof(info))
+	{
+		auto i = signals.find((int)info.ssi_signo);
+
+		if (i == signals.end())
+			continue;
+		events[count] = i->second;
+		events[count].data = 1;
+		count++;
+	}
+}
+
+/*
+ * inotify records must be read whole, so they go to the pending queue and are
+ * handed out from there.
+ */
+void _NSRunLoopEventQueue::harvest_vnodes()
+{
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	while ((len = read(vnodeSource.fd, buf, sizeof(buf))) > 0)
+	{
+		for (char *p = buf; p < buf + len;)
+		{
+			struct inotify_event *iev = (struct inotify_event *)p;
+			auto i = vnodes.find(iev->wd);
+
+			p += sizeof(struct inotify_event) + iev->len;
+			if (i == vnodes.end())
+				continue;
+
+			struct kevent kev = i->second;
+			kev.fflags &= inotify_to_vnode(iev->mask);
+			if (kev.fflags != 0)
+				pending.push_back(kev);
+			if (iev->mask & IN_IGNORED)
+			{
+				// The watch is gone (file deleted or unmounted).
+				vnodeWatches.erase(i->second.ident);
+				vnodes.erase(i);
+			}
+		}
+	}
+}
+
+int _NSRunLoopEventQueue::wait(struct kevent *events, int max,
+		const struct timespec *timeout)
+{
+	int count = 0;
+	int ms = -1;
+	int n;
+
+	if (epfd < 0)
+	{
+		errno = createError;
+		return -1;
+	}
+	while (count < max && !pending.empty())
+	{
+		events[count++] = pending.front();
+		pending.pop_front();
+	}
+
+	// Copied, since a oneshot source takes itself off the list.
+	std::vector<int> always(readyFds);
+	for (int fd : always)
+	{
+		auto i = fds.find(fd);
+
+		if (count >= max)
+			break;
+		if (i != fds.end())
+			fd_events(i->second, EPOLLIN | EPOLLOUT, events, count, max);
+	}
+
+	if (count > 0)
+	{
+		ms = 0;
+	}
+	else if (timeout != NULL)
+	{
+		long long total = (long long)timeout->tv_sec * 1000 +
+			(timeout->tv_nsec + 999999) / 1000000;
+		ms = (int)std::max(0LL, std::min(total, (long long)INT_MAX));
+	}
+
+	if ((int)ready.size() < max)
+		ready.resize(max);
+
+	n = epoll_wait(epfd, ready.data(), max - count, ms);
+	if (n < 0)
+		return (count > 0) ? count : (errno == EINTR ? 0 : -1);
+
+	for (int j = 0; j < n && count < max; j++)
+	{
+		source *s = (source *)ready[j].data.ptr;
+		uint32_t revents = ready[j].events;
+
+		switch (s->kind)
+		{
+			case FD_SOURCE:
+				fd_events(*s, revents, events, count, max);
+				break;
+			case TIMER_SOURCE:
+			case USER_SOURCE:
+			{
+				uint64_t value;
+				struct kevent kev = s->read;
+
+				if (read(s->fd, &value, sizeof(value)) != sizeof(value))
+					break;
+				kev.data = (s->kind == TIMER_SOURCE) ? (intptr_t)value : 0;
+				events[count++] = kev;
+				if (kev.flags & EV_ONESHOT)
+					remove(kev);
+				break;
+			}
+			case SIGNAL_SOURCE:
+				harvest_signals(events, count, max);
+				break;
+			case VNODE_SOURCE:
+				harvest_vnodes();
+				while (count < max && !pending.empty())
+				{
+					events[count++] = pending.front();
+					pending.pop_front();
+				}
+				break;
+		}
+	}
+	return count;
+}
+
+#else
+
+/* kqueue backend. */
+
+_NSRunLoopEventQueue::_NSRunLoopEventQueue()
+{
+	kq = kqueue();
+}
+
+_NSRunLoopEventQueue::~_NSRunLoopEventQueue()
+{
+	close(kq);
+}
+
+int _NSRunLoopEventQueue::add(const struct kevent &ev)
+{
+	struct timespec timeout{0, 0};
+	struct kevent s = ev;
+
+	s.flags |= EV_ADD;
+	return (kevent(kq, &s, 1, NULL, 0, &timeout) < 0) ? -1 : 0;
+}
+
+int _NSRunLoopEventQueue::remove(const struct kevent &ev)
+{
+	struct timespec timeout{0, 0};
+	struct kevent s = ev;
+
+	s.flags |= EV_DELETE;
+	return (kevent(kq, &s, 1, NULL, 0, &timeout) < 0) ? -1 : 0;
+}
+
+int _NSRunLoopEventQueue::wait(struct kevent *events, int max,
+		const struct timespec *timeout)
+{
+	return kevent(kq, NULL, 0, events, max, timeout);
+}
+
+#endif
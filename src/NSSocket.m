@@ -29,7 +29,6 @@
  */
 
 #include <sys/types.h>
-#include <sys/event.h>
 #include <sys/socket.h>
 
 #include <netinet/in.h>
@@ -48,6 +47,7 @@
 #import <Foundation/NSHost.h>
 #import <Foundation/NSString.h>
 #import "internal.h"
+#include "NSRunLoopEvent.h"
 
 @interface NSSocket() <_NSRunLoopEventSource>
 @end
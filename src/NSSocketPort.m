@@ -32,7 +32,6 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
-#include <sys/event.h>
 #include <sys/un.h>
 
 #include <string.h>
@@ -44,6 +43,7 @@
 #import <Foundation/NSData.h>
 
 #import "internal.h"
+#include "NSRunLoopEvent.h"
 
 static bool _NSPrivateSetupSockaddr(NSData *addr, struct sockaddr_storage *sas)
 {
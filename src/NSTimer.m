@@ -90,16 +90,26 @@
     userInfo:(id)anObject repeat:(bool)_repeats;
 @end
 
+/* Converts a relative interval to a deadline on the monotonic clock. */
+static uint64_t fireTimeAfterInterval(NSTimeInterval ti)
+{
+	if (ti <= 0)
+		return monotonic_time();
+	if (ti >= (double)(UINT64_MAX / NANOSECONDS))
+		return UINT64_MAX;
+	return monotonic_time() + (uint64_t)(ti * NANOSECONDS);
+}
+
 @implementation NSTimer
 {
-	NSDate *fireDate;
+	uint64_t fireTime;
 	NSInvocation *invocation;
 	id userInfo;
 	NSTimeInterval timeInterval;
 	bool repeats;
 	bool isValid;
 	bool running;
-	NSRunLoop *runLoop;
+	__weak NSRunLoop *runLoop;
 }
 
 + (NSTimer*)scheduledTimerWithTimeInterval:(NSTimeInterval)seconds
@@ -161,14 +171,15 @@
 		[anInvocation setArgument:&self atIndex:2];
 	}
 	self = [self initWith:seconds invocation:anInvocation userInfo:arg repeat:repeat];
-	
-	fireDate = date;
+
+	if (date != nil)
+		fireTime = fireTimeAfterInterval([date timeIntervalSinceNow]);
 	return self;
 }
 
 - (void)dealloc
 {
-	[self invalidate];
+	isValid = false;
 }
 
 - (NSString*)description
@@ -176,7 +187,7 @@
 	return [NSString stringWithFormat:@"<%@ %p fireDate: %@ selector: %@ repeats: %s isValid: %s>",
 			[self className],
 			self,
-			fireDate,
+			[self fireDate],
 			NSStringFromSelector([invocation selector]),
 			repeats ? "true" : "false",
 			isValid ? "true" : "false"];
@@ -193,21 +204,40 @@
 		}
 		else
 		{
-			fireDate = [NSDate dateWithTimeIntervalSinceNow:timeInterval];
+			uint64_t now = monotonic_time();
+			uint64_t interval = (uint64_t)(timeInterval * NANOSECONDS);
+
+			// Stay on the original schedule, but skip any missed firings.
+			fireTime += interval;
+			if (fireTime <= now)
+				fireTime = now + interval;
+			[runLoop _timerDidReschedule:self];
 		}
 	}
 }
 
 - (NSDate*)fireDate
 {
-	return fireDate;
+	int64_t delta = (int64_t)(fireTime - monotonic_time());
+
+	return [NSDate dateWithTimeIntervalSinceNow:
+		(NSTimeInterval)delta / NANOSECONDS];
 }
 
 - (void) setFireDate:(NSDate *)newFireDate
 {
-	if ([newFireDate earlierDate:[NSDate date]] == newFireDate)
-		newFireDate = [NSDate date];
-	fireDate = newFireDate;
+	fireTime = fireTimeAfterInterval([newFireDate timeIntervalSinceNow]);
+	[runLoop _timerDidReschedule:self];
+}
+
+- (uint64_t) _fireTime
+{
+	return fireTime;
+}
+
+- (void) _setRunLoop:(NSRunLoop *)loop
+{
+	runLoop = loop;
 }
 
 - (NSTimeInterval) timeInterval
@@ -221,6 +251,7 @@
 	{
 		isValid = false;
 		running = false;
+		[runLoop _removeTimer:self];
 	}
 }
 
@@ -230,15 +261,12 @@
 
 - (void)setRunning:(bool)run
 {
-	running = run;
-	if (!running)
-	{
-		fireDate = nil;
-	}
-	else if (fireDate == nil)
+	if (run && !running)
 	{
-		fireDate = [[NSDate alloc] initWithTimeIntervalSinceNow:timeInterval];
+		fireTime = fireTimeAfterInterval(timeInterval);
+		[runLoop _timerDidReschedule:self];
 	}
+	running = run;
 }
 
 @end
@@ -251,7 +279,11 @@
 - (id) initWith:(NSTimeInterval)seconds invocation:(NSInvocation*)anInvocation
     userInfo:(id)anObject repeat:(bool)_repeats
 {
+	// A non-positive interval would make a repeating timer spin the loop.
+	if (seconds <= 0)
+		seconds = 0.0001;
 	timeInterval = seconds;
+	fireTime = fireTimeAfterInterval(seconds);
 	invocation = anInvocation;
 	userInfo = anObject;
 	repeats = _repeats;
@@ -86,6 +86,11 @@ enum {
 - (id)initWithCharacters:(const NSUniChar*)chars length:(NSUInteger)length;
 - (id)initWithCharactersNoCopy:(const NSUniChar*)chars length:(NSUInteger)length 
 	freeWhenDone:(bool)flag;
+- (id)initWithCharactersNoCopy:(NSUniChar*)chars length:(NSUInteger)length
+	deallocator:(void (^)(NSUniChar *, NSUInteger))deallocator;
+- (id)initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)encoding
+	deallocator:(void (^)(void *, NSUInteger))deallocator;
 - (id)initWithString:(NSString*)aString;
 - (id)initWithFormat:(NSString*)format, ...;
 - (id)initWithFormat:(NSString*)format arguments:(va_list)argList;
@@ -135,6 +140,18 @@ enum {
 
 @interface NSString(Private)
 + (NSStringEncoding) stringEncodingFromName:(NSString *)name;
+/*
+ * Direct access to the receiver's UTF-16 or 8-bit (Latin-1) storage, for
+ * strings that keep their contents in one of those forms.  Both return NULL
+ * by default.  The pointers are only valid until the string is mutated.
+ */
+- (const NSUniChar *) _fastCharacterContents;
+- (const unsigned char *) _fastLatin1Contents;
+/*
+ * Returns a malloc()ed, NUL terminated UTF-8 copy of the receiver, storing
+ * its length in bytes in *length if that's not NULL.
+ */
+- (char *) _createUTF8String:(NSUInteger *)length;
 @end
 /*
    vim:syntax=objc:
@@ -31,7 +31,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #import <Foundation/NSString.h>
 #import "NSCoreString.h"
@@ -44,6 +48,57 @@
 #import <Foundation/NSLocale.h>
 
 #include "unicode/ucnv.h"
+#import "NSStringConverter.h"
+
+/*
+ * Strings whose characters all fit in Latin-1 are stored compactly, one byte
+ * per character, with a terminating NUL so that ASCII contents can be handed
+ * out as a C string directly.  Everything else is kept in a UnicodeString.
+ */
+
+/* Returns true if all len bytes are 7-bit ASCII. */
+static bool isASCII(const unsigned char *s, NSUInteger len)
+{
+	NSUInteger i = 0;
+
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		if (_mm_movemask_epi8(v) != 0)
+			return false;
+	}
+#endif
+	for (; i < len; i++)
+	{
+		if (s[i] & 0x80)
+			return false;
+	}
+	return true;
+}
+
+/* Returns true if all len UTF-16 units are Latin-1 characters. */
+static bool isLatin1(const UChar *s, NSUInteger len)
+{
+	NSUInteger i = 0;
+
+#ifdef __SSE2__
+	const __m128i high = _mm_set1_epi16((short)0xff00);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= len; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero)) != 0xffff)
+			return false;
+	}
+#endif
+	for (; i < len; i++)
+	{
+		if (s[i] > 0xff)
+			return false;
+	}
+	return true;
+}
 
 @implementation NSSimpleCString
 @end
@@ -64,7 +119,7 @@
 {
 	if (index < length)
 	{
-		return bytes[index];
+		return (unsigned char)bytes[index];
 	}
 	return 0;
 }
@@ -85,6 +140,11 @@
 {
 	return (char *)bytes;
 }
+
+- (const unsigned char *)_fastLatin1Contents
+{
+	return (const unsigned char *)bytes;
+}
 @end /* NXConstantString */
 
 @implementation NSCoreString
@@ -93,6 +153,168 @@
 	UnicodeString str;
 	bool freeWhenDone;
 	NSStringEncoding encoding;
+	/* Compact contents, or NULL if the string is stored in str. */
+	unsigned char *latin1;
+	NSUInteger latin1Length;
+	NSUInteger latin1Capacity;
+	bool asciiOnly;
+	/* Cached UTF-8 form of non-ASCII contents. */
+	char *utf8;
+	/* Cached UTF-16 form of compact contents, for -_unicodeString. */
+	UnicodeString *wide;
+	/* Caller's buffer kept by a NoCopy initializer, released in -dealloc. */
+	void *adopted;
+	NSUInteger adoptedLength;
+	void (^deallocator)(void *, NSUInteger);
+}
+
+- (void) _setLatin1:(const unsigned char *)bytes length:(NSUInteger)length
+	ascii:(bool)ascii
+{
+	latin1 = (unsigned char *)malloc(length + 1);
+	if (latin1 == NULL)
+	{
+		@throw [NSMemoryException
+			exceptionWithReason:@"Out of Memory creating string." userInfo:nil];
+	}
+	memcpy(latin1, bytes, length);
+	latin1[length] = 0;
+	latin1Length = latin1Capacity = length;
+	asciiOnly = ascii;
+	encoding = ascii ? NSASCIIStringEncoding : NSISOLatin1StringEncoding;
+}
+
+- (void) _setCharacters:(const UChar *)chars length:(NSUInteger)length
+{
+	if (!isLatin1(chars, length))
+	{
+		str = UnicodeString(chars, length);
+		encoding = NSUnicodeStringEncoding;
+		return;
+	}
+	latin1 = (unsigned char *)malloc(length + 1);
+	if (latin1 == NULL)
+	{
+		@throw [NSMemoryException
+			exceptionWithReason:@"Out of Memory creating string." userInfo:nil];
+	}
+	for (NSUInteger i = 0; i < length; i++)
+	{
+		latin1[i] = chars[i];
+	}
+	latin1[length] = 0;
+	latin1Length = latin1Capacity = length;
+	asciiOnly = isASCII(latin1, length);
+	encoding = asciiOnly ? NSASCIIStringEncoding : NSISOLatin1StringEncoding;
+}
+
+- (void) _setUnicodeString:(const UnicodeString &)src
+{
+	if (isLatin1(src.getBuffer(), src.length()))
+	{
+		[self _setCharacters:src.getBuffer() length:src.length()];
+	}
+	else
+	{
+		str = src;
+		encoding = NSUnicodeStringEncoding;
+	}
+}
+
+/* Decode bytes in an encoding we don't handle ourselves, through ICU. */
+- (bool) _setBytes:(const unsigned char *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)enc
+{
+	UConverter *conv = _NSBorrowConverter(enc);
+	UErrorCode err = U_ZERO_ERROR;
+	int32_t n;
+
+	if (conv == NULL)
+		return false;
+
+	/* One unit per byte covers nearly every converter; retry if not. */
+	std::vector<UChar> units(length + 1);
+	n = ucnv_toUChars(conv, units.data(), units.size(),
+			(const char *)bytes, length, &err);
+	if (err == U_BUFFER_OVERFLOW_ERROR)
+	{
+		err = U_ZERO_ERROR;
+		units.resize(n + 1);
+		ucnv_reset(conv);
+		n = ucnv_toUChars(conv, units.data(), units.size(),
+				(const char *)bytes, length, &err);
+	}
+	_NSReturnConverter(enc, conv);
+	if (U_FAILURE(err))
+		return false;
+	[self _setCharacters:units.data() length:n];
+	return true;
+}
+
+/*
+ * Use the caller's buffer as our contents if it's already in a form we store:
+ * Latin-1 and ASCII (including ASCII-only UTF-8) as the compact form, and
+ * host order UTF-16 as a read-only alias in str.  The compact form isn't NUL
+ * terminated in this case.
+ */
+- (bool) _adoptBytes:(const unsigned char *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)enc
+{
+	if (bytes == NULL)
+		return false;
+
+	switch (enc)
+	{
+		case NSISOLatin1StringEncoding:
+			asciiOnly = isASCII(bytes, length);
+			break;
+		case NSASCIIStringEncoding:
+		case NSUTF8StringEncoding:
+			if (!isASCII(bytes, length))
+				return false;
+			asciiOnly = true;
+			break;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		case NSUTF16LittleEndianStringEncoding:
+#else
+		case NSUTF16BigEndianStringEncoding:
+#endif
+			if ((length % sizeof(UChar)) != 0 ||
+					((uintptr_t)bytes % alignof(UChar)) != 0)
+				return false;
+			return [self _adoptCharacters:(const UChar *)bytes
+				length:length / sizeof(UChar)];
+		default:
+			return false;
+	}
+	latin1 = (unsigned char *)bytes;
+	latin1Length = latin1Capacity = length;
+	encoding = asciiOnly ? NSASCIIStringEncoding : NSISOLatin1StringEncoding;
+	return true;
+}
+
+- (bool) _adoptCharacters:(const UChar *)chars length:(NSUInteger)length
+{
+	if (chars == NULL || length > INT32_MAX)
+		return false;
+	str.setTo(false, chars, (int32_t)length);
+	encoding = NSUnicodeStringEncoding;
+	return true;
+}
+
+/* Give a NoCopy buffer back to its owner. */
+- (void) _releaseBytes:(void *)bytes length:(NSUInteger)length
+	freeWhenDone:(bool)flag
+{
+	if (deallocator != nil)
+	{
+		deallocator(bytes, length);
+		deallocator = nil;
+	}
+	else if (flag)
+	{
+		free(bytes);
+	}
 }
 
 - (id) init
@@ -100,6 +322,17 @@
 	return [self initWithCString:NULL length:0];
 }
 
+- (void) dealloc
+{
+	if (latin1 != adopted)
+		free(latin1);
+	free(utf8);
+	delete wide;
+	if (adopted != NULL)
+		[self _releaseBytes:adopted length:adoptedLength
+			freeWhenDone:freeWhenDone];
+}
+
 - (id) initWithBytes:(const void *)bytes length:(NSUInteger)length
 	encoding:(NSStringEncoding)enc
 {
@@ -114,36 +347,104 @@
 		freeWhenDone:flag];
 }
 
+- (id) initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)enc
+	deallocator:(void (^)(void *, NSUInteger))block
+{
+	deallocator = block;
+	return [self initWithBytes:bytes length:length encoding:enc copy:false
+		freeWhenDone:false];
+}
+
 - (id) initWithBytes:(const void *)bytes length:(NSUInteger)length
 	encoding:(NSStringEncoding)enc copy:(bool)copy freeWhenDone:(bool)flag
 {
-	encoding = NSUnicodeStringEncoding;
-	try
+	const unsigned char *chars = (const unsigned char *)bytes;
+	bool converted = true;
+
+	if (chars == NULL)
+		length = 0;
+	else if (length == (NSUInteger)-1)
+		length = strlen((const char *)chars);
+
+	if (!copy && [self _adoptBytes:chars length:length encoding:enc])
 	{
-		str = UnicodeString((const char *)bytes, length, [[NSString
-				localizedNameOfStringEncoding:enc] UTF8String]);
+		adopted = (void *)bytes;
+		adoptedLength = length;
+		freeWhenDone = flag;
+		return self;
 	}
-	catch (...)
+
+	switch (enc)
 	{
-		/* Trap all exceptions, and return nil if string can't be created. */
-		self = nil;
+		case NSISOLatin1StringEncoding:
+			[self _setLatin1:chars length:length ascii:isASCII(chars, length)];
+			break;
+		case NSASCIIStringEncoding:
+		case NSUTF8StringEncoding:
+			if (isASCII(chars, length))
+			{
+				[self _setLatin1:chars length:length ascii:true];
+				break;
+			}
+			if (enc == NSUTF8StringEncoding)
+			{
+				[self _setUnicodeString:UnicodeString::fromUTF8(
+					icu::StringPiece((const char *)chars, length))];
+				break;
+			}
+			/* FALLTHROUGH */
+		default:
+			converted = [self _setBytes:chars length:length encoding:enc];
+			break;
+		case NSUTF16BigEndianStringEncoding:
+		case NSUTF16LittleEndianStringEncoding:
+		{
+			std::vector<UChar> units((length + 1) / 2);
+			NSUInteger n = _NSDecodeUTF16(chars, length,
+					enc == NSUTF16BigEndianStringEncoding,
+					(NSUniChar *)units.data());
+			[self _setCharacters:units.data() length:n];
+			break;
+		}
 	}
-	if (flag)
-		free((void *)bytes);
-	return self;
+	if (!copy)
+		[self _releaseBytes:(void *)bytes length:length freeWhenDone:flag];
+	return converted ? self : nil;
 }
 
 - (id) initWithCharacters:(const NSUniChar*)chars length:(NSUInteger)length
 {
-	return [self initWithBytes:(const void *)chars length:length * sizeof(NSUniChar)
-		encoding:NSUnicodeStringEncoding copy:true freeWhenDone:false];
+	[self _setCharacters:(const UChar *)chars length:length];
+	return self;
 }
 
 - (id) initWithCharactersNoCopy:(const NSUniChar*)chars length:(NSUInteger)length
 	freeWhenDone:(bool)flag
 {
-	return [self initWithBytes:(const void *)chars length:length * sizeof(NSUniChar)
-		encoding:NSUnicodeStringEncoding copy:false freeWhenDone:flag];
+	if ([self _adoptCharacters:(const UChar *)chars length:length])
+	{
+		adopted = (void *)chars;
+		adoptedLength = length;
+		freeWhenDone = flag;
+		return self;
+	}
+	[self _setCharacters:(const UChar *)chars length:length];
+	[self _releaseBytes:(void *)chars length:length freeWhenDone:flag];
+	return self;
+}
+
+- (id) initWithCharactersNoCopy:(NSUniChar *)chars length:(NSUInteger)length
+	deallocator:(void (^)(NSUniChar *, NSUInteger))block
+{
+	if (block != nil)
+	{
+		deallocator = ^(void *buffer, NSUInteger count) {
+			block((NSUniChar *)buffer, count);
+		};
+	}
+	return [self initWithCharactersNoCopy:chars length:length
+		freeWhenDone:false];
 }
 
 - (id) initWithCString:(const char*)byteString
@@ -180,17 +481,25 @@
 
 - (id) initWithString:(NSString*)aString
 {
+	const unsigned char *compact = [aString _fastLatin1Contents];
 	size_t length = [aString length];
+
+	if (compact != NULL)
+	{
+		[self _setLatin1:compact length:length ascii:isASCII(compact, length)];
+		return self;
+	}
+
 	std::vector<unichar> chars(length);
 
-	[aString getCharacters:&chars[0] range:NSRange(0, length)];
-	self = [self initWithCharacters:&chars[0] length:length];
+	[aString getCharacters:chars.data() range:NSRange(0, length)];
+	self = [self initWithCharacters:chars.data() length:length];
 	return self;
 }
 
 - (id) initWithUnicodeString:(UnicodeString *)src
 {
-	str = *src;
+	[self _setUnicodeString:*src];
 	return self;
 }
 
@@ -206,22 +515,133 @@
 
 - (NSUniChar)characterAtIndex:(NSUInteger)index
 {
+	if (latin1 != NULL)
+		return (index < latin1Length) ? latin1[index] : 0xffff;
 	return str.charAt(index);
 }
 
 - (void)getCharacters:(NSUniChar*)buffer range:(NSRange)aRange
 {
+	if (latin1 != NULL)
+	{
+		const unsigned char *src = latin1 + aRange.location;
+
+		for (NSUInteger i = 0; i < aRange.length; i++)
+		{
+			buffer[i] = src[i];
+		}
+		return;
+	}
 	str.extract(aRange.location, aRange.length, (UChar *)buffer);
 }
 
 - (NSUInteger) length
 {
+	if (latin1 != NULL)
+		return latin1Length;
 	return str.length();
 }
 
+/*
+ * ASCII contents are already valid UTF-8.  Anything else is converted once
+ * and kept for the life of the (immutable) string.
+ */
+- (const char *)UTF8String
+{
+	if (latin1 != NULL && asciiOnly && latin1 != adopted)
+		return (const char *)latin1;
+
+	char *cached = __atomic_load_n(&utf8, __ATOMIC_ACQUIRE);
+	if (cached == NULL)
+	{
+		char *converted = [self _createUTF8String:NULL];
+
+		if (converted == NULL)
+			return NULL;
+		if (__atomic_compare_exchange_n(&utf8, &cached, converted, false,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			cached = converted;
+		else
+			free(converted);
+	}
+	return cached;
+}
+
+- (const char *)cStringUsingEncoding:(NSStringEncoding)enc
+{
+	/* Adopted compact contents aren't NUL terminated. */
+	if (latin1 != NULL && latin1 != adopted)
+	{
+		switch (enc)
+		{
+			case NSISOLatin1StringEncoding:
+				return (const char *)latin1;
+			case NSASCIIStringEncoding:
+				if (asciiOnly)
+					return (const char *)latin1;
+				break;
+			case NSUTF8StringEncoding:
+				return [self UTF8String];
+			default:
+				break;
+		}
+	}
+	return [super cStringUsingEncoding:enc];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	return self;
+}
+
+/* Immutable, so the hash is computed once. */
+- (NSHashCode)hash
+{
+	if (hash == 0)
+		hash = [super hash];
+	return hash;
+}
+
+/*
+ * Callers only ever read through the returned string.  Compact strings are
+ * expanded into a separate copy, published like the UTF-8 one, since an
+ * immutable string may be used from several threads at once.
+ */
 - (UnicodeString &)_unicodeString
 {
-	return str;
+	if (latin1 == NULL)
+		return str;
+
+	UnicodeString *cached = __atomic_load_n(&wide, __ATOMIC_ACQUIRE);
+	if (cached == NULL)
+	{
+		UnicodeString *expanded = new UnicodeString();
+		UChar *buf = expanded->getBuffer(latin1Length);
+
+		for (NSUInteger i = 0; i < latin1Length; i++)
+		{
+			buf[i] = latin1[i];
+		}
+		expanded->releaseBuffer(latin1Length);
+		if (__atomic_compare_exchange_n(&wide, &cached, expanded, false,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			cached = expanded;
+		else
+			delete expanded;
+	}
+	return *cached;
+}
+
+- (const NSUniChar *)_fastCharacterContents
+{
+	if (latin1 != NULL)
+		return NULL;
+	return (const NSUniChar *)const_cast<const UnicodeString &>(str).getBuffer();
+}
+
+- (const unsigned char *)_fastLatin1Contents
+{
+	return latin1;
 }
 
 @end // NSCoreString
@@ -232,6 +652,15 @@
 	UnicodeString str;
 	bool freeWhenDone;
 	NSStringEncoding encoding;
+	unsigned char *latin1;
+	NSUInteger latin1Length;
+	NSUInteger latin1Capacity;
+	bool asciiOnly;
+	char *utf8;
+	UnicodeString *wide;
+	void *adopted;
+	NSUInteger adoptedLength;
+	void (^deallocator)(void *, NSUInteger);
 }
 
 + (void) initialize
@@ -242,19 +671,136 @@
 	}
 }
 
+- (id)copyWithZone:(NSZone *)zone
+{
+	return [[NSString allocWithZone:zone] initWithString:self];
+}
+
+/* Mutable strings own their contents, so the NoCopy initializers copy. */
+- (bool) _adoptBytes:(const unsigned char *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)enc
+{
+	return false;
+}
+
+- (bool) _adoptCharacters:(const UChar *)chars length:(NSUInteger)length
+{
+	return false;
+}
+
+/* Mutable contents can't cache their hash or UTF-8 form. */
+- (NSHashCode)hash
+{
+	return [super hash];
+}
+
+- (const char *)UTF8String
+{
+	if (latin1 != NULL && asciiOnly)
+		return (const char *)latin1;
+	return [super UTF8String];
+}
+
 - (id) initWithCapacity:(NSUInteger)capacity
 {
-	str = UnicodeString(capacity, 0, 0);
+	/* Start out compact; the first non-Latin-1 insertion widens. */
+	latin1 = (unsigned char *)malloc(capacity + 1);
+	if (latin1 == NULL)
+	{
+		@throw [NSMemoryException
+			exceptionWithReason:@"Out of Memory creating string." userInfo:nil];
+	}
+	latin1[0] = 0;
+	latin1Capacity = capacity;
+	asciiOnly = true;
+	encoding = NSASCIIStringEncoding;
 	return self;
 }
 
+/* Mutable strings aren't shared, so the UTF-16 form can go in str. */
+- (UnicodeString &)_unicodeString
+{
+	if (latin1 != NULL && str.length() != (int32_t)latin1Length)
+	{
+		UChar *buf = str.getBuffer(latin1Length);
+		for (NSUInteger i = 0; i < latin1Length; i++)
+		{
+			buf[i] = latin1[i];
+		}
+		str.releaseBuffer(latin1Length);
+	}
+	return str;
+}
+
+/* Move compact contents into str, as UTF-16. */
+- (void) _widen
+{
+	UChar *buf = str.getBuffer(latin1Length);
+
+	for (NSUInteger i = 0; i < latin1Length; i++)
+	{
+		buf[i] = latin1[i];
+	}
+	str.releaseBuffer(latin1Length);
+	free(latin1);
+	latin1 = NULL;
+	latin1Length = latin1Capacity = 0;
+	encoding = NSUnicodeStringEncoding;
+}
+
 -(void)replaceCharactersInRange:(NSRange)aRange withString:(NSString *)aString
 {
 	NSUInteger len = [aString length];
 
+	if (NSMaxRange(aRange) > [self length])
+	{
+		@throw [NSRangeException exceptionWithReason:@"Range out of bounds"
+			userInfo:nil];
+	}
+
 	std::vector<UChar> others(len);
-	[aString getCharacters:&others[0] range:NSRange(0, len)];
-	str.replace(aRange.location, aRange.length, &others[0], len);
+	[aString getCharacters:(NSUniChar *)others.data() range:NSRange(0, len)];
+
+	if (latin1 != NULL)
+	{
+		if (!isLatin1(others.data(), len))
+		{
+			[self _widen];
+		}
+		else
+		{
+			NSUInteger newLength = latin1Length - aRange.length + len;
+
+			if (newLength > latin1Capacity)
+			{
+				NSUInteger newCapacity = std::max(newLength, 2 * latin1Capacity);
+				unsigned char *newLatin1 =
+					(unsigned char *)realloc(latin1, newCapacity + 1);
+				if (newLatin1 == NULL)
+				{
+					@throw [NSMemoryException
+						exceptionWithReason:@"Out of Memory growing string."
+						userInfo:nil];
+				}
+				latin1 = newLatin1;
+				latin1Capacity = newCapacity;
+			}
+			/* Shift the tail, including the terminating NUL. */
+			memmove(latin1 + aRange.location + len, latin1 + NSMaxRange(aRange),
+					latin1Length - NSMaxRange(aRange) + 1);
+			for (NSUInteger i = 0; i < len; i++)
+			{
+				latin1[aRange.location + i] = others[i];
+				asciiOnly = asciiOnly && others[i] < 0x80;
+			}
+			latin1Length = newLength;
+			encoding = asciiOnly ? NSASCIIStringEncoding : NSISOLatin1StringEncoding;
+			/* Drop any UTF-16 copy made by -_unicodeString. */
+			str.remove();
+			return;
+		}
+	}
+	str.replace(aRange.location, aRange.length, others.data(), len);
 }
 
 @end // NSCoreMutableString
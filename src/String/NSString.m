@@ -63,8 +63,13 @@
 #import <Foundation/NSLocale.h>
 #import <Foundation/NSScanner.h>
 #import "GSICUString.h"
+#import "NSStringHash.h"
+#import "NSStringConverter.h"
+#import "NSStringSearch.h"
+#import "NSStringUTF8.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -141,9 +146,67 @@ static NSString* Avsprintf(NSString* format, NSLocale *locale, va_list args)
 	return str;
 }
 
-static UCollator *_CollatorFromOptions(unsigned long mask, NSLocale *locale)
+/*
+ * Opening and configuring a collator is expensive, so each thread keeps a
+ * small LRU cache of them, keyed by locale identifier and the option bits that
+ * affect collation.  Each entry also keeps the string search opened on its
+ * collator, with its own copy of the last pattern.  The search is retargeted
+ * with usearch_setText() rather than reopened, and its text pointed back at
+ * static storage after each use; the pattern is only reset, and preprocessed
+ * again, when it changes.  ICU collators and searches must not be shared
+ * between threads while a search is in progress, hence the per-thread cache.
+ */
+#define COLLATOR_CACHE_SIZE 8
+#define COLLATOR_OPTIONS_MASK (NSCaseInsensitiveSearch | NSNumericSearch | \
+		NSDiacriticInsensitiveSearch | NSWidthInsensitiveSearch)
+
+struct _NSCollatorCacheEntry
+{
+	char *locale;	/* NULL for the default locale */
+	unsigned long mask;
+	unsigned long lastUse;
+	UCollator *coll;
+	UStringSearch *search;
+	UChar *pattern;	/* The search's pattern, owned by the entry */
+	int32_t patternLength;
+};
+
+struct _NSCollatorCache
+{
+	unsigned long clock;
+	struct _NSCollatorCacheEntry entries[COLLATOR_CACHE_SIZE];
+};
+
+static pthread_key_t collatorCacheKey;
+static pthread_once_t collatorCacheOnce = PTHREAD_ONCE_INIT;
+
+static void _CollatorCacheEntryClear(struct _NSCollatorCacheEntry *entry)
+{
+	if (entry->search != NULL)
+		usearch_close(entry->search);
+	if (entry->coll != NULL)
+		ucol_close(entry->coll);
+	free(entry->pattern);
+	free(entry->locale);
+	memset(entry, 0, sizeof(*entry));
+}
+
+static void _CollatorCacheDestroy(void *p)
+{
+	struct _NSCollatorCache *cache = p;
+
+	for (int i = 0; i < COLLATOR_CACHE_SIZE; i++)
+		_CollatorCacheEntryClear(&cache->entries[i]);
+	free(cache);
+}
+
+static void _CollatorCacheInit(void)
+{
+	pthread_key_create(&collatorCacheKey, _CollatorCacheDestroy);
+}
+
+static UCollator *_CollatorOpen(unsigned long mask, const char *locIdent)
 {
-	const char *locIdent = [[locale localeIdentifier] cStringUsingEncoding:NSUTF8StringEncoding];
 	UErrorCode ec = U_ZERO_ERROR;
 	UCollator *coll = ucol_open(locIdent, &ec);
 	if (mask&NSNumericSearch)
@@ -161,6 +224,196 @@ static UCollator *_CollatorFromOptions(unsigned long mask, NSLocale *locale)
 	return coll;
 }
 
+static struct _NSCollatorCacheEntry *_CollatorCacheLookup(unsigned long mask, NSLocale *locale)
+{
+	const char *locIdent = [[locale localeIdentifier] cStringUsingEncoding:NSUTF8StringEncoding];
+	struct _NSCollatorCache *cache;
+	struct _NSCollatorCacheEntry *entry;
+	struct _NSCollatorCacheEntry *victim;
+
+	pthread_once(&collatorCacheOnce, _CollatorCacheInit);
+	cache = pthread_getspecific(collatorCacheKey);
+	if (cache == NULL)
+	{
+		cache = calloc(1, sizeof(*cache));
+		if (cache == NULL)
+			return NULL;
+		pthread_setspecific(collatorCacheKey, cache);
+	}
+
+	mask &= COLLATOR_OPTIONS_MASK;
+	victim = &cache->entries[0];
+	for (int i = 0; i < COLLATOR_CACHE_SIZE; i++)
+	{
+		entry = &cache->entries[i];
+		if (entry->coll != NULL && entry->mask == mask &&
+				(entry->locale == locIdent ||
+				 (entry->locale != NULL && locIdent != NULL &&
+				  strcmp(entry->locale, locIdent) == 0)))
+		{
+			entry->lastUse = ++cache->clock;
+			return entry;
+		}
+		if (entry->lastUse < victim->lastUse)
+			victim = entry;
+	}
+
+	UCollator *coll = _CollatorOpen(mask, locIdent);
+	if (coll == NULL)
+		return NULL;
+	_CollatorCacheEntryClear(victim);
+	victim->coll = coll;
+	victim->mask = mask;
+	victim->locale = (locIdent != NULL) ? strdup(locIdent) : NULL;
+	victim->lastUse = ++cache->clock;
+	return victim;
+}
+
+/* The returned collator belongs to the per-thread cache; do not close it. */
+static UCollator *_CollatorFromOptions(unsigned long mask, NSLocale *locale)
+{
+	struct _NSCollatorCacheEntry *entry = _CollatorCacheLookup(mask, locale);
+
+	return (entry != NULL) ? entry->coll : NULL;
+}
+
+/*
+ * Returns the cached search for the collator matching mask and locale,
+ * retargeted at the given pattern and text.  Like the collator, the search
+ * belongs to the cache, which copies the pattern.  The text must outlive its
+ * use, and the caller hands it back with _StringSearchDetach() before freeing
+ * it.
+ */
+static UStringSearch *_StringSearchFromOptions(unsigned long mask, NSLocale *locale,
+		const UChar *pattern, int32_t patternLength,
+		const UChar *text, int32_t textLength, UErrorCode *ec)
+{
+	struct _NSCollatorCacheEntry *entry = _CollatorCacheLookup(mask, locale);
+	UChar *copy;
+
+	if (entry == NULL)
+	{
+		*ec = U_MEMORY_ALLOCATION_ERROR;
+		return NULL;
+	}
+	if (entry->search != NULL && entry->patternLength == patternLength &&
+			memcmp(entry->pattern, pattern, sizeof(UChar) * patternLength) == 0)
+	{
+		usearch_setText(entry->search, text, textLength, ec);
+	}
+	else
+	{
+		copy = malloc(sizeof(UChar) * patternLength);
+		if (copy == NULL)
+		{
+			*ec = U_MEMORY_ALLOCATION_ERROR;
+			return NULL;
+		}
+		memcpy(copy, pattern, sizeof(UChar) * patternLength);
+		if (entry->search == NULL)
+		{
+			entry->search = usearch_openFromCollator(copy, patternLength,
+					text, textLength, entry->coll, NULL, ec);
+		}
+		else
+		{
+			usearch_setText(entry->search, text, textLength, ec);
+			usearch_setPattern(entry->search, copy, patternLength, ec);
+		}
+		free(entry->pattern);
+		entry->pattern = copy;
+		entry->patternLength = patternLength;
+	}
+	if (U_FAILURE(*ec))
+	{
+		if (entry->search != NULL)
+			usearch_close(entry->search);
+		entry->search = NULL;
+		free(entry->pattern);
+		entry->pattern = NULL;
+		entry->patternLength = 0;
+	}
+	return entry->search;
+}
+
+/*
+ * Point a cached search at static text, so it doesn't keep the caller's
+ * buffer after it's freed.  ICU rejects empty text here.
+ */
+static void _StringSearchDetach(UStringSearch *search)
+{
+	static const UChar placeholder[] = { ' ' };
+	UErrorCode ec = U_ZERO_ERROR;
+
+	usearch_setText(search, placeholder, 1, &ec);
+}
+
+/*
+ * Options the literal search engine handles itself.  Anything else, or a
+ * case insensitive search for a non-ASCII needle, goes through the collator.
+ */
+#define LITERAL_SEARCH_OPTIONS (NSCaseInsensitiveSearch | NSLiteralSearch | \
+		NSBackwardsSearch | NSAnchoredSearch)
+#define LITERAL_NEEDLE_BUFFER 64
+
+/*
+ * Search for needle within range of haystack without the collator, working on
+ * haystack's own storage when it exposes it.  Returns false if the search
+ * can't be done literally, otherwise stores the match location, or
+ * NSNotFound, in *location.
+ */
+static bool _LiteralSearch(NSString *haystack, NSString *needle,
+		NSStringCompareOptions mask, NSRange range, NSUInteger *location)
+{
+	NSUniChar needleBuffer[LITERAL_NEEDLE_BUFFER];
+	NSUniChar *heapNeedle __cleanup(cleanup_pointer) = NULL;
+	NSUniChar *heapHaystack __cleanup(cleanup_pointer) = NULL;
+	const NSUniChar *needleChars;
+	const void *chars;
+	bool wide = true;
+	NSUInteger m = [needle length];
+
+	if (mask & ~LITERAL_SEARCH_OPTIONS)
+		return false;
+
+	needleChars = [needle _fastCharacterContents];
+	if (needleChars == NULL)
+	{
+		NSUniChar *buf = needleBuffer;
+		if (m > LITERAL_NEEDLE_BUFFER)
+			buf = heapNeedle = malloc(m * sizeof(NSUniChar));
+		[needle getCharacters:buf range:NSMakeRange(0, m)];
+		needleChars = buf;
+	}
+	if (mask & NSCaseInsensitiveSearch)
+	{
+		for (NSUInteger i = 0; i < m; i++)
+			if (needleChars[i] > 0x7f)
+				return false;
+	}
+
+	if ((chars = [haystack _fastCharacterContents]) != NULL)
+	{
+		chars = (const NSUniChar *)chars + range.location;
+	}
+	else if ((chars = [haystack _fastLatin1Contents]) != NULL)
+	{
+		chars = (const unsigned char *)chars + range.location;
+		wide = false;
+	}
+	else
+	{
+		heapHaystack = malloc(range.length * sizeof(NSUniChar));
+		[haystack getCharacters:heapHaystack range:range];
+		chars = heapHaystack;
+	}
+
+	*location = _NSLiteralSearch(chars, wide, range.length, needleChars, m, mask);
+	if (*location != NSNotFound)
+		*location += range.location;
+	return true;
+}
+
 /* Collator iterator */
 struct StringIterContext
 {
@@ -729,6 +982,18 @@ static inline bool SetHasCharacter(NSCharacterSet *set, NSUniChar c, bool insens
 		return range;
 	}
 
+	if (locale == nil || !(mask & NSCaseInsensitiveSearch))
+	{
+		NSUInteger location;
+
+		if (_LiteralSearch(self, aString, mask, aRange, &location))
+		{
+			if (location != NSNotFound)
+				range = NSMakeRange(location, a);
+			return range;
+		}
+	}
+
 	if ((mask & NSAnchoredSearch) || (aRange.length == a))
 	{
 		range.location = aRange.location +
@@ -745,7 +1010,6 @@ static inline bool SetHasCharacter(NSCharacterSet *set, NSUniChar c, bool insens
 		}
 	}
 
-	UCollator *coll = _CollatorFromOptions(mask, locale);
 	UChar *myChars __cleanup(cleanup_pointer) = malloc(sizeof(UChar) * aRange.length);
 	UChar *otherChars __cleanup(cleanup_pointer) = malloc(sizeof(UChar) * a);
 	UErrorCode ec = U_ZERO_ERROR;
@@ -753,7 +1017,8 @@ static inline bool SetHasCharacter(NSCharacterSet *set, NSUniChar c, bool insens
 	[self getCharacters:myChars range:aRange];
 	[aString getCharacters:otherChars range:NSMakeRange(0, a)];
 
-	UStringSearch *search = usearch_openFromCollator(otherChars, a, myChars, aRange.length, coll, NULL, &ec);
+	UStringSearch *search = _StringSearchFromOptions(mask, locale,
+			otherChars, a, myChars, aRange.length, &ec);
 
 	if (U_SUCCESS(ec))
 	{
@@ -769,10 +1034,18 @@ static inline bool SetHasCharacter(NSCharacterSet *set, NSUniChar c, bool insens
 		if (start != USEARCH_DONE)
 			range = NSMakeRange(start + aRange.location, a);
 	}
+	if (search != NULL)
+		_StringSearchDetach(search);
 
 	return range;
 }
 
+- (bool)containsString:(NSString *)aString
+{
+	return [self rangeOfString:aString options:0
+		range:NSMakeRange(0, [self length])].length != 0;
+}
+
 - (NSUInteger)indexOfString:(NSString*)substring
 {
 	NSRange range = NSMakeRange(0, [self length]);
@@ -1019,7 +1292,6 @@ options:(NSStringCompareOptions)mask range:(NSRange)aRange
 	NSComparisonResult result = (NSComparisonResult)ucol_strcollIter(coll, &thisIter, &otherIter, &ec);
 	if (result == NSOrderedSame && (mask & NSForcedOrderingSearch))
 	{
-		ucol_close(coll);
 		coll = _CollatorFromOptions(0, locale);
 		_ResetIter(&thisIter);
 		_ResetIter(&otherIter);
@@ -1027,7 +1299,6 @@ options:(NSStringCompareOptions)mask range:(NSRange)aRange
 	}
 	_DestroyUCharIterWithString(&thisIter);
 	_DestroyUCharIterWithString(&otherIter);
-	ucol_close(coll);
 	return result;
 
 }
@@ -1036,28 +1307,36 @@ options:(NSStringCompareOptions)mask range:(NSRange)aRange
 {
 	NSUInteger mLen = [self length];
 	NSUInteger aLen = [aString length];
-	NSRange range = {0, aLen};
 
+	if (aLen == 0)
+	{
+		return true;
+	}
 	if (aLen > mLen)
 	{
 		return false;
 	}
 
-	return [self compare:aString options:0 range:range] == NSOrderedSame;
+	return [self rangeOfString:aString options:NSAnchoredSearch
+		range:NSMakeRange(0, mLen)].length != 0;
 }
 
 - (bool)hasSuffix:(NSString*)aString
 {
 	NSUInteger mLen = [self length];
 	NSUInteger aLen = [aString length];
-	NSRange range = {mLen-aLen, aLen};
 
+	if (aLen == 0)
+	{
+		return true;
+	}
 	if (aLen > mLen)
 	{
 		return false;
 	}
 
-	return [self compare:aString options:0 range:range] == NSOrderedSame;
+	return [self rangeOfString:aString options:(NSAnchoredSearch | NSBackwardsSearch)
+		range:NSMakeRange(0, mLen)].length != 0;
 }
 
 - (bool)isEqual:(id)anObject
@@ -1090,21 +1369,32 @@ options:(NSStringCompareOptions)mask range:(NSRange)aRange
 
 - (NSHashCode)hash
 {
-	NSHashCode hash = 0, hash2;
-	NSUInteger i, n = [self length];
+	NSUInteger n = [self length];
+	uint64_t h = NSSTRING_HASH_SEED;
+	const NSUniChar *wide;
+	const unsigned char *narrow;
 
-	for(i = 0; i < n; i++)
+	if ((wide = [self _fastCharacterContents]) != NULL)
 	{
-		hash <<= 4;
-		// UNICODE - must use a for independent of composed characters
-		hash += [self characterAtIndex:i];
-		if((hash2 = hash & 0xf0000000))
+		h = _NSStringHashCharacters(h, wide, n);
+	}
+	else if ((narrow = [self _fastLatin1Contents]) != NULL)
+	{
+		h = _NSStringHashLatin1(h, narrow, n);
+	}
+	else
+	{
+		/* Chunks are a whole number of hash words. */
+		NSUniChar buf[64];
+		for (NSUInteger i = 0; i < n; i += 64)
 		{
-			hash ^= (hash2 >> 24) ^ hash2;
+			NSUInteger len = MIN(64, n - i);
+			[self getCharacters:buf range:NSMakeRange(i, len)];
+			h = _NSStringHashCharacters(h, buf, len);
 		}
 	}
 
-	return hash;
+	return _NSStringHashFinish(h, n);
 }
 
 /* Getting a shared prefix */
@@ -1208,43 +1498,177 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 
 - (const char *)cStringUsingEncoding:(NSStringEncoding)enc
 {
+	if (enc == NSUTF8StringEncoding)
+	{
+		return [self UTF8String];
+	}
+
 	size_t maxlen = [self maximumLengthOfBytesUsingEncoding:enc] + 1;
 	char *c = malloc(maxlen);
 	[self getCString:c maxLength:maxlen encoding:enc];
 	return [[[NSData alloc] initWithBytesNoCopy:c length:maxlen freeWhenDone:true] bytes];
 }
 
-- (const char *)UTF8String
+/*
+ * Encode as much of range as fits into capacity bytes of UTF-8, working on
+ * the string's own storage when it exposes it.  Returns the number of bytes
+ * written and stores the number of characters consumed in *consumed.
+ */
+static NSUInteger _StringGetUTF8(NSString *self, NSRange range, char *dst,
+		NSUInteger capacity, NSUInteger *consumed)
 {
-	char *utf8Str;
-	int32_t len;
-	int32_t selfLen = [self length];
-	NSUniChar *chars __cleanup(cleanup_pointer) = malloc(selfLen * sizeof(NSUniChar));
-	int error = 0;
+	const NSUniChar *wide;
+	const unsigned char *narrow;
+	NSUniChar buf[64];
+	NSUInteger used = 0;
+	NSUInteger i = 0;
+
+	if ((narrow = [self _fastLatin1Contents]) != NULL)
+		return _NSLatin1ToUTF8(narrow + range.location, range.length,
+				consumed, dst, capacity);
+	if ((wide = [self _fastCharacterContents]) != NULL)
+		return _NSUTF16ToUTF8(wide + range.location, range.length,
+				consumed, dst, capacity);
+
+	while (i < range.length)
+	{
+		NSUInteger len = MIN(64, range.length - i);
+		NSUInteger done;
+
+		[self getCharacters:buf range:NSMakeRange(range.location + i, len)];
+		/* Keep surrogate pairs within one chunk. */
+		if (len > 1 && i + len < range.length && (buf[len - 1] & 0xfc00) == 0xd800)
+			len--;
+		used += _NSUTF16ToUTF8(buf, len, &done, dst + used, capacity - used);
+		i += done;
+		if (done < len)
+			break;
+	}
+	*consumed = i;
+	return used;
+}
 
-	[self getCharacters:chars range:NSMakeRange(0, selfLen)];
+/*
+ * Encode range as ASCII, Latin-1 or UTF-16LE/BE into at most capacity bytes.
+ * Characters the encoding can't represent become '?' if lossy is set;
+ * otherwise they stop the conversion and set *unmappable.  Returns the number
+ * of bytes written and stores the number of characters consumed in *consumed.
+ */
+static NSUInteger _StringGetSimpleBytes(NSString *self, NSRange range,
+		NSStringEncoding enc, bool lossy, unsigned char *dst,
+		NSUInteger capacity, NSUInteger *consumed, bool *unmappable)
+{
+	const unsigned char *narrow = [self _fastLatin1Contents];
+	NSUniChar limit = (enc == NSASCIIStringEncoding) ? 0x80 : 0x100;
+	NSUniChar buf[64];
+	NSUInteger used = 0;
+	NSUInteger i = 0;
 
-	u_strToUTF8(NULL, 0, &len, chars, selfLen, &error);
+	if (narrow != NULL && enc == NSISOLatin1StringEncoding)
+	{
+		*consumed = MIN(range.length, capacity);
+		memcpy(dst, narrow + range.location, *consumed);
+		return *consumed;
+	}
 
-	if (U_FAILURE(error) && error != U_BUFFER_OVERFLOW_ERROR)
+	while (i < range.length)
+	{
+		NSUInteger len = MIN(64, range.length - i);
+
+		[self getCharacters:buf range:NSMakeRange(range.location + i, len)];
+		for (NSUInteger j = 0; j < len; j++, i++)
+		{
+			NSUniChar c = buf[j];
+
+			if (enc == NSUTF16BigEndianStringEncoding ||
+					enc == NSUTF16LittleEndianStringEncoding)
+			{
+				if (capacity - used < 2)
+					goto done;
+				if (enc == NSUTF16BigEndianStringEncoding)
+				{
+					dst[used++] = c >> 8;
+					dst[used++] = c & 0xff;
+				}
+				else
+				{
+					dst[used++] = c & 0xff;
+					dst[used++] = c >> 8;
+				}
+				continue;
+			}
+			if (used == capacity)
+				goto done;
+			if (c >= limit)
+			{
+				if (!lossy)
+				{
+					*unmappable = true;
+					goto done;
+				}
+				c = '?';
+			}
+			dst[used++] = c;
+		}
+	}
+done:
+	*consumed = i;
+	return used;
+}
+
+- (char *) _createUTF8String:(NSUInteger *)length
+{
+	NSUInteger n = [self length];
+	NSUInteger capacity = ([self _fastLatin1Contents] != NULL) ?
+		NSUTF8MaxLengthOfLatin1(n) : NSUTF8MaxLengthOfCharacters(n);
+	NSUInteger consumed;
+	NSUInteger used;
+	char *utf8 = malloc(capacity + 1);
+
+	if (utf8 == NULL)
 	{
-		free(chars);
 		return NULL;
 	}
-	error = 0;
+	used = _StringGetUTF8(self, NSMakeRange(0, n), utf8, capacity, &consumed);
+	utf8[used] = 0;
+	if (used < capacity)
+	{
+		char *shrunk = realloc(utf8, used + 1);
+		if (shrunk != NULL)
+			utf8 = shrunk;
+	}
+	if (length != NULL)
+		*length = used;
+	return utf8;
+}
+
+- (const char *)UTF8String
+{
+	NSUInteger len;
+	char *utf8Str = [self _createUTF8String:&len];
 
-	utf8Str = malloc(len + 1);
 	if (utf8Str == NULL)
 	{
-		free(chars);
 		return NULL;
 	}
-	u_strToUTF8(utf8Str, len+1, &len, chars, selfLen, &error);
 	return [[[NSData alloc] initWithBytesNoCopy:utf8Str length:len+1 freeWhenDone:true] bytes];
 }
 
 - (bool)getCString:(char *)buffer maxLength:(NSUInteger)maxLength encoding:(NSStringEncoding)enc
 {
+	if (enc == NSUTF8StringEncoding)
+	{
+		NSUInteger consumed;
+		NSUInteger used;
+
+		if (maxLength == 0)
+			return false;
+		used = _StringGetUTF8(self, NSMakeRange(0, [self length]), buffer,
+				maxLength - 1, &consumed);
+		buffer[used] = 0;
+		return consumed == [self length];
+	}
+
 	NSRange len = {0, [self length]};
 	bool result = [self getBytes:buffer maxLength:maxLength-1 usedLength:NULL encoding:enc
 		options:0 range:len remainingRange:NULL];
@@ -1259,48 +1683,70 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 	range:(NSRange)fromRange
 	remainingRange:(NSRange*)remainingRange
 {
-	NSUInteger toMove = (maxLength < fromRange.length)? maxLength : fromRange.length;
-	NSUInteger cLength = [self length];
-	UErrorCode err;
-	UConverter *conv;
-	char *target = buffer;
-	char *targetEnd = target + maxLength;
-	/* A static buffer for quick extraction and converting. */
-	const int BYTES_BUFSIZE = 80;
-	UChar internalBuffer[BYTES_BUFSIZE];
+	bool lossy = (options & NSStringEncodingConversionAllowLossy);
+	bool unmappable = false;
+	NSUInteger consumed = 0;
+	NSUInteger usedBytes;
 
 	VERIFY_RANGE(fromRange);
 
-	conv = ucnv_open([[NSString localizedNameOfStringEncoding:encoding] UTF8String], &err);
-	if (conv == 0)
-		return false;
-	if (options & NSStringEncodingConversionAllowLossy)
+	switch (encoding)
 	{
-		ucnv_setFallback(conv, true);
-	}
-	if (remainingRange)
-	{
-		remainingRange->location = fromRange.location + toMove;
-		remainingRange->length = cLength - remainingRange->location;
+		case NSUTF8StringEncoding:
+			usedBytes = _StringGetUTF8(self, fromRange, buffer, maxLength,
+					&consumed);
+			break;
+		case NSASCIIStringEncoding:
+		case NSISOLatin1StringEncoding:
+		case NSUTF16BigEndianStringEncoding:
+		case NSUTF16LittleEndianStringEncoding:
+			usedBytes = _StringGetSimpleBytes(self, fromRange, encoding, lossy,
+					buffer, maxLength, &consumed, &unmappable);
+			break;
+		default:
+		{
+			UErrorCode err;
+			UConverter *conv = _NSBorrowConverter(encoding);
+			char *target = buffer;
+			char *targetEnd = target + maxLength;
+			/* A static buffer for quick extraction and converting. */
+			const int BYTES_BUFSIZE = 80;
+			UChar internalBuffer[BYTES_BUFSIZE];
+
+			if (conv == NULL)
+				return false;
+			ucnv_setFallback(conv, lossy);
+
+			while (target != targetEnd && consumed < fromRange.length)
+			{
+				size_t buflen = MIN(BYTES_BUFSIZE, fromRange.length - consumed);
+				const UChar *buf = internalBuffer;
+				[self getCharacters:internalBuffer
+					range:NSMakeRange(fromRange.location + consumed, buflen)];
+				err = U_ZERO_ERROR;
+				ucnv_fromUnicode(conv, &target, targetEnd, &buf,
+						internalBuffer + buflen, NULL,
+						(consumed + buflen == fromRange.length), &err);
+				consumed += buf - internalBuffer;
+				if (err == U_BUFFER_OVERFLOW_ERROR)
+					break;
+			}
+			_NSReturnConverter(encoding, conv);
+			usedBytes = target - (char *)buffer;
+			break;
+		}
 	}
 
-	while (target != targetEnd && fromRange.length > 0)
+	if (usedBytes < maxLength)
+		((char *)buffer)[usedBytes] = 0;
+	if (used != NULL)
+		*used = usedBytes;
+	if (remainingRange)
 	{
-		size_t buflen = MIN(BYTES_BUFSIZE, fromRange.length);
-		const UChar *buf = internalBuffer;
-		[self getCharacters:internalBuffer range:NSMakeRange(fromRange.location, buflen)];
-		err = U_ZERO_ERROR;
-		ucnv_fromUnicode(conv, &target, targetEnd, &buf, internalBuffer + buflen, NULL, (buflen < fromRange.length), &err);
-		fromRange.length -= buflen;
-		if (err == U_BUFFER_OVERFLOW_ERROR)
-			break;
+		remainingRange->location = fromRange.location + consumed;
+		remainingRange->length = fromRange.length - consumed;
 	}
-	if (target < targetEnd)
-		*target = 0;
-	if (used != NULL)
-		*used = (NSUInteger)(target - (char *)buffer);
-	ucnv_close(conv);
-	return true;
+	return !unmappable;
 }
 
 /* Getting numeric values */
@@ -1385,6 +1831,16 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 	return NSUTF8StringEncoding;
 }
 
+- (const NSUniChar *) _fastCharacterContents
+{
+	return NULL;
+}
+
+- (const unsigned char *) _fastLatin1Contents
+{
+	return NULL;
+}
+
 + (NSStringEncoding) stringEncodingFromName:(NSString *)name
 {
 	name = [name uppercaseString];
@@ -1455,12 +1911,14 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 	  allowLossyConversion:(bool)flag
 {
 	size_t maxLen = [self maximumLengthOfBytesUsingEncoding:enc];
-	char *buffer __cleanup(cleanup_pointer) = malloc(maxLen);
+	char *buffer __cleanup(cleanup_pointer) = malloc(maxLen + 1);
 	NSUInteger usedLen = 0;
+	NSRange remaining;
 	NSData *d = nil;
 	if ([self getBytes:buffer maxLength:maxLen usedLength:&usedLen encoding:enc
 		options:(flag?NSStringEncodingConversionAllowLossy:0)
-		range:NSMakeRange(0, [self length]) remainingRange:NULL])
+		range:NSMakeRange(0, [self length]) remainingRange:&remaining] &&
+		remaining.length == 0)
 	{
 		d = [NSData dataWithBytes:buffer length:usedLen];
 	}
@@ -1503,14 +1961,27 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 - (size_t)maximumLengthOfBytesUsingEncoding:(NSStringEncoding)enc
 {
 	UConverter *conv;
-	UErrorCode err;
 	size_t retval;
 
-	conv = ucnv_open([[NSString localizedNameOfStringEncoding:enc] cStringUsingEncoding:NSASCIIStringEncoding], &err);
-	if (conv == 0)
+	switch (enc)
+	{
+		case NSASCIIStringEncoding:
+		case NSISOLatin1StringEncoding:
+			return [self length];
+		case NSUTF8StringEncoding:
+			return NSUTF8MaxLengthOfCharacters([self length]);
+		case NSUTF16BigEndianStringEncoding:
+		case NSUTF16LittleEndianStringEncoding:
+			return [self length] * sizeof(UChar);
+		default:
+			break;
+	}
+
+	conv = _NSBorrowConverter(enc);
+	if (conv == NULL)
 		return [self length] * sizeof(UChar);
 	retval = ucnv_getMaxCharSize(conv) * [self length];
-	ucnv_close(conv);
+	_NSReturnConverter(enc, conv);
 	return retval;
 }
 
@@ -1522,28 +1993,54 @@ static inline NSString *strSetCase(NSString *self, NSLocale *locale, int (*xlate
 	size_t len = [self length];
 	static const int bufsize = 256;
 
-	conv = ucnv_open([[NSString localizedNameOfStringEncoding:enc] cStringUsingEncoding:NSASCIIStringEncoding], &err);
+	switch (enc)
+	{
+		case NSASCIIStringEncoding:
+		case NSISOLatin1StringEncoding:
+			return len;
+		case NSUTF16BigEndianStringEncoding:
+		case NSUTF16LittleEndianStringEncoding:
+			return len * sizeof(UChar);
+		case NSUTF8StringEncoding:
+		{
+			char target[512];
+			NSUInteger consumed;
+
+			for (size_t i = 0; i < len; i += consumed)
+			{
+				retval += _StringGetUTF8(self, NSMakeRange(i, len - i),
+						target, sizeof(target), &consumed);
+			}
+			return retval;
+		}
+		default:
+			break;
+	}
+
+	conv = _NSBorrowConverter(enc);
 	if (conv == 0)
 		return [self length] * sizeof(UChar);
 	for (size_t i = 0; i < len; i = i + bufsize)
 	{
 		UChar buffer[256];
 		char target[512];
+		size_t chunk = MIN(len - i, bufsize);
 		const UChar *bufptr = buffer;
-		UChar *bufend = &buffer[bufsize];
+		UChar *bufend = &buffer[chunk];
 		err = U_BUFFER_OVERFLOW_ERROR;
-		[self getCharacters:buffer range:NSMakeRange(i, MIN(len - i, bufsize))];
+		[self getCharacters:buffer range:NSMakeRange(i, chunk)];
 		while (err == U_BUFFER_OVERFLOW_ERROR)
 		{
 			char *targetBase = target;
 			bool flush = false;
 			if (len - i <= bufsize)
 				flush = true;
+			err = U_ZERO_ERROR;
 			ucnv_fromUnicode(conv, &targetBase, target + sizeof(target), &bufptr, bufend, NULL, flush, &err);
 			retval += (targetBase - target);
 		}
 	}
-	ucnv_close(conv);
+	_NSReturnConverter(enc, conv);
 	return retval;
 }
 
@@ -1862,6 +2359,8 @@ static inline int hexval(char digit)
 {
 	NSRange r;
 	NSUInteger numMatches;
+	NSUInteger replacementLength = [replacement length];
+
 	for (numMatches = 0; searchRange.length != 0; numMatches++)
 	{
 		r = [self rangeOfString:target options:options
@@ -1869,9 +2368,16 @@ static inline int hexval(char digit)
 		if (r.length == 0)
 			break;
 		[self replaceCharactersInRange:r withString:replacement];
-		searchRange.length -= (NSMaxRange(r) - searchRange.location);
-		if (!(options & NSBackwardsSearch))
-			searchRange.location = r.location + r.length;
+		/* Continue after (or before) the text just substituted. */
+		if (options & NSBackwardsSearch)
+		{
+			searchRange.length = r.location - searchRange.location;
+		}
+		else
+		{
+			searchRange.length = NSMaxRange(searchRange) - NSMaxRange(r);
+			searchRange.location = r.location + replacementLength;
+		}
 	}
 	return numMatches;
 }
@@ -1971,6 +2477,14 @@ static NSTemporaryString *zoneStrings = nil;
 		encoding:encoding freeWhenDone:flag];
 }
 
+- (id) initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length
+	encoding:(NSStringEncoding)encoding
+	deallocator:(void (^)(void *, NSUInteger))deallocator
+{
+	return (id)[[NSCoreString alloc] initWithBytesNoCopy:bytes length:length
+		encoding:encoding deallocator:deallocator];
+}
+
 - (id) initWithCharacters:(const NSUniChar*)chars length:(NSUInteger)length
 {
 	return (id)[[NSCoreString alloc] initWithCharacters:chars length:length];
@@ -1984,6 +2498,13 @@ length:(NSUInteger)length freeWhenDone:(bool)flag
 		freeWhenDone:flag];
 }
 
+- (id) initWithCharactersNoCopy:(NSUniChar *)chars length:(NSUInteger)length
+	deallocator:(void (^)(NSUniChar *, NSUInteger))deallocator
+{
+	return (id)[[NSCoreString alloc] initWithCharactersNoCopy:chars length:length
+		deallocator:deallocator];
+}
+
 - (id) initWithCString:(const char*)byteString encoding:(NSStringEncoding)enc
 {
 	if (byteString == NULL)
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#import <Foundation/NSString.h>
+#include <unicode/ucnv.h>
+
+/*
+ * ICU converters are expensive to open, so each thread keeps a small pool of
+ * them, keyed by NSStringEncoding.  A borrowed converter belongs to the caller
+ * until it is returned, so nested conversions each get their own.
+ *
+ * UTF-8, ASCII, Latin-1 and UTF-16LE/BE never reach ICU; the string classes
+ * convert those themselves.
+ */
+
+__BEGIN_DECLS
+/*
+ * Borrow a reset converter for enc from the calling thread's pool, opening one
+ * if needed.  Returns NULL if ICU doesn't support enc.
+ */
+UConverter *_NSBorrowConverter(NSStringEncoding enc);
+
+/* Return a converter obtained from _NSBorrowConverter() to the pool. */
+void _NSReturnConverter(NSStringEncoding enc, UConverter *conv);
+
+/*
+ * Decode length bytes of UTF-16 in the given byte order into units, which
+ * must have room for (length + 1) / 2 entries.  A trailing odd byte decodes
+ * as U+FFFD.  Returns the number of units written.
+ */
+NSUInteger _NSDecodeUTF16(const unsigned char *bytes, NSUInteger length,
+		bool bigEndian, NSUniChar *units);
+__END_DECLS
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#import "NSStringConverter.h"
+
+#define CONVERTER_POOL_SIZE	8
+
+struct _NSConverterPool
+{
+	unsigned next;	/* Slot to evict when the pool is full */
+	struct
+	{
+		NSStringEncoding encoding;
+		UConverter *converter;
+	} slots[CONVERTER_POOL_SIZE];
+};
+
+static pthread_key_t converterPoolKey;
+static pthread_once_t converterPoolOnce = PTHREAD_ONCE_INIT;
+
+static void converterPoolDestroy(void *p)
+{
+	struct _NSConverterPool *pool = p;
+
+	for (int i = 0; i < CONVERTER_POOL_SIZE; i++)
+	{
+		if (pool->slots[i].converter != NULL)
+			ucnv_close(pool->slots[i].converter);
+	}
+	free(pool);
+}
+
+static void converterPoolInit(void)
+{
+	pthread_key_create(&converterPoolKey, converterPoolDestroy);
+}
+
+static struct _NSConverterPool *converterPool(void)
+{
+	struct _NSConverterPool *pool;
+
+	pthread_once(&converterPoolOnce, converterPoolInit);
+	pool = pthread_getspecific(converterPoolKey);
+	if (pool == NULL)
+	{
+		pool = calloc(1, sizeof(*pool));
+		if (pool != NULL)
+			pthread_setspecific(converterPoolKey, pool);
+	}
+	return pool;
+}
+
+UConverter *_NSBorrowConverter(NSStringEncoding enc)
+{
+	struct _NSConverterPool *pool = converterPool();
+	UErrorCode err = U_ZERO_ERROR;
+	UConverter *conv;
+
+	if (pool != NULL)
+	{
+		for (int i = 0; i < CONVERTER_POOL_SIZE; i++)
+		{
+			if (pool->slots[i].converter != NULL &&
+					pool->slots[i].encoding == enc)
+			{
+				conv = pool->slots[i].converter;
+				pool->slots[i].converter = NULL;
+				return conv;
+			}
+		}
+	}
+
+	conv = ucnv_open([[NSString localizedNameOfStringEncoding:enc] UTF8String], &err);
+	if (U_FAILURE(err))
+	{
+		return NULL;
+	}
+	return conv;
+}
+
+void _NSReturnConverter(NSStringEncoding enc, UConverter *conv)
+{
+	struct _NSConverterPool *pool = converterPool();
+	int slot;
+
+	if (conv == NULL)
+		return;
+	if (pool == NULL)
+	{
+		ucnv_close(conv);
+		return;
+	}
+
+	ucnv_reset(conv);
+	for (slot = 0; slot < CONVERTER_POOL_SIZE; slot++)
+	{
+		if (pool->slots[slot].converter == NULL)
+			break;
+	}
+	if (slot == CONVERTER_POOL_SIZE)
+	{
+		slot = pool->next;
+		pool->next = (pool->next + 1) % CONVERTER_POOL_SIZE;
+		ucnv_close(pool->slots[slot].converter);
+	}
+	pool->slots[slot].encoding = enc;
+	pool->slots[slot].converter = conv;
+}
+
+NSUInteger _NSDecodeUTF16(const unsigned char *bytes, NSUInteger length,
+		bool bigEndian, NSUniChar *units)
+{
+	NSUInteger n = length / 2;
+
+	if (bigEndian)
+	{
+		for (NSUInteger i = 0; i < n; i++)
+			units[i] = (bytes[2 * i] << 8) | bytes[2 * i + 1];
+	}
+	else
+	{
+		for (NSUInteger i = 0; i < n; i++)
+			units[i] = bytes[2 * i] | (bytes[2 * i + 1] << 8);
+	}
+	if (length & 1)
+		units[n++] = 0xfffd;
+	return n;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <stdint.h>
+
+#import <Foundation/NSString.h>
+
+/*
+ * The string hash, shared by every NSString representation.  It works on
+ * UTF-16 code unit values, packing four units into each 64-bit word, so
+ * 8-bit and UTF-16 storage of the same text hash identically.  The word mixing
+ * and finalizer are those of MurmurHash3.
+ *
+ * Streaming callers must feed whole words (multiples of four units) to every
+ * update but the last.
+ */
+
+#define NSSTRING_HASH_SEED	0x9e3779b97f4a7c15ULL
+
+static inline uint64_t _NSStringHashMix(uint64_t h, uint64_t w)
+{
+	w *= 0x87c37b91114253d5ULL;
+	w = (w << 31) | (w >> 33);
+	w *= 0x4cf5ad432745937fULL;
+	h ^= w;
+	h = (h << 27) | (h >> 37);
+	return h * 5 + 0x52dce729;
+}
+
+static inline uint64_t _NSStringHashCharacters(uint64_t h,
+		const NSUniChar *s, NSUInteger n)
+{
+	NSUInteger i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		h = _NSStringHashMix(h, (uint64_t)s[i] | ((uint64_t)s[i + 1] << 16) |
+				((uint64_t)s[i + 2] << 32) | ((uint64_t)s[i + 3] << 48));
+	}
+	if (i < n)
+	{
+		uint64_t w = 0;
+		for (unsigned j = 0; i + j < n; j++)
+			w |= (uint64_t)s[i + j] << (16 * j);
+		h = _NSStringHashMix(h, w);
+	}
+	return h;
+}
+
+static inline uint64_t _NSStringHashLatin1(uint64_t h,
+		const unsigned char *s, NSUInteger n)
+{
+	NSUInteger i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		h = _NSStringHashMix(h, (uint64_t)s[i] | ((uint64_t)s[i + 1] << 16) |
+				((uint64_t)s[i + 2] << 32) | ((uint64_t)s[i + 3] << 48));
+	}
+	if (i < n)
+	{
+		uint64_t w = 0;
+		for (unsigned j = 0; i + j < n; j++)
+			w |= (uint64_t)s[i + j] << (16 * j);
+		h = _NSStringHashMix(h, w);
+	}
+	return h;
+}
+
+static inline NSHashCode _NSStringHashFinish(uint64_t h, NSUInteger length)
+{
+	h ^= length;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (NSHashCode)h;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#import "NSStringSearch.h"
+
+/*
+ * Single code unit scans find candidate positions; needles of four or more
+ * units use Horspool's algorithm instead, with a 256 entry skip table indexed
+ * by the low byte of each unit.  Units sharing a low byte share a table slot,
+ * which only ever shortens a skip, so the table stays correct for UTF-16.
+ */
+
+#define HORSPOOL_MIN_NEEDLE	4
+
+static inline NSUniChar foldASCII(NSUniChar c)
+{
+	return ((unsigned)(c - 'A') < 26) ? c + ('a' - 'A') : c;
+}
+
+template <typename T, bool fold>
+static inline NSUniChar unitAt(const T *s, NSUInteger i)
+{
+	return fold ? foldASCII(s[i]) : s[i];
+}
+
+template <typename T, bool fold>
+static inline bool matchesAt(const T *hay, NSUInteger pos,
+		const NSUniChar *needle, NSUInteger m)
+{
+	for (NSUInteger j = 0; j < m; j++)
+	{
+		if (unitAt<T, fold>(hay, pos + j) != needle[j])
+			return false;
+	}
+	return true;
+}
+
+#ifdef __SSE2__
+static inline int matchMask(const uint8_t *p, __m128i a, __m128i b)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)p);
+	return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, a),
+				_mm_cmpeq_epi8(v, b)));
+}
+
+static inline int matchMask(const NSUniChar *p, __m128i a, __m128i b)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)p);
+	/* Two mask bits per unit; keep the low one. */
+	return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, a),
+				_mm_cmpeq_epi16(v, b))) & 0x5555;
+}
+
+static inline __m128i splat(const uint8_t *, NSUniChar c)
+{
+	return _mm_set1_epi8((char)c);
+}
+
+static inline __m128i splat(const NSUniChar *, NSUniChar c)
+{
+	return _mm_set1_epi16((short)c);
+}
+#endif
+
+/*
+ * Find the first (or last) position in [from, to) holding c1 or c2.  The two
+ * are equal except for case insensitive searches for a letter.
+ */
+template <typename T>
+static NSUInteger scanForward(const T *s, NSUInteger from, NSUInteger to,
+		NSUniChar c1, NSUniChar c2)
+{
+	NSUInteger i = from;
+
+#ifdef __SSE2__
+	const NSUInteger lanes = 16 / sizeof(T);
+	__m128i a = splat(s, c1);
+	__m128i b = splat(s, c2);
+
+	for (; i + lanes <= to; i += lanes)
+	{
+		int mask = matchMask(s + i, a, b);
+		if (mask != 0)
+			return i + __builtin_ctz(mask) / sizeof(T);
+	}
+#endif
+	for (; i < to; i++)
+	{
+		if (s[i] == c1 || s[i] == c2)
+			return i;
+	}
+	return NSNotFound;
+}
+
+template <typename T>
+static NSUInteger scanBackward(const T *s, NSUInteger from, NSUInteger to,
+		NSUniChar c1, NSUniChar c2)
+{
+	NSUInteger i = to;
+
+#ifdef __SSE2__
+	const NSUInteger lanes = 16 / sizeof(T);
+	__m128i a = splat(s, c1);
+	__m128i b = splat(s, c2);
+
+	for (; i >= from + lanes; i -= lanes)
+	{
+		int mask = matchMask(s + i - lanes, a, b);
+		if (mask != 0)
+			return i - lanes + (31 - __builtin_clz(mask)) / sizeof(T);
+	}
+#endif
+	while (i > from)
+	{
+		i--;
+		if (s[i] == c1 || s[i] == c2)
+			return i;
+	}
+	return NSNotFound;
+}
+
+template <typename T, bool fold>
+static NSUInteger scanSearch(const T *hay, NSUInteger n,
+		const NSUniChar *needle, NSUInteger m, bool backwards)
+{
+	NSUniChar c1 = needle[0];
+	NSUniChar c2 = (fold && (unsigned)(c1 - 'a') < 26) ? c1 - ('a' - 'A') : c1;
+	NSUInteger last = n - m + 1;
+	NSUInteger pos;
+
+	if (!backwards)
+	{
+		for (NSUInteger from = 0;
+				(pos = scanForward(hay, from, last, c1, c2)) != NSNotFound;
+				from = pos + 1)
+		{
+			if (matchesAt<T, fold>(hay, pos + 1, needle + 1, m - 1))
+				return pos;
+		}
+	}
+	else
+	{
+		for (NSUInteger to = last;
+				(pos = scanBackward(hay, 0, to, c1, c2)) != NSNotFound;
+				to = pos)
+		{
+			if (matchesAt<T, fold>(hay, pos + 1, needle + 1, m - 1))
+				return pos;
+		}
+	}
+	return NSNotFound;
+}
+
+template <typename T, bool fold>
+static NSUInteger horspoolSearch(const T *hay, NSUInteger n,
+		const NSUniChar *needle, NSUInteger m, bool backwards)
+{
+	uint8_t skip[256];
+	NSUInteger pos;
+	NSUniChar c;
+
+	memset(skip, (m < 255) ? m : 255, sizeof(skip));
+	if (!backwards)
+	{
+		NSUniChar tail = needle[m - 1];
+
+		for (NSUInteger i = 0; i < m - 1; i++)
+		{
+			NSUInteger d = m - 1 - i;
+			skip[needle[i] & 0xff] = (d < 255) ? d : 255;
+		}
+		for (pos = 0; pos <= n - m; pos += skip[c & 0xff])
+		{
+			c = unitAt<T, fold>(hay, pos + m - 1);
+			if (c == tail && matchesAt<T, fold>(hay, pos, needle, m - 1))
+				return pos;
+		}
+	}
+	else
+	{
+		NSUniChar head = needle[0];
+
+		for (NSUInteger i = m - 1; i > 0; i--)
+		{
+			skip[needle[i] & 0xff] = (i < 255) ? i : 255;
+		}
+		for (pos = n - m; ; pos -= skip[c & 0xff])
+		{
+			c = unitAt<T, fold>(hay, pos);
+			if (c == head && matchesAt<T, fold>(hay, pos + 1, needle + 1, m - 1))
+				return pos;
+			if (pos < skip[c & 0xff])
+				break;
+		}
+	}
+	return NSNotFound;
+}
+
+template <typename T, bool fold>
+static NSUInteger literalSearch(const T *hay, NSUInteger n,
+		const NSUniChar *needle, NSUInteger m, NSStringCompareOptions options)
+{
+	bool backwards = (options & NSBackwardsSearch);
+
+	if (options & NSAnchoredSearch)
+	{
+		NSUInteger pos = backwards ? n - m : 0;
+		return matchesAt<T, fold>(hay, pos, needle, m) ? pos : NSNotFound;
+	}
+	if (m < HORSPOOL_MIN_NEEDLE)
+		return scanSearch<T, fold>(hay, n, needle, m, backwards);
+	return horspoolSearch<T, fold>(hay, n, needle, m, backwards);
+}
+
+template <typename T>
+static NSUInteger literalSearch(const T *hay, NSUInteger n,
+		const NSUniChar *needle, NSUInteger m, NSStringCompareOptions options)
+{
+	if (options & NSCaseInsensitiveSearch)
+		return literalSearch<T, true>(hay, n, needle, m, options);
+	return literalSearch<T, false>(hay, n, needle, m, options);
+}
+
+NSUInteger _NSLiteralSearch(const void *haystack, bool wide, NSUInteger length,
+		const NSUniChar *needle, NSUInteger needleLength,
+		NSStringCompareOptions options)
+{
+	NSUniChar folded[64];
+	NSUniChar *heapFolded = NULL;
+	NSUInteger result;
+
+	if (needleLength == 0 || needleLength > length)
+		return NSNotFound;
+
+	if (!wide)
+	{
+		/* Units beyond Latin-1 can never match 8-bit storage. */
+		for (NSUInteger i = 0; i < needleLength; i++)
+		{
+			if (needle[i] > 0xff)
+				return NSNotFound;
+		}
+	}
+
+	if (options & NSCaseInsensitiveSearch)
+	{
+		NSUniChar *buf = folded;
+
+		if (needleLength > sizeof(folded) / sizeof(folded[0]))
+			buf = heapFolded = new NSUniChar[needleLength];
+		for (NSUInteger i = 0; i < needleLength; i++)
+			buf[i] = foldASCII(needle[i]);
+		needle = buf;
+	}
+
+	if (wide)
+		result = literalSearch((const NSUniChar *)haystack, length,
+				needle, needleLength, options);
+	else
+		result = literalSearch((const uint8_t *)haystack, length,
+				needle, needleLength, options);
+	delete[] heapFolded;
+	return result;
+}
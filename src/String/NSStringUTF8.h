@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#import <Foundation/NSString.h>
+
+/*
+ * Single pass UTF-8 encoders for the two forms of string storage.
+ */
+
+/* Largest UTF-8 encoding of n UTF-16 units, or of n Latin-1 characters. */
+#define NSUTF8MaxLengthOfCharacters(n)	((n) * 3)
+#define NSUTF8MaxLengthOfLatin1(n)	((n) * 2)
+
+__BEGIN_DECLS
+/*
+ * Encode up to n UTF-16 units from src as UTF-8 into dst, writing at most
+ * capacity bytes and never splitting a character.  Unpaired surrogates are
+ * encoded as U+FFFD.  Returns the number of bytes written; the number of
+ * units consumed is stored in *consumed if it's not NULL.  Runs of ASCII are
+ * copied in bulk.
+ */
+NSUInteger _NSUTF16ToUTF8(const NSUniChar *src, NSUInteger n,
+		NSUInteger *consumed, char *dst, NSUInteger capacity);
+
+/* The same, for Latin-1 (8-bit) storage. */
+NSUInteger _NSLatin1ToUTF8(const unsigned char *src, NSUInteger n,
+		NSUInteger *consumed, char *dst, NSUInteger capacity);
+__END_DECLS
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2012	Justin Hibbits
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * 
+ */
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#import "NSStringUTF8.h"
+
+#define REPLACEMENT_CHARACTER	0xfffd
+
+static inline bool isHighSurrogate(NSUniChar c)
+{
+	return (c & 0xfc00) == 0xd800;
+}
+
+static inline bool isLowSurrogate(NSUniChar c)
+{
+	return (c & 0xfc00) == 0xdc00;
+}
+
+NSUInteger _NSUTF16ToUTF8(const NSUniChar *src, NSUInteger n,
+		NSUInteger *consumed, char *dst, NSUInteger capacity)
+{
+	unsigned char *out = (unsigned char *)dst;
+	unsigned char *end = out + capacity;
+	NSUInteger i = 0;
+
+	while (i < n)
+	{
+#ifdef __SSE2__
+		/* Eight ASCII units at a time. */
+		while (i + 8 <= n && out + 8 <= end)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+					_mm_and_si128(v, _mm_set1_epi16((short)0xff80)),
+					_mm_setzero_si128())) != 0xffff)
+				break;
+			_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(v, v));
+			out += 8;
+			i += 8;
+		}
+		if (i >= n)
+			break;
+#endif
+		uint32_t c = src[i];
+		NSUInteger units = 1;
+
+		if (c < 0x80)
+		{
+			if (out == end)
+				break;
+			*out++ = c;
+			i++;
+			continue;
+		}
+		if (isHighSurrogate(c) && i + 1 < n && isLowSurrogate(src[i + 1]))
+		{
+			c = 0x10000 + ((c - 0xd800) << 10) + (src[i + 1] - 0xdc00);
+			units = 2;
+		}
+		else if (isHighSurrogate(c) || isLowSurrogate(c))
+		{
+			c = REPLACEMENT_CHARACTER;
+		}
+
+		if (c < 0x800)
+		{
+			if (end - out < 2)
+				break;
+			*out++ = 0xc0 | (c >> 6);
+		}
+		else if (c < 0x10000)
+		{
+			if (end - out < 3)
+				break;
+			*out++ = 0xe0 | (c >> 12);
+			*out++ = 0x80 | ((c >> 6) & 0x3f);
+		}
+		else
+		{
+			if (end - out < 4)
+				break;
+			*out++ = 0xf0 | (c >> 18);
+			*out++ = 0x80 | ((c >> 12) & 0x3f);
+			*out++ = 0x80 | ((c >> 6) & 0x3f);
+		}
+		*out++ = 0x80 | (c & 0x3f);
+		i += units;
+	}
+	if (consumed != NULL)
+		*consumed = i;
+	return out - (unsigned char *)dst;
+}
+
+NSUInteger _NSLatin1ToUTF8(const unsigned char *src, NSUInteger n,
+		NSUInteger *consumed, char *dst, NSUInteger capacity)
+{
+	unsigned char *out = (unsigned char *)dst;
+	unsigned char *end = out + capacity;
+	NSUInteger i = 0;
+
+	while (i < n)
+	{
+		/* Copy the run of ASCII up to the next high character. */
+		NSUInteger run = 0;
+		NSUInteger room = end - out;
+
+		while (i + run < n && run < room && src[i + run] < 0x80)
+			run++;
+		memcpy(out, src + i, run);
+		out += run;
+		i += run;
+		if (i == n || out == end)
+			break;
+
+		if (src[i] >= 0x80)
+		{
+			if (end - out < 2)
+				break;
+			*out++ = 0xc0 | (src[i] >> 6);
+			*out++ = 0x80 | (src[i] & 0x3f);
+			i++;
+		}
+	}
+	if (consumed != NULL)
+		*consumed = i;
+	return out - (unsigned char *)dst;
+}
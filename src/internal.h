@@ -30,7 +30,9 @@
 
 #include <sys/cdefs.h>
 #include <sys/param.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <libxml/tree.h>
 
@@ -54,6 +56,7 @@
 #import <Foundation/NSString.h>
 #import <Foundation/NSTask.h>
 #import <Foundation/NSThread.h>
+#import <Foundation/NSTimer.h>
 #import <Foundation/NSURL.h>
 #import <Foundation/NSURLProtocol.h>
 #import <Foundation/NSXMLNode.h>
@@ -159,6 +162,9 @@ extern unsigned int numThreads __private;
 typedef int		 (*cmp_t)(const void *, const void *);
 void *runThread(void *thr) __private;
 
+/* Call after adding methods to a class at runtime. */
+void _NSKVCInvalidateAccessorCache(void) __private;
+
 #ifdef __OBJC__
 @class NSProxy;
 @class NSDictionary;
@@ -252,6 +258,14 @@ struct kevent;
 @interface NSRunLoop()
 - (void) addEventSource:(struct kevent *)source target:(id<_NSRunLoopEventSource>)target modes:(NSArray *)modes;
 - (void) removeEventSource:(struct kevent *)source fromModes:(NSArray *)modes;
+- (void) _timerDidReschedule:(NSTimer *)timer;
+- (void) _removeTimer:(NSTimer *)timer;
+@end
+
+/* Timers are kept on the monotonic clock, in nanoseconds. */
+@interface NSTimer()
+- (uint64_t) _fireTime;
+- (void) _setRunLoop:(NSRunLoop *)loop;
 @end
 
 bool spawnProcessWithURL(NSURL *, id, NSDictionary *, pid_t *);
@@ -262,6 +276,14 @@ static inline bool object_isInstance(id obj)
 }
 #endif
 
+static inline uint64_t monotonic_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NANOSECONDS + ts.tv_nsec;
+}
+
 // collToSort must respond to the following
 // -objectAtIndex:
 // -exchangeObjectAtIndex:withObjectAtIndex:
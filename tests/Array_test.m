@@ -536,4 +536,27 @@
 		@"");
 }
 
+-(void) test_copy_mutation
+{
+	NSMutableArray *a = [NSMutableArray arrayWithObjects:@"foo", @"bar", nil];
+	NSArray *b = [a copy];
+	NSMutableArray *c = [b mutableCopy];
+	NSUInteger n = 0;
+
+	[a addObject:@"baz"];
+	[c removeObjectAtIndex:0];
+	fail_unless([a count] == 3 && [b count] == 2 && [c count] == 1,
+		@"Mutating a copy changed the original.");
+	fail_unless([[b objectAtIndex:0] isEqual:@"foo"] &&
+		[[c objectAtIndex:0] isEqual:@"bar"],
+		@"");
+	for (id obj in a)
+	{
+		(void)obj;
+		n++;
+	}
+	fail_unless(n == 3,
+		@"Fast enumeration of an array failed.");
+}
+
 @end
@@ -0,0 +1,63 @@
+#import <Test/NSTest.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSCache.h>
+#import <Foundation/NSString.h>
+
+@interface TestCacheDelegate : NSObject <NSCacheDelegate>
+@property NSMutableArray *evicted;
+@end
+
+@implementation TestCacheDelegate
+@synthesize evicted;
+
+- (void) cache:(NSCache *)cache willEvictObject:(id)obj
+{
+	[evicted addObject:obj];
+}
+@end
+
+@interface TestCache : NSTest
+@end
+
+@implementation TestCache
+
+- (void) test_setObject_forKey_
+{
+	NSCache *c = [NSCache new];
+	[c setObject:@"bar" forKey:@"foo"];
+	fail_unless([[c objectForKey:@"foo"] isEqual:@"bar"] &&
+			[c objectForKey:@"baz"] == nil,
+		@"-[NSCache setObject:forKey:] failed.");
+}
+
+- (void) test_countLimit
+{
+	NSCache *c = [NSCache new];
+	[c setCountLimit:2];
+	[c setObject:@"1" forKey:@"a"];
+	[c setObject:@"2" forKey:@"b"];
+	[c objectForKey:@"a"];
+	[c setObject:@"3" forKey:@"c"];
+	fail_unless([c objectForKey:@"a"] != nil &&
+			[c objectForKey:@"b"] == nil &&
+			[c objectForKey:@"c"] != nil,
+		@"NSCache did not evict the least recently used object.");
+}
+
+- (void) test_totalCostLimit
+{
+	NSCache *c = [NSCache new];
+	TestCacheDelegate *d = [TestCacheDelegate new];
+	[d setEvicted:[NSMutableArray new]];
+	[c setDelegate:d];
+	[c setTotalCostLimit:10];
+	[c setObject:@"1" forKey:@"a" cost:4];
+	[c setObject:@"2" forKey:@"b" cost:4];
+	[c setObject:@"3" forKey:@"c" cost:4];
+	fail_unless([c objectForKey:@"a"] == nil &&
+			[[d evicted] count] == 1 &&
+			[[[d evicted] objectAtIndex:0] isEqual:@"1"],
+		@"NSCache did not enforce totalCostLimit.");
+}
+
+@end
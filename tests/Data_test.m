@@ -1,6 +1,9 @@
 #import <Test/NSTest.h>
 #import <Foundation/NSData.h>
+#import <Foundation/NSURL.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 @interface TestDataClass : NSTest
 @end
@@ -58,6 +61,25 @@
 
 @implementation TestData
 
+- (void) test_initWithContentsOfURL_options_error_mapped
+{
+	const char *path = "/tmp/test_mapped_data";
+	char contents[8192];
+	FILE *f = fopen(path, "w");
+
+	for (size_t i = 0; i < sizeof(contents); i++)
+		contents[i] = (char)i;
+	fwrite(contents, 1, sizeof(contents), f);
+	fclose(f);
+
+	NSData *d = [NSData dataWithContentsOfURL:[NSURL URLWithString:@"file:///tmp/test_mapped_data"]
+		options:NSDataReadingMappedIfSafe | NSDataReadingSequentialAccess error:NULL];
+	unlink(path);
+	fail_unless([d length] == sizeof(contents) &&
+		memcmp([d bytes], contents, sizeof(contents)) == 0,
+		@"");
+}
+
 - (void) test_initWithBytes_length_
 {
 	char b[] = {0, 1,2, 3, 4, 5, 6, 7,8, 9, 'a', 'b'};
@@ -201,4 +223,35 @@
 		@"");
 }
 
+- (void) test_initWithBytesNoCopy_length_deallocator_
+{
+	static char b[] = {0, 5, 3, 24, 6, 'a', 'c', 'q', '.', 2, 5, 0};
+	__block int released = 0;
+
+	@autoreleasepool {
+		NSData *d = [[NSData alloc] initWithBytesNoCopy:b length:sizeof(b)
+			deallocator:^(void *p, NSUInteger len) {
+				if (p == b && len == sizeof(b))
+					released++;
+			}];
+		fail_unless([d bytes] == b && [d length] == sizeof(b),
+			@"");
+		fail_unless([d copy] == d,
+			@"");
+	}
+	fail_unless(released == 1,
+		@"");
+}
+
+- (void) test_copy_mutable
+{
+	char b[] = {0, 5, 3, 24, 6, 'a', 'c', 'q', '.', 2, 5, 0};
+	NSMutableData *d = [NSMutableData dataWithBytes:b length:sizeof(b)];
+	NSData *c = [d copy];
+
+	[d resetBytesInRange:NSMakeRange(0, sizeof(b))];
+	fail_unless(c != d && memcmp([c bytes], b, sizeof(b)) == 0,
+		@"");
+}
+
 @end
@@ -3,6 +3,7 @@
 #import <Foundation/NSString.h>
 #import <Foundation/NSArray.h>
 #import <Foundation/NSEnumerator.h>
+#import <Foundation/NSValue.h>
 
 @interface TestDictionaryClass : NSTest
 @end
@@ -184,6 +185,82 @@
 	fail_unless([d objectForKey:@"bar"] == @"foo", @"");
 }
 
+- (void) test_copy
+{
+	NSMutableDictionary *d = [NSMutableDictionary dictionary];
+	NSUInteger seen = 0;
+
+	for (int i = 0; i < 100; i++)
+		[d setObject:@(i) forKey:[NSString stringWithFormat:@"%d", i]];
+
+	NSDictionary *c = [d copy];
+
+	[d removeAllObjects];
+	fail_unless([c count] == 100 && [c copy] == c,
+		@"-[NSMutableDictionary copy] failed.");
+	for (int i = 0; i < 100; i++)
+	{
+		fail_unless([[c objectForKey:[NSString stringWithFormat:@"%d", i]] intValue] == i,
+			@"-[NSDictionary objectForKey:] failed on a copy.");
+	}
+	fail_unless([c objectForKey:@"100"] == nil,
+		@"-[NSDictionary objectForKey:] found a missing key.");
+	for (NSString *key in c)
+	{
+		fail_unless([[c objectForKey:key] intValue] == [key intValue], @"");
+		seen++;
+	}
+	fail_unless(seen == 100,
+		@"Enumerating a copied dictionary failed.");
+}
+
+- (void) test_setObject_forKey_growing
+{
+	NSMutableDictionary *d = [NSMutableDictionary dictionary];
+
+	/* Crosses from the inline entries to the hash table. */
+	for (int i = 0; i < 20; i++)
+	{
+		[d setObject:@(i) forKey:@(i)];
+		for (int j = 0; j <= i; j++)
+		{
+			fail_unless([[d objectForKey:@(j)] intValue] == j,
+				@"-[NSMutableDictionary setObject:forKey:] lost an entry.");
+		}
+	}
+	[d removeObjectForKey:@(0)];
+	[d removeAllObjects];
+	[d setObject:@"foo" forKey:@"bar"];
+	fail_unless([d count] == 1 && [[d objectForKey:@"bar"] isEqual:@"foo"],
+		@"-[NSMutableDictionary removeAllObjects] failed.");
+}
+
+- (void) test_removeObjectForKey_
+{
+	NSMutableDictionary *d = [NSMutableDictionary dictionary];
+	NSUInteger seen = 0;
+
+	for (int i = 0; i < 1000; i++)
+		[d setObject:@(i) forKey:[NSString stringWithFormat:@"%d", i]];
+	for (int i = 0; i < 1000; i += 2)
+		[d removeObjectForKey:[NSString stringWithFormat:@"%d", i]];
+	fail_unless([d count] == 500,
+		@"-[NSMutableDictionary removeObjectForKey:] failed.");
+	for (int i = 0; i < 1000; i++)
+	{
+		id obj = [d objectForKey:[NSString stringWithFormat:@"%d", i]];
+		fail_unless((i % 2) ? [obj intValue] == i : obj == nil,
+			@"-[NSMutableDictionary objectForKey:] failed after removals.");
+	}
+	for (NSString *key in d)
+	{
+		fail_unless([[d objectForKey:key] intValue] == [key intValue], @"");
+		seen++;
+	}
+	fail_unless(seen == 500,
+		@"Enumerating a dictionary after removals failed.");
+}
+
 /*
 - (void) test_description
 {
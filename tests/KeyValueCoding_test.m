@@ -0,0 +1,100 @@
+#import <Test/NSTest.h>
+#import <Foundation/NSKeyValueCoding.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#include <objc/runtime.h>
+
+@interface TestKVCObject : NSObject
+{
+	@public
+	int count;
+	NSString *_name;
+	double ratio;
+}
+- (double) ratio;
+- (void) setRatio:(double)r;
+@end
+
+@implementation TestKVCObject
+- (double) ratio
+{
+	return ratio;
+}
+
+- (void) setRatio:(double)r
+{
+	ratio = r * 2;
+}
+@end
+
+static id lateValue(id self, SEL _cmd)
+{
+	return @"late";
+}
+
+@interface TestKeyValueCoding : NSTest
+@end
+
+@implementation TestKeyValueCoding
+
+- (void) test_valueForKey_ivar
+{
+	TestKVCObject *o = [TestKVCObject new];
+	o->count = 7;
+	o->_name = @"foo";
+	fail_unless([[o valueForKey:@"count"] intValue] == 7 &&
+			[[o valueForKey:@"name"] isEqual:@"foo"],
+		@"");
+	/* Second lookup is served from the accessor cache. */
+	o->count = 8;
+	fail_unless([[o valueForKey:@"count"] intValue] == 8,
+		@"");
+}
+
+- (void) test_setValue_forKey_
+{
+	TestKVCObject *o = [TestKVCObject new];
+	[o setValue:@3 forKey:@"count"];
+	[o setValue:@1.5 forKey:@"ratio"];
+	[o setValue:@"bar" forKey:@"name"];
+	fail_unless(o->count == 3 && o->ratio == 3.0 &&
+			[o->_name isEqual:@"bar"] &&
+			[[o valueForKey:@"ratio"] doubleValue] == 3.0,
+		@"");
+}
+
+- (void) test_valueForUndefinedKey_
+{
+	TestKVCObject *o = [TestKVCObject new];
+	bool thrown = false;
+	@try
+	{
+		[o valueForKey:@"missing"];
+	}
+	@catch (NSException *e)
+	{
+		thrown = true;
+	}
+	fail_unless(thrown,
+		@"");
+}
+
+- (void) test_valueForKey_addedMethod
+{
+	TestKVCObject *o = [TestKVCObject new];
+	bool thrown = false;
+	@try
+	{
+		[o valueForKey:@"late"];
+	}
+	@catch (NSException *e)
+	{
+		thrown = true;
+	}
+	class_addMethod([TestKVCObject class], sel_registerName("late"),
+		(IMP)lateValue, "@@:");
+	fail_unless(thrown && [[o valueForKey:@"late"] isEqual:@"late"],
+		@"A key that failed to resolve stayed undefined after its getter was added.");
+}
+
+@end
@@ -1,59 +1,75 @@
-#include <check.h>
-#import <Foundation/MethodSignature.h>
-START_TEST(c_signatureWithObjCTypes_) {
-	fail_unless(0,
-		"+[MethodSignature signatureWithObjCTypes:] failed.");
-}
-END_TEST
+#include <stdlib.h>
+#include <string.h>
+#import <Test/NSTest.h>
+#import <Foundation/NSMethodSignature.h>
 
-START_TEST(i_argumentInfoAtIndex_) {
-	fail_unless(0,
-		"-[MethodSignature argumentInfoAtIndex:] failed.");
-}
-END_TEST
+struct sig_pair
+{
+	int i;
+	double d;
+};
 
-START_TEST(i_frameLength) {
-	fail_unless(0,
-		"-[MethodSignature frameLength] failed.");
-}
-END_TEST
+#define PAIR_TYPES	"v@:{sig_pair=id}d"
 
-START_TEST(i_isOneway) {
-	fail_unless(0,
-		"-[MethodSignature isOneway] failed.");
+@interface TestMethodSignatureClass : NSTest
+@end
+@interface TestMethodSignature : NSTest
+@end
+
+static NSUInteger word_round(NSUInteger size)
+{
+	return (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
 }
-END_TEST
 
-START_TEST(i_methodReturnLength) {
-	fail_unless(0,
-		"-[MethodSignature methodReturnLength] failed.");
+@implementation TestMethodSignatureClass
+-(void) test_signatureWithObjCTypes_
+{
+	char *types = strdup(PAIR_TYPES);
+	NSMethodSignature *a = [NSMethodSignature signatureWithObjCTypes:PAIR_TYPES];
+	NSMethodSignature *b = [NSMethodSignature signatureWithObjCTypes:types];
+
+	fail_unless(a != nil && a == b,
+		@"+[NSMethodSignature signatureWithObjCTypes:] didn't intern identical encodings.");
+	fail_unless([NSMethodSignature signatureWithObjCTypes:"v@:"] != a,
+		@"+[NSMethodSignature signatureWithObjCTypes:] merged different encodings.");
+	free(types);
 }
-END_TEST
+@end
+
+@implementation TestMethodSignature
+-(void) test_getArgumentTypeAtIndex_
+{
+	NSMethodSignature *sig = [NSMethodSignature signatureWithObjCTypes:PAIR_TYPES];
 
-START_TEST(i_methodReturnType) {
-	fail_unless(0,
-		"-[MethodSignature methodReturnType] failed.");
+	fail_unless([sig numberOfArguments] == 4 &&
+			*[sig getArgumentTypeAtIndex:0] == '@' &&
+			*[sig getArgumentTypeAtIndex:1] == ':' &&
+			strncmp([sig getArgumentTypeAtIndex:2], "{sig_pair=id}", 13) == 0 &&
+			*[sig getArgumentTypeAtIndex:3] == 'd',
+		@"-[NSMethodSignature getArgumentTypeAtIndex:] failed.");
 }
-END_TEST
 
-START_TEST(i_numberOfArguments) {
-	fail_unless(0,
-		"-[MethodSignature numberOfArguments] failed.");
+-(void) test_frameLength
+{
+	NSMethodSignature *sig = [NSMethodSignature signatureWithObjCTypes:PAIR_TYPES];
+
+	fail_unless([sig frameLength] == word_round(sizeof(id)) +
+			word_round(sizeof(SEL)) + word_round(sizeof(struct sig_pair)) +
+			word_round(sizeof(double)),
+		@"-[NSMethodSignature frameLength] failed.");
+	fail_unless([sig methodReturnLength] == 0,
+		@"-[NSMethodSignature methodReturnLength] failed.");
 }
-END_TEST
 
-Suite *MethodSignature_suite(void)
+-(void) test_argumentLayout
 {
-	Suite *s = suite_create("MethodSignature");
-	TCase *tc_core = tcase_create("Basic NSTest");
-	suite_add_tcase(s, tc_core);
-
-	tcase_add_test(tc_core, c_signatureWithObjCTypes_);
-	tcase_add_test(tc_core, i_argumentInfoAtIndex_);
-	tcase_add_test(tc_core, i_frameLength);
-	tcase_add_test(tc_core, i_isOneway);
-	tcase_add_test(tc_core, i_methodReturnLength);
-	tcase_add_test(tc_core, i_methodReturnType);
-	tcase_add_test(tc_core, i_numberOfArguments);
-	return (s);
+	NSMethodSignature *sig = [NSMethodSignature signatureWithObjCTypes:PAIR_TYPES];
+
+	fail_unless([sig argumentSizeAtIndex:2] == sizeof(struct sig_pair) &&
+			[sig argumentAlignmentAtIndex:2] == __alignof__(struct sig_pair),
+		@"Wrong layout for a struct argument.");
+	fail_unless([sig argumentSizeAtIndex:3] == sizeof(double) &&
+			[sig argumentAlignmentAtIndex:3] == __alignof__(double),
+		@"Wrong layout for a double argument.");
 }
+@end
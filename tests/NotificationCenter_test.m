@@ -85,6 +85,51 @@ static NSString *TestNotification = @"TestNotification";
 		@"");
 }
 
+- (void) test_addObserver_object_filter
+{
+	id other = [NSObject new];
+	[noteCenter addObserver:self selector:@selector(handleNotification:) name:TestNotification object:other];
+	[noteCenter postNotificationName:TestNotification object:self];
+	fail_unless(noteCounter == 0,
+		@"");
+	[noteCenter postNotificationName:TestNotification object:other];
+	fail_unless(noteCounter == 1,
+		@"");
+}
+
+- (void) test_addObserver_nil_name
+{
+	[noteCenter addObserver:self selector:@selector(handleNotification:) name:nil object:self];
+	[noteCenter postNotificationName:TestNotification object:self];
+	[noteCenter postNotificationName:@"OtherNotification" object:self];
+	fail_unless(noteCounter == 2,
+		@"");
+}
+
+- (void) test_addObserverForName_object_queue_usingBlock_
+{
+	__block int blockCounter = 0;
+	id observer = [noteCenter addObserverForName:TestNotification object:nil queue:nil usingBlock:^(NSNotification *n){
+		blockCounter++;
+	}];
+	[noteCenter postNotificationName:TestNotification object:self];
+	[noteCenter removeObserver:observer];
+	[noteCenter postNotificationName:TestNotification object:self];
+	fail_unless(blockCounter == 1,
+		@"");
+}
+
+- (void) test_removeObserver_name_object_partial
+{
+	[noteCenter addObserver:self selector:@selector(handleNotification:) name:TestNotification object:nil];
+	[noteCenter addObserver:self selector:@selector(handleNotification:) name:@"OtherNotification" object:nil];
+	[noteCenter removeObserver:self name:@"OtherNotification" object:nil];
+	[noteCenter postNotificationName:TestNotification object:self];
+	[noteCenter postNotificationName:@"OtherNotification" object:self];
+	fail_unless(noteCounter == 1,
+		@"");
+}
+
 - (void) handleNotification:(NSNotification *)n
 {
 	noteCounter++;
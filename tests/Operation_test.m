@@ -0,0 +1,123 @@
+#import <Test/NSTest.h>
+#import <Foundation/NSOperation.h>
+#include <dispatch/dispatch.h>
+#include <unistd.h>
+
+@interface TestOperationClass : NSTest
+@end
+
+/* Finishes on another thread some time after -start returns. */
+@interface AsyncOperation : NSOperation
+{
+	bool executing;
+	bool finished;
+}
+@end
+
+@implementation AsyncOperation
+
+- (bool) isConcurrent
+{
+	return true;
+}
+
+- (bool) isExecuting
+{
+	return executing;
+}
+
+- (bool) isFinished
+{
+	return finished;
+}
+
+- (void) start
+{
+	[self willChangeValueForKey:@"isExecuting"];
+	executing = true;
+	[self didChangeValueForKey:@"isExecuting"];
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC),
+		dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			[self willChangeValueForKey:@"isExecuting"];
+			executing = false;
+			[self didChangeValueForKey:@"isExecuting"];
+			[self willChangeValueForKey:@"isFinished"];
+			finished = true;
+			[self didChangeValueForKey:@"isFinished"];
+		});
+}
+@end
+
+/* Finishes as soon as it's cancelled, without waiting to be started. */
+@interface CancellableOperation : AsyncOperation
+@end
+
+@implementation CancellableOperation
+
+- (void) cancel
+{
+	[super cancel];
+	[self willChangeValueForKey:@"isFinished"];
+	finished = true;
+	[self didChangeValueForKey:@"isFinished"];
+}
+@end
+
+@implementation TestOperationClass
+
+- (void) test_addOperationWithBlock_
+{
+	NSOperationQueue *q = [NSOperationQueue new];
+	__block int ran = 0;
+
+	[q addOperationWithBlock:^{ ran++; }];
+	[q waitUntilAllOperationsAreFinished];
+	fail_unless(ran == 1 && [q operationCount] == 0,
+		@"-[NSOperationQueue addOperationWithBlock:] failed.");
+}
+
+- (void) test_concurrentOperation
+{
+	NSOperationQueue *q = [NSOperationQueue new];
+	dispatch_semaphore_t done = dispatch_semaphore_create(0);
+
+	[q setMaxConcurrentOperationCount:1];
+	[q addOperation:[AsyncOperation new]];
+	[q addOperationWithBlock:^{ dispatch_semaphore_signal(done); }];
+	fail_unless(dispatch_semaphore_wait(done,
+			dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)) == 0,
+		@"Finishing a concurrent operation didn't free its queue slot.");
+	dispatch_release(done);
+}
+
+- (void) test_cancelledBeforeStart
+{
+	NSOperationQueue *q = [NSOperationQueue new];
+	NSOperation *op = [CancellableOperation new];
+	__block int active = 0;
+	__block int maxActive = 0;
+	void (^block)(void) = ^{
+		int n = __atomic_add_fetch(&active, 1, __ATOMIC_SEQ_CST);
+		int m = __atomic_load_n(&maxActive, __ATOMIC_SEQ_CST);
+
+		while (n > m && !__atomic_compare_exchange_n(&maxActive, &m, n,
+					false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			;
+		usleep(10000);
+		__atomic_sub_fetch(&active, 1, __ATOMIC_SEQ_CST);
+	};
+
+	[q setMaxConcurrentOperationCount:1];
+	[q setSuspended:true];
+	[q addOperation:op];
+	[op cancel];
+	[q addOperationWithBlock:block];
+	[q addOperationWithBlock:block];
+	[q addOperationWithBlock:block];
+	[q setSuspended:false];
+	[q waitUntilAllOperationsAreFinished];
+	fail_unless(maxActive == 1 && [q operationCount] == 0,
+		@"An operation finished before starting threw off the queue's width.");
+}
+
+@end
@@ -0,0 +1,74 @@
+#import <Test/NSTest.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSOrderedSet.h>
+#import <Foundation/NSSet.h>
+#import <Foundation/NSString.h>
+
+@interface TestOrderedSet : NSTest
+@end
+
+@implementation TestOrderedSet
+
+- (void) test_initWithArray_
+{
+	NSArray *a = [NSArray arrayWithObjects:@"foo",@"bar",@"foo",@"baz",nil];
+	NSOrderedSet *s = [[NSOrderedSet alloc] initWithArray:a];
+	fail_unless([s count] == 3 &&
+			[[s objectAtIndex:0] isEqual:@"foo"] &&
+			[[s objectAtIndex:1] isEqual:@"bar"] &&
+			[[s objectAtIndex:2] isEqual:@"baz"],
+		@"-[NSOrderedSet initWithArray:] failed to drop duplicates.");
+}
+
+- (void) test_indexOfObject_
+{
+	NSMutableOrderedSet *s = [NSMutableOrderedSet orderedSetWithCapacity:3];
+	[s addObject:@"foo"];
+	[s addObject:@"bar"];
+	[s insertObject:@"baz" atIndex:0];
+	fail_unless([s indexOfObject:@"baz"] == 0 &&
+			[s indexOfObject:@"foo"] == 1 &&
+			[s indexOfObject:@"bar"] == 2 &&
+			[s indexOfObject:@"qux"] == NSNotFound,
+		@"-[NSMutableOrderedSet indexOfObject:] failed after insertion.");
+}
+
+- (void) test_addObject_
+{
+	NSMutableOrderedSet *s = [NSMutableOrderedSet new];
+	[s addObject:@"foo"];
+	[s addObject:@"foo"];
+	fail_unless([s count] == 1 && [s containsObject:@"foo"],
+		@"-[NSMutableOrderedSet addObject:] accepted a duplicate.");
+}
+
+- (void) test_removeObjectAtIndex_
+{
+	NSMutableOrderedSet *s = [NSMutableOrderedSet orderedSetWithObjects:
+		@"foo",@"bar",@"baz",nil];
+	[s removeObjectAtIndex:0];
+	fail_unless([s count] == 2 && ![s containsObject:@"foo"] &&
+			[s indexOfObject:@"baz"] == 1,
+		@"-[NSMutableOrderedSet removeObjectAtIndex:] failed.");
+}
+
+- (void) test_array
+{
+	NSMutableOrderedSet *s = [NSMutableOrderedSet orderedSetWithObjects:
+		@"foo",@"bar",nil];
+	NSArray *a = [s array];
+	[s addObject:@"baz"];
+	fail_unless([a count] == 3 && [[a objectAtIndex:2] isEqual:@"baz"],
+		@"-[NSOrderedSet array] is not a view of the ordered set.");
+}
+
+- (void) test_set
+{
+	NSOrderedSet *s = [NSOrderedSet orderedSetWithObjects:@"foo",@"bar",nil];
+	NSSet *set = [s set];
+	fail_unless([set count] == 2 && [set member:@"bar"] != nil &&
+			[set member:@"baz"] == nil,
+		@"-[NSOrderedSet set] failed.");
+}
+
+@end
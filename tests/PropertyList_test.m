@@ -0,0 +1,113 @@
+#import <Test/NSTest.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSPropertyList.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#include <string.h>
+
+@interface TestPropertyList : NSTest
+@end
+
+@implementation TestPropertyList
+
+- (void) test_binary_roundTrip
+{
+	NSDictionary *plist = @{
+		@"name" : @"widget",
+		@"unicode" : @"caf\u00e9",
+		@"count" : @42,
+		@"negative" : @-7,
+		@"ratio" : @0.5,
+		@"enabled" : @YES,
+		@"blob" : [NSData dataWithBytes:"\x01\x02\x03" length:3],
+		@"when" : [NSDate dateWithTimeIntervalSinceReferenceDate:1000.0],
+		@"items" : @[@"widget", @"widget", @1, @2, @3, @4, @5, @6, @7, @8,
+			@9, @10, @11, @12, @13, @14, @15, @16],
+	};
+	NSData *d = [NSPropertyListSerialization dataWithPropertyList:plist
+		format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
+	NSPropertyListFormat format;
+	id result;
+
+	fail_unless([d length] > 8 && memcmp([d bytes], "bplist00", 8) == 0,
+		@"Binary property list header missing.");
+	result = [NSPropertyListSerialization propertyListWithData:d options:0
+		format:&format error:NULL];
+	fail_unless(format == NSPropertyListBinaryFormat_v1_0 &&
+			[result isEqual:plist],
+		@"Binary property list did not round trip.");
+}
+
+- (void) test_binary_mutableContainers
+{
+	NSData *d = [NSPropertyListSerialization dataWithPropertyList:@[@"a"]
+		format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
+	id result = [NSPropertyListSerialization propertyListWithData:d
+		options:NSPropertyListMutableContainers format:NULL error:NULL];
+
+	[result addObject:@"b"];
+	fail_unless([result count] == 2,
+		@"");
+}
+
+- (void) test_binary_corrupt
+{
+	NSMutableData *d = [[NSPropertyListSerialization dataWithPropertyList:@[@"a"]
+		format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL] mutableCopy];
+	NSError *err = nil;
+
+	/* Point the offset table past the end of the data. */
+	((uint8_t *)[d mutableBytes])[[d length] - 1] = 0xFF;
+	fail_unless([NSPropertyListSerialization propertyListWithData:d options:0
+			format:NULL error:&err] == nil && err != nil,
+		@"");
+}
+
+- (void) test_binary_tooDeep
+{
+	NSMutableData *d = [NSMutableData dataWithBytes:"bplist00" length:8];
+	const unsigned levels = 1000;
+	uint8_t buf[32];
+	uint64_t table;
+	NSError *err = nil;
+
+	/* Each array holds the next one; the last is empty. */
+	for (unsigned i = 0; i < levels; i++)
+	{
+		unsigned next = i + 1;
+
+		buf[0] = 0xA1;
+		buf[1] = next >> 8;
+		buf[2] = next & 0xFF;
+		[d appendBytes:buf length:3];
+	}
+	buf[0] = 0xA0;
+	[d appendBytes:buf length:1];
+	table = [d length];
+	for (unsigned i = 0; i <= levels; i++)
+	{
+		unsigned offset = 8 + 3 * i;
+
+		buf[0] = offset >> 8;
+		buf[1] = offset & 0xFF;
+		[d appendBytes:buf length:2];
+	}
+	memset(buf, 0, sizeof(buf));
+	buf[6] = 2;
+	buf[7] = 2;
+	for (int i = 0; i < 8; i++)
+	{
+		buf[8 + i] = (uint64_t)(levels + 1) >> (8 * (7 - i));
+		buf[24 + i] = table >> (8 * (7 - i));
+	}
+	[d appendBytes:buf length:32];
+
+	fail_unless([NSPropertyListSerialization propertyListWithData:d options:0
+			format:NULL error:&err] == nil && err != nil,
+		@"Deeply nested binary property list was not rejected.");
+}
+
+@end
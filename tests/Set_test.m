@@ -2,6 +2,7 @@
 #import <Foundation/NSArray.h>
 #import <Foundation/NSSet.h>
 #import <Foundation/NSEnumerator.h>
+#import <Foundation/NSException.h>
 #import <Foundation/NSString.h>
 
 @interface TestSetClass : NSTest
@@ -279,4 +280,62 @@
 		@"-[NSSet removeObject:] failed.");
 }
 
+- (void) test_copy
+{
+	NSMutableSet *s = [NSMutableSet setWithObjects:@"foo",@"bar",@"baz",nil];
+	NSSet *t = [s copy];
+
+	[s removeObject:@"foo"];
+	fail_unless([t count] == 3 && [t containsObject:@"foo"] &&
+		[t member:@"qux"] == nil,
+		@"-[NSMutableSet copy] failed.");
+	fail_unless([t copy] == t,
+		@"-[NSSet copy] of an immutable set didn't return the receiver.");
+}
+
+- (void) test_mutableCopy
+{
+	NSMutableSet *s = [NSMutableSet setWithObjects:@"foo",@"bar",@"baz",nil];
+	NSSet *t = [s copy];
+	NSMutableSet *u = [t mutableCopy];
+
+	[u addObject:@"qux"];
+	[s removeAllObjects];
+	fail_unless([t count] == 3 && [u count] == 4 && [s count] == 0,
+		@"Mutating a copy of a set changed the original.");
+}
+
+- (void) test_countedSet
+{
+	NSCountedSet *s = [[NSCountedSet alloc] initWithCapacity:0];
+	NSUInteger seen = 0;
+
+	[s addObjectsFromArray:[NSArray arrayWithObjects:@"foo",@"bar",@"foo",@"foo",nil]];
+	fail_unless([s count] == 2 && [s countForObject:@"foo"] == 3 &&
+		[s countForObject:@"bar"] == 1 && [s countForObject:@"baz"] == 0,
+		@"-[NSCountedSet addObjectsFromArray:] miscounted.");
+	for (id obj in s)
+		seen++;
+	fail_unless(seen == 2,
+		@"Enumerating an NSCountedSet didn't yield each object once.");
+
+	[s removeObject:@"foo"];
+	[s removeObject:@"bar"];
+	fail_unless([s count] == 1 && [s countForObject:@"foo"] == 2 &&
+		[s member:@"bar"] == nil,
+		@"-[NSCountedSet removeObject:] failed.");
+
+	bool raised = false;
+	@try
+	{
+		[s addObject:nil];
+	}
+	@catch (NSException *e)
+	{
+		raised = true;
+	}
+	fail_unless(raised && [s count] == 1,
+		@"-[NSCountedSet addObject:] accepted nil.");
+}
+
 @end
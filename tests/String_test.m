@@ -1,5 +1,34 @@
 #import <Test/NSTest.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSData.h>
 #import <Foundation/NSString.h>
+#include <string.h>
+
+/* Only the primitive methods, so NSString works through getCharacters:range:. */
+@interface TestCharacterString : NSString
+{
+	NSString *backing;
+}
+- (id) initWithBacking:(NSString *)str;
+@end
+
+@implementation TestCharacterString
+- (id) initWithBacking:(NSString *)str
+{
+	backing = str;
+	return self;
+}
+
+- (NSUInteger) length
+{
+	return [backing length];
+}
+
+- (NSUniChar) characterAtIndex:(NSUInteger)index
+{
+	return [backing characterAtIndex:index];
+}
+@end
 
 @interface TestStringClass : NSTest
 @end
@@ -95,12 +124,6 @@
 		@"-[NSString stringByAppendingString:] failed.");
 }
 
-- (void) test_componentsSeparatedByString_
-{
-	fail_unless(0,
-		@"-[NSString componentsSeparatedByString:] failed.");
-}
-
 - (void) test_substringFromIndex_
 {
 	fail_unless(0,
@@ -137,24 +160,6 @@
 		@"-[NSString rangeOfCharacterFromSet:options:range:] failed.");
 }
 
-- (void) test_rangeOfString_
-{
-	fail_unless(0,
-		@"-[NSString rangeOfString:] failed.");
-}
-
-- (void) test_rangeOfString_options_
-{
-	fail_unless(0,
-		@"-[NSString rangeOfString:options:] failed.");
-}
-
-- (void) test_rangeOfString_options_range_
-{
-	fail_unless(0,
-		@"-[NSString rangeOfString:options:range:] failed.");
-}
-
 - (void) test_rangeOfComposedCharacterSequenceAtIndex_
 {
 	fail_unless(0,
@@ -186,6 +191,67 @@
 }
  */
 
+- (void) test_rangeOfString_
+{
+	NSRange r = [@"foo bar baz" rangeOfString:@"bar"];
+	fail_unless(r.location == 4 && r.length == 3,
+		@"-[NSString rangeOfString:] failed.");
+	fail_unless([@"foo bar baz" rangeOfString:@"Bar"].length == 0,
+		@"-[NSString rangeOfString:] matched with different case.");
+}
+
+- (void) test_rangeOfString_options_
+{
+	NSRange r = [@"abcabcabc" rangeOfString:@"abc" options:NSBackwardsSearch];
+	fail_unless(r.location == 6 && r.length == 3,
+		@"-[NSString rangeOfString:options:] failed backwards.");
+	r = [@"Hello, World" rangeOfString:@"WORLD" options:NSCaseInsensitiveSearch];
+	fail_unless(r.location == 7 && r.length == 5,
+		@"-[NSString rangeOfString:options:] failed case insensitive.");
+	r = [@"abcabc" rangeOfString:@"bc" options:NSAnchoredSearch];
+	fail_unless(r.length == 0,
+		@"-[NSString rangeOfString:options:] anchored search matched late.");
+}
+
+- (void) test_rangeOfString_options_range_
+{
+	NSString *str = [NSString stringWithUTF8String:"x needle x needle x"];
+	NSRange r = [str rangeOfString:@"needle" options:0
+		range:NSMakeRange(3, 16)];
+	fail_unless(r.location == 11 && r.length == 6,
+		@"-[NSString rangeOfString:options:range:] failed.");
+	r = [str rangeOfString:@"needle" options:NSBackwardsSearch
+		range:NSMakeRange(0, 16)];
+	fail_unless(r.location == 2 && r.length == 6,
+		@"-[NSString rangeOfString:options:range:] failed backwards.");
+}
+
+- (void) test_containsString_
+{
+	fail_unless([@"foo bar baz" containsString:@"r b"],
+		@"-[NSString containsString:] failed.");
+	fail_if([@"foo bar baz" containsString:@"qux"],
+		@"-[NSString containsString:] found a missing string.");
+}
+
+- (void) test_componentsSeparatedByString_
+{
+	NSArray *parts = [@"a::b::::c" componentsSeparatedByString:@"::"];
+	fail_unless([parts count] == 4 &&
+			[[parts objectAtIndex:0] isEqualToString:@"a"] &&
+			[[parts objectAtIndex:2] isEqualToString:@""] &&
+			[[parts objectAtIndex:3] isEqualToString:@"c"],
+		@"-[NSString componentsSeparatedByString:] failed.");
+}
+
+- (void) test_stringByReplacingOccurrencesOfString_withString_
+{
+	NSString *str = [@"a.b.c" stringByReplacingOccurrencesOfString:@"."
+		withString:@".."];
+	fail_unless([str isEqualToString:@"a..b..c"],
+		@"-[NSString stringByReplacingOccurrencesOfString:withString:] failed.");
+}
+
 - (void) test_hasPrefix_
 {
 	fail_unless([@"foo bar baz" hasPrefix:@"foo"],
@@ -274,31 +340,133 @@
 }
  */
 
+- (void) test_UTF8String
+{
+	NSString *str = [NSString stringWithUTF8String:"caf\xc3\xa9"];
+	fail_unless([str length] == 4 && [str characterAtIndex:3] == 0xe9,
+		@"-[NSString stringWithUTF8String:] decoded Latin-1 text wrongly.");
+	fail_unless(strcmp([str UTF8String], "caf\xc3\xa9") == 0,
+		@"-[NSString UTF8String] failed for Latin-1 text.");
+	fail_unless(strcmp([[NSString stringWithUTF8String:"plain"] UTF8String], "plain") == 0,
+		@"-[NSString UTF8String] failed for ASCII text.");
+}
+
+- (void) test_UTF8String_wide
+{
+	NSUniChar chars[] = {'a', 0x263a, 0xd83d, 0xde00};
+	NSString *str = [NSString stringWithCharacters:chars length:4];
+	const char *utf8 = [str UTF8String];
+
+	fail_unless(strcmp(utf8, "a\xe2\x98\xba\xf0\x9f\x98\x80") == 0,
+		@"-[NSString UTF8String] failed for non-Latin-1 text.");
+	fail_unless([str UTF8String] == utf8,
+		@"-[NSString UTF8String] did not reuse the converted string.");
+}
+
+- (void) test_getCString_maxLength_encoding_
+{
+	NSString *str = [NSString stringWithUTF8String:"caf\xc3\xa9"];
+	char buf[8];
+
+	fail_unless([str getCString:buf maxLength:sizeof(buf) encoding:NSUTF8StringEncoding] &&
+			strcmp(buf, "caf\xc3\xa9") == 0,
+		@"-[NSString getCString:maxLength:encoding:] failed.");
+	fail_if([str getCString:buf maxLength:5 encoding:NSUTF8StringEncoding],
+		@"-[NSString getCString:maxLength:encoding:] succeeded with a short buffer.");
+	fail_unless(strcmp(buf, "caf") == 0,
+		@"-[NSString getCString:maxLength:encoding:] split a character.");
+}
+
+- (void) test_hash_compactAndWide
+{
+	NSUniChar chars[] = {'k', 'e', 'y'};
+	NSString *wide = [NSString stringWithCharacters:chars length:3];
+	fail_unless([[NSString stringWithUTF8String:"key"] hash] == [wide hash],
+		@"-[NSString hash] differs between representations.");
+}
+
+- (void) test_hash_representations
+{
+	/* Longer than the 64 character chunks used by the generic path. */
+	NSString *constant = @"The quick brown fox jumps over the lazy dog, "
+		@"then naps while the hound keeps watch by the barn door.";
+	NSUInteger len = [constant length];
+	NSUniChar chars[128];
+	NSUniChar smile = 0x263a;
+
+	[constant getCharacters:chars range:NSMakeRange(0, len)];
+
+	NSString *compact = [NSString stringWithUTF8String:[constant UTF8String]];
+	NSString *wide = [NSString stringWithCharacters:chars length:len];
+	NSMutableString *mutable = [NSMutableString stringWithString:constant];
+	NSString *chunked = [[TestCharacterString alloc] initWithBacking:constant];
+	NSHashCode h = [constant hash];
+
+	fail_unless(len > 64 && [compact hash] == h && [wide hash] == h &&
+			[mutable hash] == h && [chunked hash] == h,
+		@"-[NSString hash] differs between representations.");
+
+	/* Text outside Latin-1 can only be stored as UTF-16. */
+	chars[len] = smile;
+	wide = [NSString stringWithCharacters:chars length:len + 1];
+	[mutable appendString:[NSString stringWithCharacters:&smile length:1]];
+	chunked = [[TestCharacterString alloc] initWithBacking:wide];
+	h = [wide hash];
+	fail_unless([mutable hash] == h && [chunked hash] == h,
+		@"-[NSString hash] differs between UTF-16 representations.");
+}
+
+- (void) test_appendString_widens
+{
+	NSMutableString *str = [NSMutableString stringWithCapacity:2];
+	NSUniChar smile = 0x263a;
+
+	[str appendString:@"abc"];
+	[str appendString:[NSString stringWithCharacters:&smile length:1]];
+	[str appendString:@"d"];
+	fail_unless([str length] == 5 && [str characterAtIndex:2] == 'c' &&
+			[str characterAtIndex:3] == 0x263a && [str characterAtIndex:4] == 'd',
+		@"-[NSMutableString appendString:] lost characters when widening.");
+}
+
 - (void) test_intValue
 {
 	fail_unless([@"1234" intValue] == 1234,
 		@"-[NSString intValue] failed.");
 }
 
-/*
 - (void) test_canBeConvertedToEncoding_
 {
-	fail_unless(0,
-		@"-[NSString canBeConvertedToEncoding:] failed.");
+	NSString *str = [NSString stringWithUTF8String:"caf\xc3\xa9"];
+	fail_unless([str canBeConvertedToEncoding:NSISOLatin1StringEncoding],
+		@"-[NSString canBeConvertedToEncoding:] rejected Latin-1.");
+	fail_if([str canBeConvertedToEncoding:NSASCIIStringEncoding],
+		@"-[NSString canBeConvertedToEncoding:] accepted non-ASCII text as ASCII.");
 }
 
 - (void) test_dataUsingEncoding_
 {
-	fail_unless(0,
-		@"-[NSString dataUsingEncoding:] failed.");
+	NSString *str = [NSString stringWithUTF8String:"hi\xe2\x98\xba"];
+	NSData *data = [str dataUsingEncoding:NSUTF16LittleEndianStringEncoding];
+	const unsigned char expected[] = {'h', 0, 'i', 0, 0x3a, 0x26};
+
+	fail_unless([data length] == sizeof(expected) &&
+			memcmp([data bytes], expected, sizeof(expected)) == 0,
+		@"-[NSString dataUsingEncoding:] failed for UTF-16LE.");
+	fail_unless([[[NSString alloc] initWithData:data
+			encoding:NSUTF16LittleEndianStringEncoding] isEqualToString:str],
+		@"-[NSString initWithData:encoding:] failed to round trip UTF-16LE.");
 }
 
 - (void) test_dataUsingEncoding_allowLossyConversion_
 {
-	fail_unless(0,
+	NSString *str = [NSString stringWithUTF8String:"caf\xc3\xa9"];
+	NSData *data = [str dataUsingEncoding:NSASCIIStringEncoding
+		allowLossyConversion:true];
+
+	fail_unless([data length] == 4 && memcmp([data bytes], "caf?", 4) == 0,
 		@"-[NSString dataUsingEncoding:allowLossyConversion:] failed.");
 }
- */
 
 - (void) test_fastestEncoding
 {
@@ -339,6 +507,45 @@
 		@"-[NSString init] failed.");
 }
 
+- (void) test_initWithBytesNoCopy_length_encoding_deallocator_
+{
+	static char bytes[] = "no copy";
+	__block int released = 0;
+
+	@autoreleasepool {
+		NSString *str = [[NSString alloc] initWithBytesNoCopy:bytes
+			length:strlen(bytes) encoding:NSASCIIStringEncoding
+			deallocator:^(void *p, NSUInteger len) {
+				if (p == bytes && len == strlen(bytes))
+					released++;
+			}];
+		fail_unless([str isEqualToString:@"no copy"] && [str copy] == str,
+			@"-[NSString initWithBytesNoCopy:length:encoding:deallocator:] failed.");
+		fail_unless(strcmp([str UTF8String], "no copy") == 0,
+			@"-[NSString UTF8String] failed on an adopted buffer.");
+	}
+	fail_unless(released == 1,
+		@"-[NSString initWithBytesNoCopy:length:encoding:deallocator:] didn't release the bytes.");
+}
+
+- (void) test_initWithCharactersNoCopy_length_deallocator_
+{
+	static NSUniChar chars[] = { 'a', 0x3b2, 'c' };
+	__block int released = 0;
+
+	@autoreleasepool {
+		NSString *str = [[NSString alloc] initWithCharactersNoCopy:chars
+			length:3 deallocator:^(NSUniChar *p, NSUInteger len) {
+				if (p == chars && len == 3)
+					released++;
+			}];
+		fail_unless([str length] == 3 && [str characterAtIndex:1] == 0x3b2,
+			@"-[NSString initWithCharactersNoCopy:length:deallocator:] failed.");
+	}
+	fail_unless(released == 1,
+		@"-[NSString initWithCharactersNoCopy:length:deallocator:] didn't release the characters.");
+}
+
 /*
 - (void) test_initWithBytes_length_encoding_
 {
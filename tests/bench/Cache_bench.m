@@ -0,0 +1,95 @@
+/*
+ * NSCache hit throughput, from one thread up to the number of active
+ * processors.  Every lookup hits, so this measures lock contention on the
+ * read path and nothing else.
+ *
+ * usage: cache_bench [lookups-per-thread]
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#import <Foundation/NSArray.h>
+#import <Foundation/NSCache.h>
+#import <Foundation/NSProcessInfo.h>
+#import <Foundation/NSString.h>
+
+#define NKEYS	1024
+
+static NSCache *cache;
+static NSArray *keys;
+static unsigned long lookups = 1000000;
+static pthread_barrier_t barrier;
+
+static void *hit_loop(void *arg)
+{
+	@autoreleasepool {
+		unsigned long i;
+		NSUInteger k = (NSUInteger)arg;
+
+		pthread_barrier_wait(&barrier);
+		for (i = 0; i < lookups; i++)
+		{
+			if ([cache objectForKey:[keys objectAtIndex:k++ % NKEYS]] == nil)
+				abort();
+		}
+	}
+	return NULL;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	@autoreleasepool {
+		NSMutableArray *k = [NSMutableArray new];
+		NSUInteger ncpu = [[NSProcessInfo processInfo] activeProcessorCount];
+		/* Powers of two below the CPU count, then the CPU count itself. */
+		NSUInteger runs[sizeof(NSUInteger) * CHAR_BIT + 1];
+		NSUInteger nruns = 0;
+
+		if (argc > 1)
+			lookups = strtoul(argv[1], NULL, 0);
+
+		cache = [NSCache new];
+		for (int i = 0; i < NKEYS; i++)
+		{
+			NSString *key = [NSString stringWithFormat:@"key-%d", i];
+			[k addObject:key];
+			[cache setObject:key forKey:key];
+		}
+		keys = k;
+
+		for (NSUInteger n = 1; n < ncpu; n *= 2)
+			runs[nruns++] = n;
+		runs[nruns++] = (ncpu > 0) ? ncpu : 1;
+
+		printf("%8s %16s\n", "threads", "lookups/sec");
+		for (NSUInteger r = 0; r < nruns; r++)
+		{
+			NSUInteger n = runs[r];
+			pthread_t thr[n];
+			double start;
+
+			pthread_barrier_init(&barrier, NULL, n + 1);
+			for (NSUInteger t = 0; t < n; t++)
+				pthread_create(&thr[t], NULL, hit_loop, (void *)(t * 37));
+			pthread_barrier_wait(&barrier);
+			start = now();
+			for (NSUInteger t = 0; t < n; t++)
+				pthread_join(thr[t], NULL);
+			printf("%8lu %16.0f\n", (unsigned long)n,
+					(n * lookups) / (now() - start));
+			pthread_barrier_destroy(&barrier);
+		}
+	}
+	return 0;
+}
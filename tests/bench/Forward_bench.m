@@ -0,0 +1,100 @@
+/*
+ * Message forwarding throughput.  Compares a direct message send with the
+ * same message sent to an NSProxy that forwards it.  To compare forwarding
+ * across changes, run it against each build of the library.
+ *
+ * usage: forward_bench [messages]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#import <Foundation/NSInvocation.h>
+#import <Foundation/NSMethodSignature.h>
+#import <Foundation/NSObject.h>
+#import <Foundation/NSProxy.h>
+
+@interface BenchTarget : NSObject
+- (int) add:(int)a to:(int)b;
+@end
+
+@implementation BenchTarget
+- (int) add:(int)a to:(int)b
+{
+	return a + b;
+}
+@end
+
+@interface BenchProxy : NSProxy
+{
+	BenchTarget *target;
+}
+- (id) initWithTarget:(BenchTarget *)t;
+@end
+
+@implementation BenchProxy
+- (id) initWithTarget:(BenchTarget *)t
+{
+	target = t;
+	return self;
+}
+
+- (NSMethodSignature *) methodSignatureForSelector:(SEL)sel
+{
+	return [target methodSignatureForSelector:sel];
+}
+
+- (void) forwardInvocation:(NSInvocation *)inv
+{
+	[inv invokeWithTarget:target];
+}
+@end
+
+static unsigned long messages = 1000000;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double elapsed)
+{
+	printf("%-12s %14.0f %10.1f\n", name, messages / elapsed,
+			elapsed * 1e9 / messages);
+}
+
+int main(int argc, char **argv)
+{
+	@autoreleasepool {
+		BenchTarget *target = [BenchTarget new];
+		id proxy = [[BenchProxy alloc] initWithTarget:target];
+		volatile int sink = 0;
+		double start;
+
+		if (argc > 1)
+			messages = strtoul(argv[1], NULL, 0);
+
+		/* Warm up the forwarding path. */
+		sink += [proxy add:1 to:2];
+
+		printf("%-12s %14s %10s\n", "", "messages/sec", "ns/msg");
+
+		start = now();
+		for (unsigned long i = 0; i < messages; i++)
+			sink += [target add:(int)i to:1];
+		report("direct", now() - start);
+
+		start = now();
+		for (unsigned long i = 0; i < messages; i++)
+		{
+			@autoreleasepool {
+				sink += [proxy add:(int)i to:1];
+			}
+		}
+		report("forwarded", now() - start);
+	}
+	return 0;
+}